@@ -2,18 +2,25 @@ project "Opensegaapi"
 	targetname "Opensegaapi"
 	language "C++"
 	kind "SharedLib"
-	removeplatforms { "x64" }
+	if os.istarget("windows") then
+		removeplatforms { "x64" }
+	end
 
 	files
 	{
 		"src/**.cpp", "src/**.h",
-		"deps/cpp/**.cpp", "deps/inc/**.h",
-		"src/Opensegaapi.aps", "src/Opensegaapi.rc"
+		"deps/cpp/**.cpp", "deps/inc/**.h"
 	}
 
 	includedirs { "src" }
 
-postbuildcommands {
-  "if not exist $(TargetDir)output mkdir $(TargetDir)output",
-  "{COPY} $(TargetDir)Opensegaapi.dll $(TargetDir)output/"
-}
\ No newline at end of file
+	filter "system:windows"
+		files { "src/Opensegaapi.aps", "src/Opensegaapi.rc" }
+		links { "winmm" }
+		postbuildcommands {
+			"if not exist $(TargetDir)output mkdir $(TargetDir)output",
+			"{COPY} $(TargetDir)Opensegaapi.dll $(TargetDir)output/"
+		}
+
+	filter "system:linux"
+		links { "openal" }
\ No newline at end of file
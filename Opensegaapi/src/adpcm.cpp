@@ -0,0 +1,103 @@
+// adpcm.cpp - IMA-ADPCM block codec
+//
+// This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+
+#include "adpcm.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const int16_t g_adpcmSteps[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int8_t g_adpcmIndexSteps[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+// Bytes of one channel within a block: header plus the packed samples after the first
+static const unsigned int ADPCM_CHANNEL_BYTES = 4 + ADPCM_BLOCK_FRAMES / 2;
+
+struct AdpcmState {
+    int predictor;
+    int index;
+};
+
+// Applies a code to the state, exactly as the decoder will
+static void adpcmStep(AdpcmState* state, unsigned int code) {
+    int step = g_adpcmSteps[state->index];
+    int delta = step >> 3;
+    if (code & 4) delta += step;
+    if (code & 2) delta += step >> 1;
+    if (code & 1) delta += step >> 2;
+    state->predictor = std::clamp(state->predictor + ((code & 8) ? -delta : delta), -32768, 32767);
+    state->index = std::clamp(state->index + g_adpcmIndexSteps[code], 0, 88);
+}
+
+static unsigned int adpcmEncodeSample(AdpcmState* state, int sample) {
+    int step = g_adpcmSteps[state->index];
+    int diff = sample - state->predictor;
+    unsigned int code = 0;
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) { code |= 4; diff -= step; }
+    if (diff >= step >> 1) { code |= 2; diff -= step >> 1; }
+    if (diff >= step >> 2) code |= 1;
+    adpcmStep(state, code);
+    return code;
+}
+
+unsigned int Adpcm_BlockBytes(unsigned int channels) {
+    return channels * ADPCM_CHANNEL_BYTES;
+}
+
+unsigned int Adpcm_BlockCount(unsigned int frames) {
+    return (frames + ADPCM_BLOCK_FRAMES - 1) / ADPCM_BLOCK_FRAMES;
+}
+
+void Adpcm_Encode(const int16_t* pcm, unsigned int frames, unsigned int channels, uint8_t* out) {
+    unsigned int blocks = Adpcm_BlockCount(frames);
+    memset(out, 0, static_cast<size_t>(blocks) * Adpcm_BlockBytes(channels));
+    for (unsigned int c = 0; c < channels; c++) {
+        // The step index carries over from block to block, as a streaming encoder's would
+        AdpcmState state = { 0, 0 };
+        for (unsigned int b = 0; b < blocks; b++) {
+            uint8_t* channel = out + static_cast<size_t>(b) * Adpcm_BlockBytes(channels) + c * ADPCM_CHANNEL_BYTES;
+            unsigned int first = b * ADPCM_BLOCK_FRAMES;
+            unsigned int count = std::min(frames - first, static_cast<unsigned int>(ADPCM_BLOCK_FRAMES));
+            state.predictor = pcm[static_cast<size_t>(first) * channels + c];
+            channel[0] = static_cast<uint8_t>(state.predictor & 0xFF);
+            channel[1] = static_cast<uint8_t>((state.predictor >> 8) & 0xFF);
+            channel[2] = static_cast<uint8_t>(state.index);
+            for (unsigned int i = 1; i < ADPCM_BLOCK_FRAMES; i++) {
+                int sample = i < count ? pcm[static_cast<size_t>(first + i) * channels + c] : 0;
+                unsigned int code = adpcmEncodeSample(&state, sample);
+                channel[4 + (i - 1) / 2] |= static_cast<uint8_t>(((i - 1) & 1) ? code << 4 : code);
+            }
+        }
+    }
+}
+
+void Adpcm_DecodeBlock(const uint8_t* block, unsigned int channels, int16_t* out) {
+    for (unsigned int c = 0; c < channels; c++) {
+        const uint8_t* channel = block + c * ADPCM_CHANNEL_BYTES;
+        AdpcmState state;
+        state.predictor = static_cast<int16_t>(channel[0] | (channel[1] << 8));
+        state.index = std::min(static_cast<int>(channel[2]), 88);
+        out[c] = static_cast<int16_t>(state.predictor);
+        for (unsigned int i = 1; i < ADPCM_BLOCK_FRAMES; i++) {
+            uint8_t packed = channel[4 + (i - 1) / 2];
+            adpcmStep(&state, ((i - 1) & 1) ? packed >> 4 : packed & 0x0F);
+            out[i * channels + c] = static_cast<int16_t>(state.predictor);
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef OPENSEGAAPI_ADPCM_H
+#define OPENSEGAAPI_ADPCM_H
+
+#include <cstdint>
+
+// ----------------------------------------------------------------------
+// IMA-ADPCM codec for resident sample storage (4 bits per sample).
+// Data is cut into blocks of ADPCM_BLOCK_FRAMES frames that decode on
+// their own. Each channel of a block starts with its first sample and
+// step index in a 4 byte header, followed by the remaining samples packed
+// two per byte, low nibble first. The last block is padded with silence.
+// ----------------------------------------------------------------------
+
+#define ADPCM_BLOCK_FRAMES 1024
+
+// Bytes of one block
+unsigned int Adpcm_BlockBytes(unsigned int channels);
+
+// Blocks needed for the given number of frames
+unsigned int Adpcm_BlockCount(unsigned int frames);
+
+// Encodes interleaved 16 bit PCM into Adpcm_BlockCount(frames) blocks
+void Adpcm_Encode(const int16_t* pcm, unsigned int frames, unsigned int channels, uint8_t* out);
+
+// Decodes one block into ADPCM_BLOCK_FRAMES interleaved frames
+void Adpcm_DecodeBlock(const uint8_t* block, unsigned int channels, int16_t* out);
+
+#endif // OPENSEGAAPI_ADPCM_H
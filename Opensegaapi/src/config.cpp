@@ -0,0 +1,20 @@
+// config.cpp - Environment based runtime options
+//
+// This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+
+#include "config.h"
+
+#include <cstdlib>
+
+const char* ConfigGetString(const char* name) {
+    const char* value = getenv(name);
+    return (value && *value) ? value : nullptr;
+}
+
+int ConfigGetInt(const char* name, int defaultValue) {
+    const char* value = ConfigGetString(name);
+    if (!value) return defaultValue;
+    char* end = nullptr;
+    long parsed = strtol(value, &end, 0);
+    return (end && *end == '\0') ? static_cast<int>(parsed) : defaultValue;
+}
@@ -0,0 +1,15 @@
+#ifndef OPENSEGAAPI_CONFIG_H
+#define OPENSEGAAPI_CONFIG_H
+
+// ----------------------------------------------------------------------
+// Runtime options. Every option is an OPENSEGAAPI_* environment variable
+// so cabinets and test rigs can be tuned without rebuilding.
+// ----------------------------------------------------------------------
+
+// Returns the value of the variable, or nullptr if it is unset or empty
+const char* ConfigGetString(const char* name);
+
+// Returns the variable parsed as an integer, or defaultValue if unset/invalid
+int ConfigGetInt(const char* name, int defaultValue);
+
+#endif // OPENSEGAAPI_CONFIG_H
@@ -0,0 +1,162 @@
+// device.cpp - Background OpenAL device bring-up
+//
+// This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+
+#include "device.h"
+#include "config.h"
+#include "latency.h"
+#include "log.h"
+#include "mixer.h"
+#include "platform.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+#include <AL/al.h>
+#include <AL/alc.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+static ALCdevice* g_alDevice = nullptr;
+static ALCcontext* g_alContext = nullptr;
+
+static std::mutex g_deviceLock;
+static std::condition_variable g_deviceChanged;
+static std::thread& g_deviceThread = *new std::thread();   // never destroyed (SEGAAPI_Init)
+static unsigned int g_deviceState = OPEN_HASTARTUP_CLOSED;
+static OPEN_HASTARTUPTIMINGS g_deviceTimings = {};
+
+typedef std::chrono::steady_clock DeviceClock;
+
+static unsigned int deviceMicroseconds(DeviceClock::time_point from, DeviceClock::time_point to) {
+    return static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count());
+}
+
+// ======================================================================
+// Bring-up thread
+// ======================================================================
+static bool deviceBringUp(OPEN_HASTARTUPTIMINGS* timings) {
+    auto start = DeviceClock::now();
+    g_alDevice = alcOpenDevice(nullptr);
+    auto opened = DeviceClock::now();
+    timings->dwOpenDeviceUs = deviceMicroseconds(start, opened);
+    if (!g_alDevice) {
+        info("Device: could not open the default OpenAL device");
+        return false;
+    }
+
+    // Ask the device to update once per mixer period, so its own buffering
+    // does not add latency on top of the profile
+    LatencyProfile profile = Latency_Select(alcGetString(g_alDevice, ALC_DEVICE_SPECIFIER));
+    ALCint attributes[] = {
+        ALC_FREQUENCY, static_cast<ALCint>(profile.sampleRate),
+        ALC_REFRESH, static_cast<ALCint>(profile.sampleRate / profile.periodFrames),
+        0
+    };
+    g_alContext = alcCreateContext(g_alDevice, attributes);
+    auto created = DeviceClock::now();
+    timings->dwCreateContextUs = deviceMicroseconds(opened, created);
+    if (!g_alContext) {
+        info("Device: could not create an OpenAL context");
+        alcCloseDevice(g_alDevice); g_alDevice = nullptr;
+        return false;
+    }
+
+    alcMakeContextCurrent(g_alContext);
+    bool started = Mixer_Start(profile);
+    timings->dwStartMixerUs = deviceMicroseconds(created, DeviceClock::now());
+    if (!started) {
+        alcMakeContextCurrent(nullptr);
+        alcDestroyContext(g_alContext); g_alContext = nullptr;
+        alcCloseDevice(g_alDevice); g_alDevice = nullptr;
+        return false;
+    }
+    return true;
+}
+
+static void deviceMain(DeviceClock::time_point requested) {
+    OPEN_HASTARTUPTIMINGS timings = {};
+    bool ready = deviceBringUp(&timings);
+    timings.dwReadyUs = deviceMicroseconds(requested, DeviceClock::now());
+    info("Device: %s after %u us (open %u us, context %u us, mixer %u us)", ready ? "ready" : "failed",
+        timings.dwReadyUs, timings.dwOpenDeviceUs, timings.dwCreateContextUs, timings.dwStartMixerUs);
+
+    std::lock_guard<std::mutex> lock(g_deviceLock);
+    timings.dwState = ready ? OPEN_HASTARTUP_READY : OPEN_HASTARTUP_FAILED;
+    g_deviceTimings = timings;
+    g_deviceState = timings.dwState;
+    g_deviceChanged.notify_all();
+}
+
+// Joins a finished bring-up thread; g_deviceLock must be held
+static void deviceReap(std::unique_lock<std::mutex>& lock) {
+    g_deviceChanged.wait(lock, [] { return g_deviceState != OPEN_HASTARTUP_OPENING; });
+    if (g_deviceThread.joinable()) g_deviceThread.join();
+}
+
+// ======================================================================
+// Public interface
+// ======================================================================
+void Device_Open() {
+    std::lock_guard<std::mutex> lock(g_deviceLock);
+    if (g_deviceState == OPEN_HASTARTUP_OPENING || g_deviceState == OPEN_HASTARTUP_READY) return;
+    if (g_deviceThread.joinable()) g_deviceThread.join();
+    g_deviceState = OPEN_HASTARTUP_OPENING;
+    g_deviceTimings = {};
+    g_deviceTimings.dwState = OPEN_HASTARTUP_OPENING;
+    // Until Device_Close, so the library is not unloaded under the thread or the mixer
+    Platform_PinLibrary(true);
+    g_deviceThread = std::thread(deviceMain, DeviceClock::now());
+}
+
+bool Device_Wait() {
+    std::unique_lock<std::mutex> lock(g_deviceLock);
+    deviceReap(lock);
+    return g_deviceState == OPEN_HASTARTUP_READY;
+}
+
+bool Device_Failed() {
+    std::lock_guard<std::mutex> lock(g_deviceLock);
+    return g_deviceState == OPEN_HASTARTUP_FAILED;
+}
+
+void Device_Close() {
+    std::unique_lock<std::mutex> lock(g_deviceLock);
+    deviceReap(lock);
+    if (g_deviceState == OPEN_HASTARTUP_READY) {
+        Mixer_Stop();
+        alcMakeContextCurrent(nullptr);
+        if (g_alContext) { alcDestroyContext(g_alContext); g_alContext = nullptr; }
+        if (g_alDevice) { alcCloseDevice(g_alDevice); g_alDevice = nullptr; }
+        g_deviceState = OPEN_HASTARTUP_CLOSED;
+    }
+    Platform_PinLibrary(false);
+}
+
+void Device_ReadTimings(OPEN_HASTARTUPTIMINGS* timings) {
+    std::lock_guard<std::mutex> lock(g_deviceLock);
+    *timings = g_deviceTimings;
+    timings->dwState = g_deviceState;
+}
+
+// ======================================================================
+// Open at load (OPENSEGAAPI_EARLY_OPEN=1)
+// (Opt-in, since every process that loads the DLL would otherwise start
+// the device. DllMain runs after the CRT constructed every static in the
+// DLL. It only starts the thread, which does not run before the loader is
+// done, since the bring-up may load other DLLs. Device_Open pins the DLL
+// until Device_Close, so FreeLibrary never unloads it under the thread or
+// the mixer; the only detach with them alive is process termination, which
+// has already ended them, and there is nothing to do. Shared objects have
+// no such hook that runs after their own static constructors, so on Linux
+// the open starts from SEGAAPI_Init.)
+// ======================================================================
+#ifdef _WIN32
+extern "C" BOOL APIENTRY DllMain(HMODULE module, DWORD reason, LPVOID reserved) {
+    if (reason == DLL_PROCESS_ATTACH && ConfigGetInt("OPENSEGAAPI_EARLY_OPEN", 0)) Device_Open();
+    return TRUE;
+}
+#endif
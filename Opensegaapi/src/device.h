@@ -0,0 +1,32 @@
+#ifndef OPENSEGAAPI_DEVICE_H
+#define OPENSEGAAPI_DEVICE_H
+
+#include "opensegaapi.h"
+
+// ----------------------------------------------------------------------
+// OpenAL device bring-up.
+// Opening the device and creating the context can block for a long time
+// on some systems, so it runs on a background thread that starts as soon
+// as the DLL is loaded (OPENSEGAAPI_EARLY_OPEN=0 waits for SEGAAPI_Init
+// instead). API calls made before it finishes queue their mixer commands,
+// which the mixer applies when it starts. Each phase is timed
+// (SEGAAPI_GetStartupTimings).
+// ----------------------------------------------------------------------
+
+// Starts opening the device and the mixer in the background;
+// does nothing if that is already under way or done
+void Device_Open();
+
+// Waits for a background open to finish; returns true if the device is ready
+bool Device_Wait();
+
+// Whether the last open failed (never waits)
+bool Device_Failed();
+
+// Stops the mixer and closes the device, after an open in progress finished
+void Device_Close();
+
+// Phase timings of the last open
+void Device_ReadTimings(OPEN_HASTARTUPTIMINGS* timings);
+
+#endif // OPENSEGAAPI_DEVICE_H
@@ -0,0 +1,39 @@
+#ifndef OPENSEGAAPI_EXPORTS_H
+#define OPENSEGAAPI_EXPORTS_H
+
+// ----------------------------------------------------------------------
+// Every SEGAAPI_* export, in a fixed order.
+// The index doubles as the opcode in trace files, so only ever append.
+// ----------------------------------------------------------------------
+#define OPENSEGAAPI_EXPORT_LIST(X) \
+    X(Init) X(Exit) X(CreateBuffer) X(DestroyBuffer) X(SetUserData) X(GetUserData) \
+    X(SetFormat) X(GetFormat) X(SetSampleRate) X(GetSampleRate) X(SetPriority) X(GetPriority) \
+    X(SetSendRouting) X(GetSendRouting) X(SetSendLevel) X(GetSendLevel) \
+    X(SetChannelVolume) X(GetChannelVolume) X(SetPlaybackPosition) X(GetPlaybackPosition) \
+    X(SetNotificationFrequency) X(SetNotificationPoint) X(ClearNotificationPoint) \
+    X(SetStartLoopOffset) X(GetStartLoopOffset) X(SetEndLoopOffset) X(GetEndLoopOffset) \
+    X(SetEndOffset) X(GetEndOffset) X(SetLoopState) X(GetLoopState) X(UpdateBuffer) \
+    X(SetSynthParam) X(GetSynthParam) X(SetSynthParamMultiple) X(GetSynthParamMultiple) \
+    X(SetReleaseState) X(Play) X(PlayWithSetup) X(SetGlobalEAXProperty) X(GetGlobalEAXProperty) \
+    X(SetSPDIFOutChannelStatus) X(GetSPDIFOutChannelStatus) X(SetSPDIFOutSampleRate) \
+    X(GetSPDIFOutSampleRate) X(SetSPDIFOutChannelRouting) X(GetSPDIFOutChannelRouting) \
+    X(SetIOVolume) X(GetIOVolume) X(SetLastStatus) X(GetLastStatus) X(Reset) \
+    X(GetStatsCount) X(GetStats) X(ResetStats) X(GetMixerTelemetry) X(ResetMixerTelemetry) \
+    X(GetAudioClock) X(PlayAtTime) X(StopAtTime) X(SetSynthParamAtTime) \
+    X(GetPlaybackPositions) X(Pause) X(Stop) X(GetPlaybackStatus) \
+    X(GetStartupTimings) X(GetAdpcmStats) X(CreateInstance)
+
+enum OPEN_EXPORT {
+#define OPENSEGAAPI_EXPORT_ENUM(name) EXPORT_##name,
+    OPENSEGAAPI_EXPORT_LIST(OPENSEGAAPI_EXPORT_ENUM)
+#undef OPENSEGAAPI_EXPORT_ENUM
+    EXPORT_COUNT
+};
+
+static const char* const g_exportNames[EXPORT_COUNT] = {
+#define OPENSEGAAPI_EXPORT_NAME(name) "SEGAAPI_" #name,
+    OPENSEGAAPI_EXPORT_LIST(OPENSEGAAPI_EXPORT_NAME)
+#undef OPENSEGAAPI_EXPORT_NAME
+};
+
+#endif // OPENSEGAAPI_EXPORTS_H
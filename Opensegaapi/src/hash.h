@@ -0,0 +1,41 @@
+#ifndef OPENSEGAAPI_HASH_H
+#define OPENSEGAAPI_HASH_H
+
+#include <stdint.h>
+#include <string.h>
+
+// ----------------------------------------------------------------------
+// Fast non-cryptographic 64-bit hash for sample data.
+// Consumes 8 bytes per step and finishes with the MurmurHash3 mixer.
+// ----------------------------------------------------------------------
+static inline uint64_t Hash64(const void* data, size_t size, uint64_t seed = 0) {
+    const uint64_t k1 = 0x9E3779B97F4A7C15ull;
+    const uint64_t k2 = 0xFF51AFD7ED558CCDull;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t h = seed ^ (static_cast<uint64_t>(size) * k1);
+
+    while (size >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        v *= k2;
+        v ^= v >> 32;
+        h = (h ^ v) * k1;
+        h ^= h >> 29;
+        p += 8;
+        size -= 8;
+    }
+    if (size) {
+        uint64_t v = 0;
+        memcpy(&v, p, size);
+        h = (h ^ (v * k2)) * k1;
+    }
+
+    h ^= h >> 33;
+    h *= k2;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+#endif // OPENSEGAAPI_HASH_H
@@ -0,0 +1,207 @@
+// latency.cpp - Output latency profile selection and persistence
+//
+// This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+
+#include "latency.h"
+#include "config.h"
+#include "log.h"
+#include "platform.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ======================================================================
+// Profiles tried by the automatic mode, smallest latency first
+// ======================================================================
+struct LatencyStep {
+    unsigned int periodFrames;
+    unsigned int periodCount;
+};
+
+static const LatencyStep g_latencyLadder[] = {
+    { 128, 3 },
+    { 256, 3 },
+    { 256, 4 },
+    { 512, 4 },
+    { 1024, 4 },
+};
+static const unsigned int LATENCY_STEPS = sizeof(g_latencyLadder) / sizeof(g_latencyLadder[0]);
+
+// Two underruns this close together mean the current profile is too tight
+static const std::chrono::seconds LATENCY_UNDERRUN_WINDOW(10);
+// How often the writer looks for a step to store
+static const std::chrono::seconds LATENCY_WRITE_INTERVAL(1);
+
+static bool g_latencyAuto = false;
+static std::atomic<unsigned int> g_latencyStep(0);
+// Stepped up by the render thread since the store was written
+static std::atomic<bool> g_latencyUnsaved(false);
+static unsigned int g_latencyRate = 48000;
+static std::string g_latencyKey;
+static std::string g_latencyPath;
+static bool g_latencyHadUnderrun = false;
+static std::chrono::steady_clock::time_point g_latencyLastUnderrun;
+
+static std::mutex g_latencyWriterLock;
+static std::condition_variable g_latencyWriterWake;
+static bool g_latencyWriterStopping = false;
+static std::thread& g_latencyWriter = *new std::thread();     // left to the exit path, like the mixer's
+
+static LatencyProfile latencyProfile(unsigned int step) {
+    LatencyProfile profile;
+    profile.sampleRate = g_latencyRate;
+    profile.periodFrames = g_latencyLadder[step].periodFrames;
+    profile.periodCount = g_latencyLadder[step].periodCount;
+    return profile;
+}
+
+// ======================================================================
+// Per machine store
+// (One line per "computer|device" key: "<key>\t<period frames> <period count>".
+// Kept as frames/count rather than a ladder index so the ladder can change.)
+// ======================================================================
+static std::string latencyStorePath() {
+    const char* path = ConfigGetString("OPENSEGAAPI_LATENCY_FILE");
+    if (path) return path;
+    return Platform_DataPath("opensegaapi-latency.txt");
+}
+
+static std::vector<std::string> latencyReadStore() {
+    std::vector<std::string> lines;
+    FILE* file = g_latencyPath.empty() ? nullptr : fopen(g_latencyPath.c_str(), "r");
+    if (!file) return lines;
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0]) lines.push_back(line);
+    }
+    fclose(file);
+    return lines;
+}
+
+static bool latencyLoad(unsigned int* step) {
+    for (const std::string& line : latencyReadStore()) {
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos || line.compare(0, tab, g_latencyKey) != 0 || tab != g_latencyKey.size()) continue;
+        unsigned int frames = 0, count = 0;
+        if (sscanf(line.c_str() + tab + 1, "%u %u", &frames, &count) != 2) continue;
+        // First ladder step at least as large as what was stored
+        unsigned int i = 0;
+        while (i + 1 < LATENCY_STEPS &&
+            g_latencyLadder[i].periodFrames * g_latencyLadder[i].periodCount < frames * count) i++;
+        *step = i;
+        return true;
+    }
+    return false;
+}
+
+static void latencySave(unsigned int step) {
+    if (g_latencyPath.empty()) return;
+    std::vector<std::string> lines = latencyReadStore();
+    char entry[512];
+    snprintf(entry, sizeof(entry), "%s\t%u %u", g_latencyKey.c_str(),
+        g_latencyLadder[step].periodFrames, g_latencyLadder[step].periodCount);
+    lines.erase(std::remove_if(lines.begin(), lines.end(), [](const std::string& line) {
+        return line.compare(0, g_latencyKey.size() + 1, g_latencyKey + "\t") == 0;
+    }), lines.end());
+    lines.push_back(entry);
+
+    FILE* file = fopen(g_latencyPath.c_str(), "w");
+    if (!file) {
+        info("Latency: could not write %s", g_latencyPath.c_str());
+        return;
+    }
+    for (const std::string& line : lines) fprintf(file, "%s\n", line.c_str());
+    fclose(file);
+}
+
+static void latencySaveUnsaved() {
+    if (g_latencyUnsaved.exchange(false, std::memory_order_acquire)) latencySave(g_latencyStep.load(std::memory_order_relaxed));
+}
+
+// Polls rather than being woken, so the render thread only sets a flag
+static void latencyWriterMain() {
+    std::unique_lock<std::mutex> lock(g_latencyWriterLock);
+    while (!g_latencyWriterWake.wait_for(lock, LATENCY_WRITE_INTERVAL, [] { return g_latencyWriterStopping; })) {
+        lock.unlock();
+        latencySaveUnsaved();
+        lock.lock();
+    }
+}
+
+// ======================================================================
+// Public interface
+// ======================================================================
+LatencyProfile Latency_Select(const char* deviceName) {
+    g_latencyRate = static_cast<unsigned int>(std::clamp(ConfigGetInt("OPENSEGAAPI_SAMPLE_RATE", 48000), 8000, 192000));
+    int frames = ConfigGetInt("OPENSEGAAPI_PERIOD_FRAMES", 0);
+    int count = ConfigGetInt("OPENSEGAAPI_PERIOD_COUNT", 0);
+    const char* mode = ConfigGetString("OPENSEGAAPI_LATENCY");
+    g_latencyHadUnderrun = false;
+
+    if (frames > 0 || count > 0 || (mode && strcmp(mode, "fixed") == 0)) {
+        g_latencyAuto = false;
+        LatencyProfile profile;
+        profile.sampleRate = g_latencyRate;
+        profile.periodFrames = static_cast<unsigned int>(std::clamp(frames > 0 ? frames : 512, 32, 8192));
+        profile.periodCount = static_cast<unsigned int>(std::clamp(count > 0 ? count : 4, 2, 16));
+        info("Latency: fixed, %u periods of %u frames", profile.periodCount, profile.periodFrames);
+        return profile;
+    }
+
+    g_latencyKey = Platform_ComputerName() + "|" + (deviceName ? deviceName : "");
+    g_latencyPath = latencyStorePath();
+    g_latencyAuto = true;
+    unsigned int step = 0;
+    if (latencyLoad(&step)) info("Latency: using the profile stored for %s", g_latencyKey.c_str());
+    g_latencyStep.store(step);
+    g_latencyUnsaved.store(false);
+
+    LatencyProfile profile = latencyProfile(step);
+    info("Latency: auto, %u periods of %u frames", profile.periodCount, profile.periodFrames);
+    return profile;
+}
+
+// Runs on the render thread, so the store is written by the writer
+bool Latency_OnUnderrun(LatencyProfile* next) {
+    if (!g_latencyAuto) return false;
+    auto now = std::chrono::steady_clock::now();
+    bool repeated = g_latencyHadUnderrun && now - g_latencyLastUnderrun < LATENCY_UNDERRUN_WINDOW;
+    g_latencyHadUnderrun = true;
+    g_latencyLastUnderrun = now;
+    unsigned int step = g_latencyStep.load(std::memory_order_relaxed);
+    if (!repeated || step + 1 >= LATENCY_STEPS) return false;
+
+    g_latencyStep.store(++step, std::memory_order_relaxed);
+    g_latencyUnsaved.store(true, std::memory_order_release);
+    g_latencyHadUnderrun = false;
+    *next = latencyProfile(step);
+    info("Latency: underruns, stepping up to %u periods of %u frames", next->periodCount, next->periodFrames);
+    return true;
+}
+
+void Latency_Start() {
+    if (!g_latencyAuto || g_latencyWriter.joinable()) return;
+    g_latencyWriterStopping = false;
+    g_latencyWriter = std::thread(latencyWriterMain);
+}
+
+void Latency_Stop() {
+    if (g_latencyWriter.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(g_latencyWriterLock);
+            g_latencyWriterStopping = true;
+        }
+        g_latencyWriterWake.notify_one();
+        g_latencyWriter.join();
+    }
+    latencySaveUnsaved();
+}
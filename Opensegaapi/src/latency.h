@@ -0,0 +1,32 @@
+#ifndef OPENSEGAAPI_LATENCY_H
+#define OPENSEGAAPI_LATENCY_H
+
+// ----------------------------------------------------------------------
+// Output latency profile: mixer period size and how many periods are
+// queued to the device.
+// OPENSEGAAPI_PERIOD_FRAMES / OPENSEGAAPI_PERIOD_COUNT pin the profile.
+// Otherwise it is chosen automatically: start at the smallest profile
+// (or the one stored for this machine and device), step up whenever
+// underruns show it is too tight, and store the result so the next boot
+// starts tuned. OPENSEGAAPI_LATENCY=fixed disables the automatic mode.
+// ----------------------------------------------------------------------
+
+struct LatencyProfile {
+    unsigned int sampleRate;
+    unsigned int periodFrames;
+    unsigned int periodCount;
+};
+
+// Picks the starting profile for the given output device
+LatencyProfile Latency_Select(const char* deviceName);
+
+// Called by the mixer for every underrun. Returns true with a larger
+// profile in *next when the mixer should switch to it. The render thread
+// only posts the step; a writer thread, running from Latency_Start to
+// Latency_Stop, stores it within a second.
+bool Latency_OnUnderrun(LatencyProfile* next);
+void Latency_Start();
+// Stops the writer, storing a step it has not stored yet
+void Latency_Stop();
+
+#endif // OPENSEGAAPI_LATENCY_H
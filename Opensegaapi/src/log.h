@@ -0,0 +1,11 @@
+#ifndef OPENSEGAAPI_LOG_H
+#define OPENSEGAAPI_LOG_H
+
+// Debug logging (only if _DEBUG is defined)
+#ifdef _DEBUG
+void info(const char* format, ...);
+#else
+#define info(...) {}
+#endif
+
+#endif // OPENSEGAAPI_LOG_H
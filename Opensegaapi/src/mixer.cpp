@@ -0,0 +1,1155 @@
+// mixer.cpp - Software voice mixer streaming to OpenAL
+//
+// This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+
+#include "mixer.h"
+#include "adpcm.h"
+#include "config.h"
+#include "log.h"
+#include "platform.h"
+#include "synth.h"
+
+#include <AL/al.h>
+#include <AL/alc.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ======================================================================
+// Mixer state
+// ======================================================================
+// Voices that are playing; owned by the render thread
+static std::vector<MixerVoice*> g_mixerVoices;
+static float g_mixerMasterGain = 1.0f;
+
+// Period size/count belong to the render thread once it runs (it may resize
+// them); other threads read them through the telemetry snapshot. The rate
+// only changes in Mixer_Start, but telemetry reads it at any time.
+static std::atomic<unsigned int> g_mixerRate(48000);
+static unsigned int g_mixerPeriodFrames = 512;
+static unsigned int g_mixerPeriodCount = 4;
+
+static ALuint g_mixerSource = 0;
+static std::vector<ALuint> g_mixerBuffers;
+static std::vector<float> g_mixerBus;        // stereo, interleaved
+static std::vector<int16_t> g_mixerOutput;   // stereo, interleaved
+static std::thread& g_mixerThread = *new std::thread();    // never destroyed, see SEGAAPI_Init
+static std::atomic<bool> g_mixerRunning(false);  // the render thread drains the command rings
+static std::atomic<bool> g_mixerStopping(false);
+
+// Audio clock: output frames rendered so far (render thread), and its published copy
+static uint64_t g_mixerClock = 0;
+static std::atomic<uint64_t> g_mixerClockPublished(0);
+
+unsigned int Mixer_FrameBytes(unsigned int sampleFormat, unsigned int channels) {
+    unsigned int sampleBytes = (sampleFormat == OPEN_HASF_UNSIGNED_8PCM) ? 1 : 2;
+    return channels * sampleBytes;
+}
+
+// ======================================================================
+// Command rings
+// (One single producer/single consumer ring per game thread, registered
+// in a fixed table the render thread walks. Threads beyond the table
+// share one ring, serialized among themselves only. While the render
+// thread is not running, whoever finds a ring full applies the pending
+// commands itself.)
+// ======================================================================
+struct MixerRing {
+    static const uint32_t SIZE = 1024;
+    MixerCommand commands[SIZE];
+    alignas(64) std::atomic<uint32_t> head;     // next write, producer
+    alignas(64) std::atomic<uint32_t> tail;     // next read, consumer
+    std::atomic<bool> owned;                    // a live thread produces into it
+};
+
+static const unsigned int MIXER_MAX_RINGS = 64;
+// Output frames a change of rate or pitch glides over
+static const unsigned int MIXER_STEP_RAMP_FRAMES = 256;
+static std::atomic<MixerRing*> g_mixerRings[MIXER_MAX_RINGS];
+static std::atomic<unsigned int> g_mixerRingCount(0);
+static MixerRing g_mixerSharedRing;
+static std::mutex g_mixerSharedLock;         // producers of the shared ring only
+static std::mutex g_mixerOfflineLock;        // draining while the render thread is not running
+
+// Voices removed during the current drain (render thread)
+static std::vector<MixerVoice*> g_mixerRemoved;
+// Removed voices the render thread let go of last, freed by game threads
+static std::atomic<MixerVoice*> g_mixerRetired(nullptr);
+
+// Rings outlive their threads and are handed to the next new thread
+static MixerRing* mixerClaimRing() {
+    unsigned int count = std::min(g_mixerRingCount.load(std::memory_order_acquire), MIXER_MAX_RINGS);
+    for (unsigned int i = 0; i < count; i++) {
+        MixerRing* ring = g_mixerRings[i].load(std::memory_order_acquire);
+        bool expected = false;
+        if (ring && ring->owned.compare_exchange_strong(expected, true, std::memory_order_acquire)) return ring;
+    }
+    unsigned int slot = g_mixerRingCount.fetch_add(1, std::memory_order_acq_rel);
+    if (slot >= MIXER_MAX_RINGS) return &g_mixerSharedRing;
+    MixerRing* ring = new MixerRing();
+    ring->owned.store(true, std::memory_order_relaxed);
+    g_mixerRings[slot].store(ring, std::memory_order_release);
+    return ring;
+}
+
+struct MixerRingOwner {
+    MixerRing* ring = nullptr;
+    ~MixerRingOwner() {
+        if (ring && ring != &g_mixerSharedRing) ring->owned.store(false, std::memory_order_release);
+    }
+};
+
+static MixerRing* mixerThreadRing() {
+    thread_local MixerRingOwner owner;
+    if (!owner.ring) owner.ring = mixerClaimRing();
+    return owner.ring;
+}
+
+static void mixerList(MixerVoice* voice) {
+    if (voice->listed) return;
+    voice->listed = true;
+    voice->mixing.store(true, std::memory_order_relaxed);
+    g_mixerVoices.push_back(voice);
+}
+
+static void mixerUnlist(MixerVoice* voice) {
+    if (!voice->listed) return;
+    auto it = std::find(g_mixerVoices.begin(), g_mixerVoices.end(), voice);
+    if (it != g_mixerVoices.end()) {
+        *it = g_mixerVoices.back();
+        g_mixerVoices.pop_back();
+    }
+    voice->listed = false;
+    voice->mixing.store(false, std::memory_order_release);
+}
+
+// Whether Play generation a comes before b (generations are 30 bit and wrap)
+static bool mixerGenerationBefore(uint32_t a, uint32_t b) {
+    return static_cast<int32_t>((a - b) << 2) < 0;
+}
+
+// ACTIVE/PAUSE to STOP, unless a newer Play took over
+static void mixerVoiceEnded(MixerVoice* voice) {
+    uint32_t current = voice->status.load(std::memory_order_relaxed);
+    while ((current >> 2) == voice->playGeneration && (current & 3) != OPEN_HAWOSTATUS_STOP) {
+        uint32_t stopped = (current & ~3u) | OPEN_HAWOSTATUS_STOP;
+        if (voice->status.compare_exchange_weak(current, stopped, std::memory_order_release, std::memory_order_relaxed)) break;
+    }
+}
+
+static void mixerPublishPosition(MixerVoice* voice) {
+    unsigned int frameBytes = Mixer_FrameBytes(voice->sampleFormat, voice->channels);
+    voice->playbackPosition.store(static_cast<uint32_t>(voice->position >> 32) * frameBytes, std::memory_order_relaxed);
+}
+
+// ======================================================================
+// Scheduled commands
+// (Commands with a future sample time wait in a min-heap ordered by time,
+// then arrival. Each period takes the ones that fall inside it, and the
+// period is rendered in spans split at their frame offsets.)
+// ======================================================================
+struct MixerEvent {
+    uint64_t sequence;
+    MixerCommand command;
+};
+
+static std::vector<MixerEvent> g_mixerSchedule;
+static std::vector<MixerEvent> g_mixerDue;     // events inside the current period, in order
+static uint64_t g_mixerEventSequence = 0;
+
+static bool mixerEventLater(const MixerEvent& a, const MixerEvent& b) {
+    if (a.command.time != b.command.time) return a.command.time > b.command.time;
+    return a.sequence > b.sequence;
+}
+
+static void mixerSchedule(const MixerCommand& command) {
+    g_mixerSchedule.push_back(MixerEvent{ g_mixerEventSequence++, command });
+    std::push_heap(g_mixerSchedule.begin(), g_mixerSchedule.end(), mixerEventLater);
+}
+
+// Drops events for a voice that is going away
+static void mixerUnschedule(MixerVoice* voice) {
+    auto end = std::remove_if(g_mixerSchedule.begin(), g_mixerSchedule.end(),
+        [voice](const MixerEvent& event) { return event.command.voice == voice; });
+    if (end == g_mixerSchedule.end()) return;
+    g_mixerSchedule.erase(end, g_mixerSchedule.end());
+    std::make_heap(g_mixerSchedule.begin(), g_mixerSchedule.end(), mixerEventLater);
+}
+
+// Moves the events before the given sample time into g_mixerDue
+static void mixerTakeDue(uint64_t until) {
+    g_mixerDue.clear();
+    while (!g_mixerSchedule.empty() && g_mixerSchedule.front().command.time < until) {
+        std::pop_heap(g_mixerSchedule.begin(), g_mixerSchedule.end(), mixerEventLater);
+        g_mixerDue.push_back(g_mixerSchedule.back());
+        g_mixerSchedule.pop_back();
+    }
+}
+
+uint64_t Mixer_Clock() {
+    return g_mixerClockPublished.load(std::memory_order_acquire);
+}
+
+// ======================================================================
+// Command application (render thread, or an offline drain)
+// ======================================================================
+static void mixerVoiceMatrix(const MixerVoice* voice, unsigned int channels, float matrix[MAX_VOICE_CHANNELS][2]);
+
+// Synth notes are mono: the gains of all the voice's channels add up
+static void mixerSynthMix(MixerVoice* voice) {
+    if (!voice->synthChannel) return;
+    unsigned int channels = std::min(std::max(voice->channels, 1u), static_cast<unsigned int>(MAX_VOICE_CHANNELS));
+    float matrix[MAX_VOICE_CHANNELS][2];
+    mixerVoiceMatrix(voice, channels, matrix);
+    float left = 0.0f, right = 0.0f;
+    for (unsigned int c = 0; c < channels; c++) {
+        left += matrix[c][0];
+        right += matrix[c][1];
+    }
+    Synth_SetMix(voice->synthChannel, left, right, voice->sampleRate * voice->pitch);
+}
+
+static void mixerSynthNoteOn(MixerVoice* voice) {
+    unsigned int frameBytes = Mixer_FrameBytes(voice->sampleFormat, voice->channels);
+    if (!frameBytes) return;
+    unsigned int endFrame = (voice->loop ? voice->endLoop : voice->endOffset) / frameBytes;
+    unsigned int loopStart = voice->loop ? voice->startLoop / frameBytes : 0;
+    unsigned int loopEnd = voice->loop ? endFrame : 0;
+    Synth_NoteOn(voice->synthChannel, voice->sampleRate, endFrame, loopStart, loopEnd);
+}
+
+static void mixerApply(const MixerCommand& command) {
+    MixerVoice* voice = command.voice;
+    switch (command.type) {
+        case MIXER_CMD_PLAY: {
+            // Stale if paused, stopped or started again since
+            uint32_t scheduled = (command.value << 2) | MIXER_STATUS_SCHEDULED;
+            uint32_t active = (command.value << 2) | OPEN_HAWOSTATUS_ACTIVE;
+            uint32_t current = voice->status.load(std::memory_order_acquire);
+            if (current == scheduled &&
+                !voice->status.compare_exchange_strong(current, active, std::memory_order_acq_rel, std::memory_order_acquire)) break;
+            if (current != scheduled && current != active) break;
+            voice->playGeneration = command.value;
+            if (!voice->playing) voice->step = 0;
+            voice->playing = true;
+            mixerList(voice);
+            if (voice->synthChannel) mixerSynthNoteOn(voice);
+            break;
+        }
+        case MIXER_CMD_PAUSE:
+            if (command.value != voice->playGeneration) break;
+            voice->playing = false;
+            mixerUnlist(voice);
+            mixerPublishPosition(voice);
+            if (voice->synthChannel) Synth_Cut(voice->synthChannel);
+            break;
+        case MIXER_CMD_STOP:
+            // Stale if the voice was started again since
+            if (mixerGenerationBefore(command.value, voice->playGeneration)) break;
+            voice->playGeneration = command.value;
+            voice->playing = false;
+            voice->position = 0;
+            mixerUnlist(voice);
+            mixerPublishPosition(voice);
+            mixerVoiceEnded(voice);
+            if (voice->synthChannel) Synth_Cut(voice->synthChannel);
+            break;
+        case MIXER_CMD_SET_POSITION: {
+            unsigned int frameBytes = Mixer_FrameBytes(voice->sampleFormat, voice->channels);
+            voice->position = frameBytes ? static_cast<uint64_t>(command.value / frameBytes) << 32 : 0;
+            mixerPublishPosition(voice);
+            break;
+        }
+        case MIXER_CMD_SET_SAMPLE_RATE:
+            voice->sampleRate = command.value;
+            mixerSynthMix(voice);
+            break;
+        case MIXER_CMD_SET_FORMAT:
+            voice->sampleFormat = command.value;
+            voice->channels = command.value2;
+            break;
+        case MIXER_CMD_SET_LOOP:            voice->loop = command.value != 0; break;
+        case MIXER_CMD_SET_START_LOOP:      voice->startLoop = command.value; break;
+        case MIXER_CMD_SET_END_LOOP:        voice->endLoop = command.value; break;
+        case MIXER_CMD_SET_END_OFFSET:      voice->endOffset = command.value; break;
+        case MIXER_CMD_SET_GAIN:
+            voice->gain = command.level;
+            mixerSynthMix(voice);
+            break;
+        case MIXER_CMD_SET_PITCH:
+            voice->pitch = command.level;
+            mixerSynthMix(voice);
+            break;
+        case MIXER_CMD_SET_SEND_ROUTE:
+            voice->sendRoutes[command.index] = static_cast<OPEN_HAROUTING>(command.value);
+            voice->sendChannels[command.index] = static_cast<int>(command.value2);
+            mixerSynthMix(voice);
+            break;
+        case MIXER_CMD_SET_SEND_LEVEL:
+            voice->sendVolumes[command.index] = command.level;
+            voice->sendChannels[command.index] = static_cast<int>(command.value2);
+            mixerSynthMix(voice);
+            break;
+        case MIXER_CMD_SET_CHANNEL_VOLUME:
+            voice->channelVolumes[command.index] = command.level;
+            mixerSynthMix(voice);
+            break;
+        case MIXER_CMD_SET_MASTER_GAIN:     g_mixerMasterGain = command.level; break;
+        case MIXER_CMD_RESET:
+            Mixer_DefaultMix(voice);
+            if (voice->synthChannel) {
+                Synth_Reset(voice->synthChannel);
+                mixerSynthMix(voice);
+            }
+            if (mixerGenerationBefore(command.value, voice->playGeneration)) break;
+            voice->playGeneration = command.value;
+            voice->playing = false;
+            voice->position = 0;
+            mixerUnlist(voice);
+            mixerPublishPosition(voice);
+            mixerVoiceEnded(voice);
+            break;
+        case MIXER_CMD_CLEAR_SCHEDULE:      g_mixerSchedule.clear(); break;
+        case MIXER_CMD_SET_ADPCM:           voice->adpcm = static_cast<MixerAdpcmSource*>(command.source); break;
+        case MIXER_CMD_SET_SYNTH_CHANNEL:
+            voice->synthChannel = static_cast<SynthChannel*>(command.source);
+            Synth_OpenChannel(voice->synthChannel);
+            mixerSynthMix(voice);
+            break;
+        case MIXER_CMD_SET_SYNTH_SAMPLES:   Synth_SetSamples(voice->synthChannel, static_cast<SynthSamples*>(command.source)); break;
+        case MIXER_CMD_SET_SYNTH_PARAM:
+            if (voice->synthChannel) Synth_SetParam(voice->synthChannel, command.index, static_cast<int>(command.value));
+            break;
+        case MIXER_CMD_RELEASE:
+            if (command.value == voice->playGeneration && voice->playing && voice->synthChannel) Synth_NoteOff(voice->synthChannel);
+            break;
+        case MIXER_CMD_REMOVE:
+            Synth_FreeChannel(voice->synthChannel);
+            voice->synthChannel = nullptr;
+            voice->playing = false;
+            mixerUnlist(voice);
+            mixerUnschedule(voice);
+            voice->released.store(true, std::memory_order_release);
+            g_mixerRemoved.push_back(voice);
+            break;
+    }
+}
+
+static void mixerDrainRing(MixerRing* ring) {
+    uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint32_t head = ring->head.load(std::memory_order_acquire);
+    for (; tail != head; tail++) {
+        const MixerCommand& command = ring->commands[tail % MixerRing::SIZE];
+        if (command.time > g_mixerClock) mixerSchedule(command);
+        else mixerApply(command);
+    }
+    ring->tail.store(tail, std::memory_order_release);
+}
+
+// Applies every queued command; only one thread drains at a time (the
+// render thread, or a game thread holding g_mixerOfflineLock while it is stopped)
+static void mixerDrain() {
+    unsigned int count = std::min(g_mixerRingCount.load(std::memory_order_acquire), MIXER_MAX_RINGS);
+    for (unsigned int i = 0; i < count; i++) {
+        MixerRing* ring = g_mixerRings[i].load(std::memory_order_acquire);
+        if (ring) mixerDrainRing(ring);
+    }
+    mixerDrainRing(&g_mixerSharedRing);
+
+    // Released only after a full pass, so no command drained above still refers to them
+    for (MixerVoice* voice : g_mixerRemoved) {
+        if (voice->references.fetch_sub(1, std::memory_order_acq_rel) != 1) continue;
+        MixerVoice* top = g_mixerRetired.load(std::memory_order_relaxed);
+        do {
+            voice->retireNext = top;
+        } while (!g_mixerRetired.compare_exchange_weak(top, voice, std::memory_order_release, std::memory_order_relaxed));
+    }
+    g_mixerRemoved.clear();
+}
+
+static bool mixerDrainOffline() {
+    std::lock_guard<std::mutex> lock(g_mixerOfflineLock);
+    if (g_mixerRunning.load(std::memory_order_acquire)) return false;
+    mixerDrain();
+    return true;
+}
+
+static void mixerFreeRetired() {
+    MixerVoice* voice = g_mixerRetired.exchange(nullptr, std::memory_order_acquire);
+    while (voice) {
+        MixerVoice* next = voice->retireNext;
+        delete voice;
+        voice = next;
+    }
+}
+
+void Mixer_Push(const MixerCommand& command) {
+    MixerRing* ring = mixerThreadRing();
+    std::unique_lock<std::mutex> shared(g_mixerSharedLock, std::defer_lock);
+    if (ring == &g_mixerSharedRing) shared.lock();
+    for (;;) {
+        uint32_t head = ring->head.load(std::memory_order_relaxed);
+        if (head - ring->tail.load(std::memory_order_acquire) < MixerRing::SIZE) {
+            ring->commands[head % MixerRing::SIZE] = command;
+            ring->head.store(head + 1, std::memory_order_release);
+            return;
+        }
+        // Full: the render thread empties it within a period
+        if (!mixerDrainOffline()) std::this_thread::yield();
+    }
+}
+
+void Mixer_DefaultMix(MixerVoiceParams* params) {
+    params->gain = 1.0f;
+    params->pitch = 1.0f;
+    // Levels default to full so that a voice given only a route is audible
+    for (int i = 0; i < MAX_ROUTES; i++) {
+        params->sendVolumes[i] = 1.0f;
+        params->sendChannels[i] = 0;
+        params->sendRoutes[i] = OPEN_HA_UNUSED_PORT;
+    }
+    for (int i = 0; i < MAX_VOICE_CHANNELS; i++) {
+        params->channelVolumes[i] = 1.0f;
+    }
+}
+
+MixerVoice* Mixer_CreateVoice(const MixerVoiceParams& params) {
+    mixerFreeRetired();
+    MixerVoice* voice = new MixerVoice();
+    static_cast<MixerVoiceParams&>(*voice) = params;
+    voice->adpcm = nullptr;
+    voice->synthChannel = nullptr;
+    voice->playing = false;
+    voice->listed = false;
+    voice->position = 0;
+    voice->step = 0;
+    voice->stepTarget = 0;
+    voice->stepDelta = 0;
+    voice->rampFrames = 0;
+    voice->retireNext = nullptr;
+    voice->playbackPosition.store(0, std::memory_order_relaxed);
+    voice->playGeneration = 0;
+    voice->status.store(OPEN_HAWOSTATUS_STOP, std::memory_order_relaxed);
+    voice->mixing.store(false, std::memory_order_relaxed);
+    voice->released.store(false, std::memory_order_relaxed);
+    voice->references.store(2, std::memory_order_relaxed);
+    // The engine channel is made here, on the game thread, and handed over
+    if (voice->synth) {
+        SynthChannel* channel = Synth_NewChannel();
+        if (channel) {
+            MixerCommand command = { voice, MIXER_CMD_SET_SYNTH_CHANNEL, 0, 0, 0, 0.0f, 0, channel };
+            Mixer_Push(command);
+        }
+    }
+    return voice;
+}
+
+void Mixer_PlayVoice(MixerVoice* voice, uint64_t time) {
+    uint32_t current = voice->status.load(std::memory_order_relaxed);
+    uint32_t next;
+    do {
+        next = (((current >> 2) + 1) << 2) | (time ? MIXER_STATUS_SCHEDULED : static_cast<uint32_t>(OPEN_HAWOSTATUS_ACTIVE));
+    } while (!voice->status.compare_exchange_weak(current, next, std::memory_order_release, std::memory_order_relaxed));
+    MixerCommand command = { voice, MIXER_CMD_PLAY, 0, next >> 2, 0, 0.0f, time };
+    Mixer_Push(command);
+}
+
+bool Mixer_PauseVoice(MixerVoice* voice) {
+    uint32_t current = voice->status.load(std::memory_order_relaxed);
+    do {
+        if ((current & 3) != OPEN_HAWOSTATUS_ACTIVE && (current & 3) != MIXER_STATUS_SCHEDULED) return false;
+    } while (!voice->status.compare_exchange_weak(current, (current & ~3u) | OPEN_HAWOSTATUS_PAUSE,
+        std::memory_order_release, std::memory_order_relaxed));
+    Mixer_Command(voice, MIXER_CMD_PAUSE, current >> 2);
+    return true;
+}
+
+void Mixer_StopVoice(MixerVoice* voice, uint64_t time) {
+    uint32_t current = voice->status.load(std::memory_order_relaxed);
+    if (!time) {
+        while (!voice->status.compare_exchange_weak(current, (current & ~3u) | OPEN_HAWOSTATUS_STOP,
+            std::memory_order_release, std::memory_order_relaxed)) {}
+        // Read straight after, the position is already back at the start
+        voice->playbackPosition.store(0, std::memory_order_relaxed);
+    }
+    MixerCommand command = { voice, MIXER_CMD_STOP, 0, current >> 2, 0, 0.0f, time };
+    Mixer_Push(command);
+}
+
+void Mixer_ResetVoice(MixerVoice* voice) {
+    uint32_t current = voice->status.load(std::memory_order_relaxed);
+    while (!voice->status.compare_exchange_weak(current, (current & ~3u) | OPEN_HAWOSTATUS_STOP,
+        std::memory_order_release, std::memory_order_relaxed)) {}
+    voice->playbackPosition.store(0, std::memory_order_relaxed);
+    Mixer_Command(voice, MIXER_CMD_RESET, current >> 2);
+}
+
+void Mixer_ReleaseVoice(MixerVoice* voice) {
+    uint32_t current = voice->status.load(std::memory_order_relaxed);
+    if ((current & 3) != OPEN_HAWOSTATUS_ACTIVE) return;
+    Mixer_Command(voice, MIXER_CMD_RELEASE, current >> 2);
+}
+
+void Mixer_ClearSchedule() {
+    Mixer_Command(nullptr, MIXER_CMD_CLEAR_SCHEDULE);
+    mixerFreeRetired();
+}
+
+void Mixer_DestroyVoice(MixerVoice* voice) {
+    // A stopped voice that is not mixed has no pending Play,
+    // so the render thread cannot start reading its data anymore
+    bool inUse = (voice->status.load(std::memory_order_acquire) & 3) != OPEN_HAWOSTATUS_STOP || voice->mixing.load(std::memory_order_acquire);
+    Mixer_Command(voice, MIXER_CMD_REMOVE);
+    if (!mixerDrainOffline() && inUse) {
+        while (!voice->released.load(std::memory_order_acquire) && g_mixerRunning.load(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+    if (voice->references.fetch_sub(1, std::memory_order_acq_rel) == 1) delete voice;
+    mixerFreeRetired();
+    Synth_FreeRetired();
+}
+
+// ======================================================================
+// Telemetry
+// (Written only by the render thread and published through a sequence
+// lock, so readers retry instead of ever making the render thread wait.)
+// ======================================================================
+struct MixerTelemetryState {
+    uint32_t periodFrames;
+    uint32_t periodCount;
+    uint64_t periods;
+    uint64_t underruns;
+    uint32_t renderNsLast;
+    uint32_t renderNsAvg;
+    uint32_t renderNsMax;
+    uint32_t jitterNsMax;
+    uint32_t activeVoices;
+    uint32_t peakVoices;
+};
+
+struct MixerTelemetryShared {
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> periodFrames;
+    std::atomic<uint32_t> periodCount;
+    std::atomic<uint64_t> periods;
+    std::atomic<uint64_t> underruns;
+    std::atomic<uint32_t> renderNsLast;
+    std::atomic<uint32_t> renderNsAvg;
+    std::atomic<uint32_t> renderNsMax;
+    std::atomic<uint32_t> jitterNsMax;
+    std::atomic<uint32_t> activeVoices;
+    std::atomic<uint32_t> peakVoices;
+};
+
+static MixerTelemetryShared g_mixerTelemetry;
+static std::atomic<bool> g_mixerTelemetryReset(false);
+
+static void mixerPublish(const MixerTelemetryState& state) {
+    uint32_t sequence = g_mixerTelemetry.sequence.load(std::memory_order_relaxed);
+    g_mixerTelemetry.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    g_mixerTelemetry.periodFrames.store(state.periodFrames, std::memory_order_relaxed);
+    g_mixerTelemetry.periodCount.store(state.periodCount, std::memory_order_relaxed);
+    g_mixerTelemetry.periods.store(state.periods, std::memory_order_relaxed);
+    g_mixerTelemetry.underruns.store(state.underruns, std::memory_order_relaxed);
+    g_mixerTelemetry.renderNsLast.store(state.renderNsLast, std::memory_order_relaxed);
+    g_mixerTelemetry.renderNsAvg.store(state.renderNsAvg, std::memory_order_relaxed);
+    g_mixerTelemetry.renderNsMax.store(state.renderNsMax, std::memory_order_relaxed);
+    g_mixerTelemetry.jitterNsMax.store(state.jitterNsMax, std::memory_order_relaxed);
+    g_mixerTelemetry.activeVoices.store(state.activeVoices, std::memory_order_relaxed);
+    g_mixerTelemetry.peakVoices.store(state.peakVoices, std::memory_order_relaxed);
+    g_mixerTelemetry.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void Mixer_ReadTelemetry(OPEN_HAMIXERTELEMETRY* telemetry) {
+    MixerTelemetryState state;
+    for (;;) {
+        uint32_t before = g_mixerTelemetry.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        state.periodFrames = g_mixerTelemetry.periodFrames.load(std::memory_order_relaxed);
+        state.periodCount = g_mixerTelemetry.periodCount.load(std::memory_order_relaxed);
+        state.periods = g_mixerTelemetry.periods.load(std::memory_order_relaxed);
+        state.underruns = g_mixerTelemetry.underruns.load(std::memory_order_relaxed);
+        state.renderNsLast = g_mixerTelemetry.renderNsLast.load(std::memory_order_relaxed);
+        state.renderNsAvg = g_mixerTelemetry.renderNsAvg.load(std::memory_order_relaxed);
+        state.renderNsMax = g_mixerTelemetry.renderNsMax.load(std::memory_order_relaxed);
+        state.jitterNsMax = g_mixerTelemetry.jitterNsMax.load(std::memory_order_relaxed);
+        state.activeVoices = g_mixerTelemetry.activeVoices.load(std::memory_order_relaxed);
+        state.peakVoices = g_mixerTelemetry.peakVoices.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (g_mixerTelemetry.sequence.load(std::memory_order_relaxed) == before) break;
+    }
+
+    unsigned int rate = g_mixerRate.load(std::memory_order_relaxed);
+    uint64_t periodNs = static_cast<uint64_t>(state.periodFrames) * 1000000000ull / rate;
+    telemetry->dwSampleRate = rate;
+    telemetry->dwPeriodFrames = state.periodFrames;
+    telemetry->dwPeriodCount = state.periodCount;
+    telemetry->dwPeriodNs = static_cast<unsigned int>(periodNs);
+    telemetry->qwPeriods = state.periods;
+    telemetry->qwUnderruns = state.underruns;
+    telemetry->dwRenderNsLast = state.renderNsLast;
+    telemetry->dwRenderNsAvg = state.renderNsAvg;
+    telemetry->dwRenderNsMax = state.renderNsMax;
+    telemetry->dwJitterNsMax = state.jitterNsMax;
+    telemetry->dwActiveVoices = state.activeVoices;
+    telemetry->dwPeakVoices = state.peakVoices;
+    telemetry->fHeadroomPercent = periodNs ? 100.0f * (1.0f - static_cast<float>(state.renderNsAvg) / periodNs) : 0.0f;
+}
+
+void Mixer_ResetTelemetry() {
+    g_mixerTelemetryReset.store(true, std::memory_order_relaxed);
+}
+
+// ======================================================================
+// Voice rendering
+// ======================================================================
+// Stereo fold-down of a destination port
+static void mixerPortGains(OPEN_HAROUTING port, float* left, float* right) {
+    switch (port) {
+        case OPEN_HA_FRONT_LEFT_PORT:
+        case OPEN_HA_REAR_LEFT_PORT:   *left = 1.0f; *right = 0.0f; break;
+        case OPEN_HA_FRONT_RIGHT_PORT:
+        case OPEN_HA_REAR_RIGHT_PORT:  *left = 0.0f; *right = 1.0f; break;
+        case OPEN_HA_FRONT_CENTER_PORT: *left = 0.7071f; *right = 0.7071f; break;
+        case OPEN_HA_LFE_PORT:         *left = 0.5f; *right = 0.5f; break;
+        default:                       *left = 0.0f; *right = 0.0f; break; // FX slots are not emulated
+    }
+}
+
+// Per source channel left/right gains, including attenuation and channel volume
+static void mixerVoiceMatrix(const MixerVoice* voice, unsigned int channels, float matrix[MAX_VOICE_CHANNELS][2]) {
+    bool routed = false;
+    for (unsigned int c = 0; c < channels; c++) matrix[c][0] = matrix[c][1] = 0.0f;
+    for (int send = 0; send < MAX_ROUTES; send++) {
+        if (voice->sendRoutes[send] == OPEN_HA_UNUSED_PORT) continue;
+        routed = true;
+        unsigned int channel = static_cast<unsigned int>(voice->sendChannels[send]);
+        if (channel >= channels) continue;
+        float left, right;
+        mixerPortGains(voice->sendRoutes[send], &left, &right);
+        matrix[channel][0] += left * voice->sendVolumes[send];
+        matrix[channel][1] += right * voice->sendVolumes[send];
+    }
+    if (!routed) {
+        // No routing set up: mono to both sides, otherwise alternate left/right
+        for (unsigned int c = 0; c < channels; c++) {
+            matrix[c][0] = (channels == 1 || (c & 1) == 0) ? 1.0f : 0.0f;
+            matrix[c][1] = (channels == 1 || (c & 1) == 1) ? 1.0f : 0.0f;
+        }
+    }
+    for (unsigned int c = 0; c < channels; c++) {
+        float scale = voice->gain * voice->channelVolumes[c];
+        matrix[c][0] *= scale;
+        matrix[c][1] *= scale;
+    }
+}
+
+// ======================================================================
+// Sample sources: PCM in place, or ADPCM through a two block cache
+// ======================================================================
+static std::atomic<uint64_t> g_mixerDecodedBlocks(0);
+static std::atomic<uint64_t> g_mixerDecodeNs(0);
+
+static inline const int16_t* mixerFrame(const int16_t* samples, uint64_t frame, unsigned int channels) { return samples + frame * channels; }
+static inline const uint8_t* mixerFrame(const uint8_t* samples, uint64_t frame, unsigned int channels) { return samples + frame * channels; }
+
+// The pointer stays valid across the next call, so a frame and the one
+// after it can be read together even when they lie in different blocks
+static const int16_t* mixerFrame(MixerAdpcmSource* source, uint64_t frame, unsigned int channels) {
+    uint32_t block = static_cast<uint32_t>(frame / ADPCM_BLOCK_FRAMES);
+    if (source->cachedBlock[0] != block) {
+        std::swap(source->cache[0], source->cache[1]);
+        std::swap(source->cachedBlock[0], source->cachedBlock[1]);
+        if (source->cachedBlock[0] != block) {
+            auto start = std::chrono::steady_clock::now();
+            Adpcm_DecodeBlock(source->blocks + static_cast<size_t>(block) * Adpcm_BlockBytes(source->channels), source->channels, source->cache[0]);
+            source->cachedBlock[0] = block;
+            g_mixerDecodedBlocks.fetch_add(1, std::memory_order_relaxed);
+            g_mixerDecodeNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+        }
+    }
+    return source->cache[0] + (frame % ADPCM_BLOCK_FRAMES) * channels;
+}
+
+void Mixer_ReadDecodeStats(uint64_t* blocks, uint64_t* nanoseconds) {
+    *blocks = g_mixerDecodedBlocks.load(std::memory_order_relaxed);
+    *nanoseconds = g_mixerDecodeNs.load(std::memory_order_relaxed);
+}
+
+static inline float mixerSample(const int16_t* frame, unsigned int channel) { return frame[channel] * (1.0f / 32768.0f); }
+static inline float mixerSample(const uint8_t* frame, unsigned int channel) { return (static_cast<int>(frame[channel]) - 128) * (1.0f / 128.0f); }
+
+// Linear interpolating resampler; advances the voice and stops it at its end offset
+template <typename Source>
+static void mixerRenderVoice(MixerVoice* voice, Source samples, unsigned int frameBytes, float* bus, unsigned int frames) {
+    unsigned int channels = std::min(voice->channels, static_cast<unsigned int>(MAX_VOICE_CHANNELS));
+    uint64_t totalFrames = voice->size / frameBytes;
+    uint64_t endFrame = std::min<uint64_t>((voice->loop ? voice->endLoop : voice->endOffset) / frameBytes, totalFrames);
+    uint64_t loopStart = voice->startLoop / frameBytes;
+    bool loop = voice->loop && loopStart < endFrame;
+    if (endFrame == 0) {
+        voice->playing = false;
+        voice->position = 0;
+        return;
+    }
+
+    float matrix[MAX_VOICE_CHANNELS][2];
+    mixerVoiceMatrix(voice, channels, matrix);
+    // A new rate or pitch glides in over MIXER_STEP_RAMP_FRAMES rather than
+    // stepping, since games bend pitch with it every frame. A voice that
+    // just started takes it at once.
+    uint64_t target = static_cast<uint64_t>(static_cast<double>(voice->sampleRate) * voice->pitch / g_mixerRate.load(std::memory_order_relaxed) * 4294967296.0);
+    if (!voice->step) {
+        voice->step = voice->stepTarget = target;
+        voice->rampFrames = 0;
+    } else if (target != voice->stepTarget) {
+        voice->stepTarget = target;
+        voice->stepDelta = (static_cast<int64_t>(target) - static_cast<int64_t>(voice->step)) / MIXER_STEP_RAMP_FRAMES;
+        voice->rampFrames = MIXER_STEP_RAMP_FRAMES;
+    }
+    uint64_t step = voice->step;
+    unsigned int rampFrames = voice->rampFrames;
+    uint64_t position = voice->position;
+
+    for (unsigned int i = 0; i < frames; i++) {
+        uint64_t index = position >> 32;
+        if (index >= endFrame) {
+            if (!loop) {
+                // Like a stopped OpenAL source, the next Play starts from the top
+                voice->playing = false;
+                position = 0;
+                break;
+            }
+            index = loopStart + (index - endFrame) % (endFrame - loopStart);
+            position = (index << 32) | (position & 0xFFFFFFFFull);
+        }
+        uint64_t next = (index + 1 < endFrame) ? index + 1 : (loop ? loopStart : index);
+        float frac = static_cast<uint32_t>(position) * (1.0f / 4294967296.0f);
+
+        auto frameA = mixerFrame(samples, index, voice->channels);
+        auto frameB = mixerFrame(samples, next, voice->channels);
+        float left = 0.0f, right = 0.0f;
+        for (unsigned int c = 0; c < channels; c++) {
+            float a = mixerSample(frameA, c);
+            float b = mixerSample(frameB, c);
+            float s = a + (b - a) * frac;
+            left += s * matrix[c][0];
+            right += s * matrix[c][1];
+        }
+        bus[i * 2] += left;
+        bus[i * 2 + 1] += right;
+        position += step;
+        if (rampFrames) step = --rampFrames ? step + voice->stepDelta : voice->stepTarget;
+    }
+    voice->position = position;
+    voice->step = step;
+    voice->rampFrames = rampFrames;
+}
+
+// Renders voices [first, last) of the list into a bus of the given length
+static void mixerRenderVoices(size_t first, size_t last, float* bus, unsigned int frames) {
+    for (size_t i = first; i < last; i++) {
+        MixerVoice* voice = g_mixerVoices[i];
+        // Synth voices are rendered by the engine, see mixerRenderSpan
+        if (!voice->playing || voice->synth) continue;
+        unsigned int frameBytes = Mixer_FrameBytes(voice->sampleFormat, voice->channels);
+        if (!voice->data || !frameBytes || !voice->sampleRate) {
+            voice->playing = false;
+            continue;
+        }
+        if (voice->adpcm && !voice->adpcm->expanded.load(std::memory_order_acquire))
+            mixerRenderVoice(voice, voice->adpcm, frameBytes, bus, frames);
+        else if (voice->sampleFormat == OPEN_HASF_UNSIGNED_8PCM)
+            mixerRenderVoice(voice, static_cast<const uint8_t*>(voice->data), frameBytes, bus, frames);
+        else
+            mixerRenderVoice(voice, reinterpret_cast<const int16_t*>(voice->data), frameBytes, bus, frames);
+    }
+}
+
+// ======================================================================
+// Parallel rendering
+// (The voice list is cut into chunks. The render thread and a small pool
+// of helpers each start on an even share of the chunks and steal from the
+// others once their own share is done. Chunks render into partial buses
+// that are then summed into the period: one bus per participant normally,
+// or one per chunk in deterministic mode, where the chunking depends only
+// on the voice count and the sum runs in chunk order, so the output is
+// bit-identical whatever the number of threads, including one.)
+// ======================================================================
+static const unsigned int MIXER_MAX_THREADS = 8;
+static const unsigned int MIXER_CHUNK_VOICES = 16;     // smallest chunk
+static const unsigned int MIXER_MAX_CHUNKS = 64;
+
+struct alignas(64) MixerChunkQueue {
+    std::atomic<uint64_t> range;    // next chunk | end << 32
+};
+
+static unsigned int g_mixerThreadCount = 1;             // render thread included
+static bool g_mixerDeterministic = false;
+static std::vector<std::thread>& g_mixerHelpers = *new std::vector<std::thread>();     // like g_mixerThread
+static MixerChunkQueue g_mixerQueues[MIXER_MAX_THREADS];
+static std::vector<float> g_mixerPartials;              // partial buses, one period each
+
+// Current job (written by the render thread before it bumps the generation)
+static unsigned int g_mixerJobFrames = 0;
+static size_t g_mixerJobChunkVoices = 0;
+
+static std::atomic<uint32_t> g_mixerJobGeneration(0);
+static std::atomic<uint32_t> g_mixerJobPending(0);     // helpers still working on the job
+static std::atomic<uint32_t> g_mixerHelpersAsleep(0);
+static std::atomic<bool> g_mixerHelpersStopping(false);
+
+static float* mixerPartial(unsigned int index) {
+    return g_mixerPartials.data() + static_cast<size_t>(index) * g_mixerPeriodFrames * 2;
+}
+
+static bool mixerTakeChunk(unsigned int queue, bool steal, uint32_t* chunk) {
+    std::atomic<uint64_t>& range = g_mixerQueues[queue].range;
+    uint64_t current = range.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t next = static_cast<uint32_t>(current);
+        uint32_t end = static_cast<uint32_t>(current >> 32);
+        if (next >= end) return false;
+        // The owner takes from the front, thieves from the back
+        uint64_t taken = steal ? (static_cast<uint64_t>(end - 1) << 32) | next
+                               : (static_cast<uint64_t>(end) << 32) | (next + 1);
+        if (range.compare_exchange_weak(current, taken, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            *chunk = steal ? end - 1 : next;
+            return true;
+        }
+    }
+}
+
+static void mixerRenderChunks(unsigned int self) {
+    unsigned int frames = g_mixerJobFrames;
+    size_t chunkVoices = g_mixerJobChunkVoices;
+    size_t voices = g_mixerVoices.size();
+    float* own = nullptr;
+    if (!g_mixerDeterministic) {
+        own = mixerPartial(self);
+        std::fill(own, own + frames * 2, 0.0f);
+    }
+    for (;;) {
+        uint32_t chunk;
+        bool found = mixerTakeChunk(self, false, &chunk);
+        for (unsigned int i = 1; !found && i < g_mixerThreadCount; i++)
+            found = mixerTakeChunk((self + i) % g_mixerThreadCount, true, &chunk);
+        if (!found) return;
+
+        float* bus = own;
+        if (!bus) {
+            bus = mixerPartial(chunk);
+            std::fill(bus, bus + frames * 2, 0.0f);
+        }
+        size_t first = chunk * chunkVoices;
+        mixerRenderVoices(first, std::min(first + chunkVoices, voices), bus, frames);
+    }
+}
+
+// Helpers run a level below the render thread and sleep between jobs
+// rather than spin, so they never take a core from the game for longer
+// than their share of a period
+static void mixerHelperMain(unsigned int self) {
+    Platform_RealtimeThread(1);
+    uint32_t seen = g_mixerJobGeneration.load(std::memory_order_acquire);
+    for (;;) {
+        while (g_mixerJobGeneration.load() == seen) {
+            // The render thread bumps the generation before it looks for
+            // sleepers, and the wait only sleeps while it is unchanged
+            g_mixerHelpersAsleep++;
+            Platform_WaitOnAddress(&g_mixerJobGeneration, seen);
+            g_mixerHelpersAsleep--;
+        }
+        seen = g_mixerJobGeneration.load(std::memory_order_acquire);
+        if (g_mixerHelpersStopping.load()) return;
+        mixerRenderChunks(self);
+        if (g_mixerJobPending.fetch_sub(1, std::memory_order_release) == 1) Platform_WakeAddress(&g_mixerJobPending);
+    }
+}
+
+static void mixerWakeHelpers() {
+    g_mixerJobGeneration++;
+    if (g_mixerHelpersAsleep.load() > 0) Platform_WakeAddress(&g_mixerJobGeneration);
+}
+
+static void mixerStartHelpers() {
+    int threads = ConfigGetInt("OPENSEGAAPI_MIXER_THREADS", 0);
+    if (threads <= 0) threads = static_cast<int>(std::thread::hardware_concurrency() / 2);
+    // Helpers sleep on the job generation, which needs WaitOnAddress
+    if (!Platform_CanWaitOnAddress()) threads = 1;
+    g_mixerThreadCount = static_cast<unsigned int>(std::clamp(threads, 1, static_cast<int>(MIXER_MAX_THREADS)));
+    g_mixerDeterministic = ConfigGetInt("OPENSEGAAPI_MIXER_DETERMINISTIC", 0) != 0;
+    g_mixerHelpersStopping.store(false);
+    for (unsigned int i = 1; i < g_mixerThreadCount; i++) g_mixerHelpers.emplace_back(mixerHelperMain, i);
+    info("Mixer: %u render thread(s)%s", g_mixerThreadCount, g_mixerDeterministic ? ", deterministic" : "");
+}
+
+static void mixerStopHelpers() {
+    g_mixerHelpersStopping.store(true);
+    mixerWakeHelpers();
+    for (std::thread& helper : g_mixerHelpers) helper.join();
+    g_mixerHelpers.clear();
+}
+
+// Adds the partial buses into the bus, one block of the bus at a time so it stays in cache
+static void mixerReduce(float* bus, unsigned int frames, unsigned int partials) {
+    const size_t BLOCK = 256;
+    size_t count = static_cast<size_t>(frames) * 2;
+    for (size_t at = 0; at < count; at += BLOCK) {
+        size_t n = std::min(BLOCK, count - at);
+        for (unsigned int p = 0; p < partials; p++) {
+            const float* partial = mixerPartial(p) + at;
+            for (size_t i = 0; i < n; i++) bus[at + i] += partial[i];
+        }
+    }
+}
+
+// Renders the playing PCM voices into a span of the bus, in parallel when worth it
+static void mixerRenderPcm(float* bus, unsigned int frames) {
+    size_t voices = g_mixerVoices.size();
+    if (!g_mixerDeterministic && (g_mixerThreadCount == 1 || voices < 2 * MIXER_CHUNK_VOICES)) {
+        mixerRenderVoices(0, voices, bus, frames);
+        return;
+    }
+
+    size_t chunkVoices = std::max<size_t>(MIXER_CHUNK_VOICES, (voices + MIXER_MAX_CHUNKS - 1) / MIXER_MAX_CHUNKS);
+    uint32_t chunks = static_cast<uint32_t>((voices + chunkVoices - 1) / chunkVoices);
+    if (chunks == 0) return;
+    // Too little work to be worth waking the helpers
+    unsigned int participants = chunks > 1 ? g_mixerThreadCount : 1;
+    for (unsigned int p = 0; p < g_mixerThreadCount; p++) {
+        uint64_t first = p < participants ? static_cast<uint64_t>(chunks) * p / participants : 0;
+        uint64_t last = p < participants ? static_cast<uint64_t>(chunks) * (p + 1) / participants : 0;
+        g_mixerQueues[p].range.store((last << 32) | first, std::memory_order_relaxed);
+    }
+    g_mixerJobFrames = frames;
+    g_mixerJobChunkVoices = chunkVoices;
+
+    if (participants > 1) {
+        g_mixerJobPending.store(participants - 1, std::memory_order_relaxed);
+        mixerWakeHelpers();
+    }
+    mixerRenderChunks(0);
+    // A yield would not let a helper of lower priority run on this core
+    for (uint32_t pending; (pending = g_mixerJobPending.load(std::memory_order_acquire)) != 0; )
+        Platform_WaitOnAddress(&g_mixerJobPending, pending);
+
+    mixerReduce(bus, frames, g_mixerDeterministic ? chunks : participants);
+}
+
+// Renders the playing voices into frames [start, end) of the bus
+static void mixerRenderSpan(unsigned int start, unsigned int end) {
+    float* bus = g_mixerBus.data() + start * 2;
+    unsigned int frames = end - start;
+    mixerRenderPcm(bus, frames);
+    // Synth notes go straight into the bus, on this thread only
+    Synth_Render(bus, frames);
+}
+
+static unsigned int mixerRenderPeriod() {
+    mixerDrain();
+    unsigned int frames = g_mixerPeriodFrames;
+    std::fill(g_mixerBus.begin(), g_mixerBus.end(), 0.0f);
+
+    // Split the period at every scheduled event so each lands on its exact frame
+    mixerTakeDue(g_mixerClock + frames);
+    unsigned int start = 0;
+    size_t next = 0;
+    while (start < frames) {
+        while (next < g_mixerDue.size() && g_mixerDue[next].command.time <= g_mixerClock + start)
+            mixerApply(g_mixerDue[next++].command);
+        unsigned int end = next < g_mixerDue.size() ? static_cast<unsigned int>(g_mixerDue[next].command.time - g_mixerClock) : frames;
+        mixerRenderSpan(start, end);
+        start = end;
+    }
+    g_mixerClock += frames;
+    g_mixerClockPublished.store(g_mixerClock, std::memory_order_release);
+
+    // Voices that reached their end leave the list until the next Play
+    unsigned int active = static_cast<unsigned int>(g_mixerVoices.size());
+    for (size_t i = 0; i < g_mixerVoices.size();) {
+        MixerVoice* voice = g_mixerVoices[i];
+        mixerPublishPosition(voice);
+        if (voice->synth) voice->playing = voice->playing && voice->synthChannel && Synth_Sounding(voice->synthChannel);
+        if (voice->playing) {
+            i++;
+            continue;
+        }
+        mixerVoiceEnded(voice);
+        mixerUnlist(voice);
+    }
+
+    for (size_t i = 0; i < g_mixerBus.size(); i++) {
+        float s = std::clamp(g_mixerBus[i] * g_mixerMasterGain, -1.0f, 1.0f);
+        g_mixerOutput[i] = static_cast<int16_t>(s * 32767.0f);
+    }
+    return active;
+}
+
+// ======================================================================
+// Render thread
+// ======================================================================
+static void mixerQueuePeriod(ALuint buffer) {
+    alBufferData(buffer, AL_FORMAT_STEREO16, g_mixerOutput.data(),
+        static_cast<ALsizei>(g_mixerOutput.size() * sizeof(int16_t)), g_mixerRate.load(std::memory_order_relaxed));
+    alSourceQueueBuffers(g_mixerSource, 1, &buffer);
+}
+
+// (Re)creates the ring of device buffers for the current period size and count
+static bool mixerCreateRing() {
+    g_mixerBus.assign(g_mixerPeriodFrames * 2, 0.0f);
+    g_mixerPartials.assign(static_cast<size_t>(g_mixerDeterministic ? MIXER_MAX_CHUNKS : g_mixerThreadCount) * g_mixerPeriodFrames * 2, 0.0f);
+    g_mixerOutput.assign(g_mixerPeriodFrames * 2, 0);
+    g_mixerBuffers.assign(g_mixerPeriodCount, 0);
+    alGetError();
+    alGenBuffers(static_cast<ALsizei>(g_mixerPeriodCount), g_mixerBuffers.data());
+    return alGetError() == AL_NO_ERROR;
+}
+
+static void mixerDestroyRing() {
+    alSourceStop(g_mixerSource);
+    alSourcei(g_mixerSource, AL_BUFFER, 0);
+    alDeleteBuffers(static_cast<ALsizei>(g_mixerBuffers.size()), g_mixerBuffers.data());
+    g_mixerBuffers.clear();
+}
+
+// Fills the whole ring and starts the source
+static void mixerPrime() {
+    for (ALuint buffer : g_mixerBuffers) {
+        mixerRenderPeriod();
+        mixerQueuePeriod(buffer);
+    }
+    alSourcePlay(g_mixerSource);
+}
+
+static void mixerMain() {
+    using clock = std::chrono::steady_clock;
+    Platform_RealtimeThread();
+    uint64_t periodNs = static_cast<uint64_t>(g_mixerPeriodFrames) * 1000000000ull / g_mixerRate.load(std::memory_order_relaxed);
+    MixerTelemetryState state = {};
+    state.periodFrames = g_mixerPeriodFrames;
+    state.periodCount = g_mixerPeriodCount;
+
+    mixerPrime();
+    clock::time_point lastRefill = clock::now();
+
+    while (!g_mixerStopping.load(std::memory_order_relaxed)) {
+        ALint processed = 0;
+        alGetSourcei(g_mixerSource, AL_BUFFERS_PROCESSED, &processed);
+        if (processed > 0) {
+            if (g_mixerTelemetryReset.exchange(false, std::memory_order_relaxed)) {
+                state = {};
+                state.periodFrames = g_mixerPeriodFrames;
+                state.periodCount = g_mixerPeriodCount;
+            }
+
+            // Lateness: time since the last refill beyond the audio that was consumed meanwhile
+            clock::time_point now = clock::now();
+            uint64_t sinceRefill = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastRefill).count());
+            uint64_t consumed = periodNs * static_cast<uint64_t>(processed);
+            if (sinceRefill > consumed)
+                state.jitterNsMax = std::max(state.jitterNsMax, static_cast<uint32_t>(std::min<uint64_t>(sinceRefill - consumed, UINT32_MAX)));
+            lastRefill = now;
+
+            for (ALint i = 0; i < processed; i++) {
+                ALuint buffer = 0;
+                alSourceUnqueueBuffers(g_mixerSource, 1, &buffer);
+                clock::time_point start = clock::now();
+                unsigned int active = mixerRenderPeriod();
+                uint32_t renderNs = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+                mixerQueuePeriod(buffer);
+
+                state.periods++;
+                state.renderNsLast = renderNs;
+                state.renderNsAvg = state.periods == 1 ? renderNs : state.renderNsAvg - state.renderNsAvg / 16 + renderNs / 16;
+                state.renderNsMax = std::max(state.renderNsMax, renderNs);
+                state.activeVoices = active;
+                state.peakVoices = std::max(state.peakVoices, active);
+            }
+
+            // The source stops by itself once every queued period has played out
+            ALint sourceState = AL_PLAYING;
+            alGetSourcei(g_mixerSource, AL_SOURCE_STATE, &sourceState);
+            if (sourceState != AL_PLAYING) {
+                state.underruns++;
+                LatencyProfile next;
+                if (Latency_OnUnderrun(&next)) {
+                    // Too tight for this machine: rebuild the ring with the larger profile
+                    mixerDestroyRing();
+                    g_mixerPeriodFrames = next.periodFrames;
+                    g_mixerPeriodCount = next.periodCount;
+                    if (!mixerCreateRing()) info("Mixer: could not resize the buffer ring");
+                    periodNs = static_cast<uint64_t>(g_mixerPeriodFrames) * 1000000000ull / g_mixerRate.load(std::memory_order_relaxed);
+                    state.periodFrames = g_mixerPeriodFrames;
+                    state.periodCount = g_mixerPeriodCount;
+                    mixerPrime();
+                    lastRefill = clock::now();
+                } else {
+                    alSourcePlay(g_mixerSource);
+                }
+            }
+            mixerPublish(state);
+        }
+        std::this_thread::sleep_for(std::chrono::nanoseconds(std::max<uint64_t>(periodNs / 2, 1000000)));
+    }
+}
+
+bool Mixer_Start(const LatencyProfile& profile) {
+    // Game threads may be draining commands offline while this runs
+    std::lock_guard<std::mutex> lock(g_mixerOfflineLock);
+    if (g_mixerRunning.load()) return true;
+    g_mixerRate.store(profile.sampleRate);
+    g_mixerPeriodFrames = profile.periodFrames;
+    g_mixerPeriodCount = profile.periodCount;
+    Synth_SetOutput(profile.sampleRate);
+
+    mixerStartHelpers();
+    alGetError();
+    alGenSources(1, &g_mixerSource);
+    if (alGetError() != AL_NO_ERROR || !mixerCreateRing()) {
+        info("Mixer: could not create OpenAL source/buffers");
+        mixerStopHelpers();
+        return false;
+    }
+    g_mixerVoices.reserve(1024);
+    g_mixerSchedule.reserve(1024);
+    g_mixerDue.reserve(1024);
+
+    info("Mixer: %u Hz, %u periods of %u frames", profile.sampleRate, g_mixerPeriodCount, g_mixerPeriodFrames);
+    MixerTelemetryState state = {};
+    state.periodFrames = g_mixerPeriodFrames;
+    state.periodCount = g_mixerPeriodCount;
+    mixerPublish(state);
+
+    // 1 ms timer resolution so the render thread wakes up on time
+    Platform_BeginTimerPeriod();
+    g_mixerStopping.store(false);
+    g_mixerRunning.store(true);
+    g_mixerThread = std::thread(mixerMain);
+    Latency_Start();
+    return true;
+}
+
+void Mixer_Stop() {
+    if (!g_mixerRunning.load() || g_mixerStopping.exchange(true)) return;
+    g_mixerThread.join();
+    mixerStopHelpers();
+    Latency_Stop();
+    {
+        // From here on commands are drained by whoever pushes them
+        std::lock_guard<std::mutex> lock(g_mixerOfflineLock);
+        g_mixerRunning.store(false);
+    }
+    Platform_EndTimerPeriod();
+    mixerDestroyRing();
+    alDeleteSources(1, &g_mixerSource);
+    g_mixerSource = 0;
+}
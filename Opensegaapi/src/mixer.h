@@ -0,0 +1,239 @@
+#ifndef OPENSEGAAPI_MIXER_H
+#define OPENSEGAAPI_MIXER_H
+
+#include "opensegaapi.h"
+#include "latency.h"
+
+#include <atomic>
+#include <cstdint>
+
+// ----------------------------------------------------------------------
+// Software mixer.
+// All voices are resampled and mixed into fixed size stereo periods on a
+// high priority render thread, which streams them to a single OpenAL
+// source through a small ring of queued buffers. This gives one well
+// defined periodic deadline that can be measured (see
+// SEGAAPI_GetMixerTelemetry).
+//
+// The render thread owns all voice state. API calls push small commands
+// onto a ring owned by the calling thread (one producer, one consumer),
+// and the mixer applies them at the start of every period. Game threads
+// never wait for audio work and the mixer never takes a lock. What the
+// game reads back is either its own copy of the settings or published
+// by the mixer through atomics (position, status).
+// ----------------------------------------------------------------------
+
+// Number of sends per voice
+#define MAX_ROUTES 7
+// Channels a voice can carry (one volume per channel)
+#define MAX_VOICE_CHANNELS 6
+
+struct SynthChannel;
+struct SynthSamples;
+
+// Settings of a voice, as changed by commands
+struct MixerVoiceParams {
+    // Sample data, owned by the buffer
+    uint8_t* data;
+    unsigned int size;          // size in bytes
+    unsigned int sampleRate;
+    unsigned int sampleFormat;  // OPEN_HASF_*
+    unsigned int channels;
+
+    bool loop;
+    bool synth;                 // played by the synth engine (OPEN_HABUF_SYNTH_BUFFER, see synth.h)
+
+    // Looping offsets (bytes)
+    unsigned int startLoop;
+    unsigned int endLoop;
+    unsigned int endOffset;
+
+    // Synth state
+    float gain;                 // from OPEN_HAVP_ATTENUATION
+    float pitch;                // rate multiplier from OPEN_HAVP_PITCH
+
+    // Routing / volume
+    float sendVolumes[MAX_ROUTES];
+    int sendChannels[MAX_ROUTES];
+    OPEN_HAROUTING sendRoutes[MAX_ROUTES];
+    float channelVolumes[MAX_VOICE_CHANNELS];
+};
+
+// Sample data held as IMA-ADPCM (see adpcm.h) instead of PCM, decoded
+// a block at a time while rendering
+struct MixerAdpcmSource {
+    const uint8_t* blocks;
+    unsigned int channels;
+    std::atomic<bool> expanded;     // PCM is back in the voice data; the blocks are no longer read
+    // Render thread only: the two most recently used blocks, decoded
+    int16_t* cache[2];
+    uint32_t cachedBlock[2];
+};
+
+struct MixerVoice : MixerVoiceParams {
+    // Render thread only
+    MixerAdpcmSource* adpcm;    // nullptr when the data is PCM
+    SynthChannel* synthChannel; // synth voices, given by Mixer_CreateVoice
+    bool playing;
+    bool listed;                // in the list of voices being rendered
+    uint32_t playGeneration;    // Play call the voice is currently following
+    uint64_t position;          // frames, 32.32 fixed point
+    // Resampling step (32.32) and its glide towards a new rate or pitch
+    uint64_t step;              // 0 until the first frame after a start
+    uint64_t stepTarget;
+    int64_t stepDelta;
+    unsigned int rampFrames;    // frames left in the glide
+    MixerVoice* retireNext;
+
+    // Shared with game threads
+    std::atomic<uint32_t> playbackPosition; // bytes, published every period
+    std::atomic<uint32_t> status;           // see Mixer_VoiceStatus
+    std::atomic<bool> mixing;               // the mixer may be reading the sample data
+    std::atomic<bool> released;             // removed; the sample data is no longer read
+    std::atomic<uint32_t> references;       // render thread and destroying thread; the last one frees it
+};
+
+enum MixerCommandType {
+    MIXER_CMD_PLAY,                 // value: Play generation
+    MIXER_CMD_PAUSE,                // value: Play generation
+    MIXER_CMD_STOP,                 // value: Play generation; also rewinds
+    MIXER_CMD_SET_POSITION,         // value: byte offset
+    MIXER_CMD_SET_SAMPLE_RATE,      // value: rate
+    MIXER_CMD_SET_FORMAT,           // value: OPEN_HASF_*, value2: channels
+    MIXER_CMD_SET_LOOP,             // value: 0/1
+    MIXER_CMD_SET_START_LOOP,       // value: byte offset
+    MIXER_CMD_SET_END_LOOP,         // value: byte offset
+    MIXER_CMD_SET_END_OFFSET,       // value: byte offset
+    MIXER_CMD_SET_GAIN,             // level
+    MIXER_CMD_SET_PITCH,            // level
+    MIXER_CMD_SET_SEND_ROUTE,       // index: send, value: OPEN_HAROUTING, value2: channel
+    MIXER_CMD_SET_SEND_LEVEL,       // index: send, value2: channel, level
+    MIXER_CMD_SET_CHANNEL_VOLUME,   // index: channel, level
+    MIXER_CMD_SET_MASTER_GAIN,      // no voice; level
+    MIXER_CMD_RESET,                // value: Play generation; stops, rewinds and restores the default mix
+    MIXER_CMD_CLEAR_SCHEDULE,       // no voice; drops every scheduled command
+    MIXER_CMD_SET_ADPCM,            // source: MixerAdpcmSource, nullptr for PCM
+    MIXER_CMD_SET_SYNTH_CHANNEL,    // source: SynthChannel
+    MIXER_CMD_SET_SYNTH_SAMPLES,    // source: SynthSamples
+    MIXER_CMD_SET_SYNTH_PARAM,      // index: OPEN_HAVP_*, value: the value
+    MIXER_CMD_RELEASE,              // value: Play generation; synth voices start their release
+    MIXER_CMD_REMOVE
+};
+
+// Fields a command does not use may be left out of its initializer
+struct MixerCommand {
+    MixerVoice* voice = nullptr;
+    uint32_t type = 0;
+    uint32_t index = 0;
+    uint32_t value = 0;
+    uint32_t value2 = 0;
+    float level = 0.0f;
+    uint64_t time = 0;      // output sample time to apply it at (see Mixer_Clock), 0 for at once
+    void* source = nullptr;
+};
+
+// Bytes per frame of a sample format
+unsigned int Mixer_FrameBytes(unsigned int sampleFormat, unsigned int channels);
+
+// Starts/stops the render thread; requires a current OpenAL context.
+// In automatic latency mode the mixer may move to a larger profile on underruns.
+// Commands pushed while the mixer is stopped are applied when it starts.
+bool Mixer_Start(const LatencyProfile& profile);
+void Mixer_Stop();
+
+// Sets the gain, pitch, routing and volumes a new voice starts with
+void Mixer_DefaultMix(MixerVoiceParams* params);
+
+// Creates a stopped voice with the given settings
+MixerVoice* Mixer_CreateVoice(const MixerVoiceParams& params);
+// Removes a voice. Returns once the mixer no longer reads its sample data;
+// the voice itself is freed once the render thread has let go of it too.
+void Mixer_DestroyVoice(MixerVoice* voice);
+
+// ----------------------------------------------------------------------
+// Voice status word: OPEN_HAWOSTATUS in the low two bits and a count of
+// Play calls above them. Game threads move it on Play/Pause/Stop; the
+// mixer only moves ACTIVE to STOP, at the end of the data or a scheduled
+// stop, and only for the Play it is following, so a voice started again
+// meanwhile never reads as stopped. A Play at a sample time leaves the
+// bits at MIXER_STATUS_SCHEDULED, which reads as STOP, until the mixer
+// reaches that frame and moves them to ACTIVE.
+// ----------------------------------------------------------------------
+#define MIXER_STATUS_SCHEDULED 3u
+
+inline OPEN_HAWOSTATUS Mixer_VoiceStatus(const MixerVoice* voice) {
+    uint32_t bits = voice->status.load(std::memory_order_acquire) & 3;
+    if (bits == MIXER_STATUS_SCHEDULED) return OPEN_HAWOSTATUS_STOP;
+    return static_cast<OPEN_HAWOSTATUS>(bits);
+}
+
+// Whether a Play is started or scheduled
+inline bool Mixer_VoiceStarted(const MixerVoice* voice) {
+    uint32_t bits = voice->status.load(std::memory_order_acquire) & 3;
+    return bits == OPEN_HAWOSTATUS_ACTIVE || bits == MIXER_STATUS_SCHEDULED;
+}
+
+// Whether the mixer neither reads the sample data nor will before the next Play
+inline bool Mixer_VoiceIdle(const MixerVoice* voice) {
+    return !Mixer_VoiceStarted(voice) && !voice->mixing.load(std::memory_order_acquire);
+}
+
+// Play (or resume) at once or at a sample time
+// (a scheduled Play reads as STOP until its frame is rendered)
+void Mixer_PlayVoice(MixerVoice* voice, uint64_t time);
+// Pauses an active voice, keeping its position, or holds back a scheduled
+// Play; returns false if neither was pending
+bool Mixer_PauseVoice(MixerVoice* voice);
+// Stops and rewinds at once, or at a sample time (a scheduled stop only
+// applies if the voice was not started again in between)
+void Mixer_StopVoice(MixerVoice* voice, uint64_t time);
+// Stops and rewinds at once and restores the default mix (see Mixer_DefaultMix)
+void Mixer_ResetVoice(MixerVoice* voice);
+// Starts the release of a synth voice's note; it stops once that ends
+void Mixer_ReleaseVoice(MixerVoice* voice);
+// Drops all scheduled commands not yet applied and frees voices the mixer let go of
+void Mixer_ClearSchedule();
+
+// Queues a command for the render thread; never blocks on it.
+// Timed commands are applied at their exact frame within the period that
+// contains it; times already rendered apply at the start of the next period.
+void Mixer_Push(const MixerCommand& command);
+
+// Output sample time of the next frame the mixer will render
+// (frames at the output rate since the mixer first started)
+uint64_t Mixer_Clock();
+
+// Commands carrying values / carrying a level
+inline void Mixer_Command(MixerVoice* voice, MixerCommandType type, uint32_t value = 0, uint32_t value2 = 0) {
+    MixerCommand command = { voice, static_cast<uint32_t>(type), 0, value, value2, 0.0f, 0 };
+    Mixer_Push(command);
+}
+
+inline void Mixer_Command(MixerVoice* voice, MixerCommandType type, uint32_t index, uint32_t value2, float level) {
+    MixerCommand command = { voice, static_cast<uint32_t>(type), index, 0, value2, level, 0 };
+    Mixer_Push(command);
+}
+
+// Switches a voice between its PCM data and an ADPCM copy of it. The
+// source must stay valid until the voice is destroyed or switched again.
+inline void Mixer_SetAdpcm(MixerVoice* voice, MixerAdpcmSource* source) {
+    MixerCommand command = { voice, MIXER_CMD_SET_ADPCM, 0, 0, 0, 0.0f, 0, source };
+    Mixer_Push(command);
+}
+
+// Gives a synth voice a new copy of its samples (see Synth_NewSamples);
+// the mixer owns it from then on
+inline void Mixer_SetSynthSamples(MixerVoice* voice, SynthSamples* samples) {
+    MixerCommand command = { voice, MIXER_CMD_SET_SYNTH_SAMPLES, 0, 0, 0, 0.0f, 0, samples };
+    Mixer_Push(command);
+}
+
+// ADPCM blocks decoded by the mixer so far, and the time spent on them
+void Mixer_ReadDecodeStats(uint64_t* blocks, uint64_t* nanoseconds);
+
+// Lock-free snapshot of render timing; never blocks the render thread
+void Mixer_ReadTelemetry(OPEN_HAMIXERTELEMETRY* telemetry);
+// Clears counters and maxima (applied by the render thread at its next period)
+void Mixer_ResetTelemetry();
+
+#endif // OPENSEGAAPI_MIXER_H
@@ -7,14 +7,24 @@ extern "C" {
 #include "opensegaapi.h"
 }
 
-#include <AL/al.h>
-#include <AL/alc.h>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
 #include <algorithm>
 #include <cstdarg>
 #include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "device.h"
+#include "hash.h"
+#include "log.h"
+#include "mixer.h"
+#include "platform.h"
+#include "samples.h"
+#include "synth.h"
+#include "trace.h"
 
 // ======================================================================
 // Global status and helper functions
@@ -34,96 +44,141 @@ void info(const char* format, ...) {
     vsnprintf(buffer, sizeof(buffer), format, args);
     va_end(args);
     strcat(buffer, "\n");
-    OutputDebugStringA(buffer);
+    Platform_DebugOutput(buffer);
 }
-#else
-#define info(x) {}
 #endif
 
-// ======================================================================
-// Global OpenAL device and context
-// ======================================================================
-static ALCdevice* g_alDevice = nullptr;
-static ALCcontext* g_alContext = nullptr;
-
 // ======================================================================
 // Internal Buffer Structure (converted from XAudio2 version)
+// (The voice settings are the game side copy returned by the getters;
+// changes reach the mixer as commands, see mixer.h.)
 // ======================================================================
-struct OPEN_segaapiBuffer_t {
-    // OpenAL objects
-    ALuint alBuffer;
-    ALuint alSource;
-    
-    // Audio parameters
-    unsigned int sampleRate;
-    unsigned int channels;
-    unsigned int size;      // size in bytes
-    uint8_t* data;          // pointer to audio data
-    
-    // Playback state
-    bool playing;
-    bool loop;
-    unsigned int currentPosition; // byte offset
+#define NUM_SYNTH_PARAMS (OPEN_HAVP_MOD_ENV_TO_FILTER_CUTOFF + 1)
+
+struct OPEN_segaapiBuffer_t : MixerVoiceParams {
+    MixerVoice* voice;      // owned by the mixer
+    bool userMem;           // data belongs to the caller
+    SampleMemory* memory;   // data allocated here (nullptr for user memory)
     
-    // Looping offsets
-    unsigned int startLoop;
-    unsigned int endLoop;
-    unsigned int endOffset;
+    // Instances (SEGAAPI_CreateInstance) play the data of the buffer they
+    // were made from; that buffer stays allocated until the last one is gone
+    OPEN_segaapiBuffer_t* owner;        // buffer holding the data, nullptr if this one does
+    std::atomic<unsigned int> references;   // this handle and its instances
+    std::atomic<uint32_t> dataGeneration;   // UpdateBuffer calls on the data, through any handle
     
     // Additional properties
     unsigned int priority;
     void* userData;
     
-    // Routing / volume parameters (stored only; not used by OpenAL directly)
-    float sendVolumes[MAX_ROUTES];
-    int sendChannels[MAX_ROUTES];
-    OPEN_HAROUTING sendRoutes[MAX_ROUTES];
-    float channelVolumes[6];
+    // Synth parameters as last set, returned unchanged by the getters
+    int synthParams[NUM_SYNTH_PARAMS];
+    uint32_t synthParamsSet;    // one bit per parameter set since creation or SEGAAPI_Reset
+    
+    // Synth buffers: the data the synth engine last got a copy of, by the
+    // owner's dataGeneration, and by hash once that moved
+    uint32_t synthGeneration;
+    bool synthStale;            // no copy yet, or the format changed since
+    uint64_t synthHash;
+    
+    // Handle id in the call trace (0 when not tracing)
+    uint32_t traceId;
+    
+    // Live buffer list (see g_buffers)
+    OPEN_segaapiBuffer_t* prev;
+    OPEN_segaapiBuffer_t* next;
     
-    // (Synthesizer and deferred callback members from the original are omitted or stubbed.)  
+    // (Deferred callback members from the original are omitted or stubbed.)  
 };
 
-// ======================================================================
-// Utility: Calculate frame (sample) size (assuming 16-bit PCM)
-// ======================================================================
-static unsigned int bufferSampleSize(OPEN_segaapiBuffer_t* buffer) {
-    // Assumes 16-bit PCM (2 bytes per sample per channel)
-    return buffer->channels * 2;
+// Every live buffer, so SEGAAPI_Reset only visits what exists
+static std::mutex g_buffersLock;
+static OPEN_segaapiBuffer_t* g_buffers = nullptr;
+
+static void linkBuffer(OPEN_segaapiBuffer_t* buffer) {
+    std::lock_guard<std::mutex> lock(g_buffersLock);
+    buffer->prev = nullptr;
+    buffer->next = g_buffers;
+    if (g_buffers) g_buffers->prev = buffer;
+    g_buffers = buffer;
+}
+
+static void unlinkBuffer(OPEN_segaapiBuffer_t* buffer) {
+    std::lock_guard<std::mutex> lock(g_buffersLock);
+    if (buffer->prev) buffer->prev->next = buffer->next;
+    else g_buffers = buffer->next;
+    if (buffer->next) buffer->next->prev = buffer->prev;
+}
+
+// Drops a reference to a buffer and frees it with the last one
+static void releaseBuffer(OPEN_segaapiBuffer_t* buffer) {
+    if (buffer->references.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    OPEN_segaapiBuffer_t* owner = buffer->owner;
+    // Free audio data if it was allocated by this API
+    if (!owner) Samples_Free(buffer->memory);
+    delete buffer;
+    if (owner) releaseBuffer(owner);
+}
+
+// Trace id of a handle argument
+static int64_t traceHandle(void* hHandle) {
+    return hHandle ? static_cast<OPEN_segaapiBuffer_t*>(hHandle)->traceId : 0;
 }
 
 // ======================================================================
 // SEGAAPI_Init / SEGAAPI_Exit
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_Init(void) {
+// (The device is opened in the background, see device.h. Init only makes
+// sure that has started; it fails only if an open already failed.
+// Games often quit without SEGAAPI_Exit, so Init also registers the
+// shutdown with atexit. It then runs before the static destructors of
+// this library, which were registered when it was loaded, and they find
+// every thread joined. Windows terminates the other threads before it
+// unloads the library, so the shutdown is left to SEGAAPI_Exit there;
+// the thread objects are never destroyed, so the dead ones need no join.)
+static unsigned int g_initUs = 0;
+#ifndef _WIN32
+static std::once_flag g_shutdownRegistered;
+#endif
+
+static void shutdown() {
+    Device_Close();
+    Trace_Stop();
+    Stats_Stop();
+}
+
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_Init(void) {
+    auto start = std::chrono::steady_clock::now();
+    Stats_Start();
+    Trace_Start();
+    TRACE_CALL(Init);
     info("SEGAAPI_Init (OpenAL)");
-    g_alDevice = alcOpenDevice(nullptr);
-    if (!g_alDevice) return SetStatus(OPEN_SEGAERR_UNKNOWN);
-    g_alContext = alcCreateContext(g_alDevice, nullptr);
-    if (!g_alContext) {
-        alcCloseDevice(g_alDevice);
-        return SetStatus(OPEN_SEGAERR_UNKNOWN);
-    }
-    alcMakeContextCurrent(g_alContext);
-    return SetStatus(OPEN_SEGA_SUCCESS);
+    Device_Open();
+#ifndef _WIN32
+    std::call_once(g_shutdownRegistered, [] { std::atexit(shutdown); });
+#endif
+    bool failed = Device_Failed();
+    g_initUs = static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    return SetStatus(failed ? OPEN_SEGAERR_UNKNOWN : OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_Exit(void) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_Exit(void) {
+    TRACE_CALL(Exit);
     info("SEGAAPI_Exit (OpenAL)");
-    alcMakeContextCurrent(nullptr);
-    if (g_alContext) { alcDestroyContext(g_alContext); g_alContext = nullptr; }
-    if (g_alDevice) { alcCloseDevice(g_alDevice); g_alDevice = nullptr; }
+    shutdown();
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
 // ======================================================================
 // SEGAAPI_CreateBuffer
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_CreateBuffer(
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_CreateBuffer(
     OPEN_HAWOSEBUFFERCONFIG* pConfig, 
     OPEN_HAWOSEGABUFFERCALLBACK pCallback, 
     unsigned int dwFlags, 
     void** phHandle) 
 {
+    TRACE_SCOPE(CreateBuffer);
     if (!pConfig || !phHandle) {
         info("SEGAAPI_CreateBuffer: Bad pointer");
         return SetStatus(OPEN_SEGAERR_BAD_POINTER);
@@ -131,46 +186,45 @@ extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_CreateBuffer(
     try {
         auto* buffer = new OPEN_segaapiBuffer_t();
         info("SEGAAPI_CreateBuffer: Creating buffer at %p", (void*)buffer);
+        buffer->references = 1;
         
         // Initialize basic properties from configuration
-        buffer->sampleRate = pConfig->dwSampleRate;
-        buffer->channels   = pConfig->byNumChans;
-        buffer->size       = pConfig->mapData.dwSize;
-        if (dwFlags & OPEN_HABUF_ALLOC_USER_MEM || dwFlags & OPEN_HABUF_USE_MAPPED_MEM) {
+        buffer->sampleRate   = pConfig->dwSampleRate;
+        buffer->sampleFormat = pConfig->dwSampleFormat;
+        buffer->channels     = pConfig->byNumChans;
+        buffer->size         = pConfig->mapData.dwSize;
+        buffer->userMem = (dwFlags & (OPEN_HABUF_ALLOC_USER_MEM | OPEN_HABUF_USE_MAPPED_MEM)) != 0;
+        if (buffer->userMem) {
             buffer->data = static_cast<uint8_t*>(pConfig->mapData.hBufferHdr);
         } else {
-            buffer->data = static_cast<uint8_t*>(malloc(buffer->size));
-            if (!buffer->data) { delete buffer; return SetStatus(OPEN_SEGAERR_OUT_OF_MEMORY); }
+            buffer->memory = Samples_Alloc(buffer->size);
+            if (!buffer->memory) { delete buffer; return SetStatus(OPEN_SEGAERR_OUT_OF_MEMORY); }
+            buffer->data = Samples_Data(buffer->memory);
         }
         pConfig->mapData.hBufferHdr = buffer->data;
         
-        buffer->playing = false;
         buffer->loop = false;
-        buffer->currentPosition = 0;
         buffer->startLoop = 0;
         buffer->endLoop = buffer->size;
         buffer->endOffset = buffer->size;
         buffer->priority = pConfig->dwPriority;
         buffer->userData = pConfig->hUserData;
+        buffer->synth = (dwFlags & OPEN_HABUF_SYNTH_BUFFER) != 0;
+        buffer->synthStale = true;
         
-        // Initialize routing defaults
-        for (int i = 0; i < MAX_ROUTES; i++) {
-            buffer->sendVolumes[i] = 0.0f;
-            buffer->sendChannels[i] = 0;
-            buffer->sendRoutes[i] = OPEN_HA_UNUSED_PORT;
-        }
-        for (int i = 0; i < 6; i++) {
-            buffer->channelVolumes[i] = 1.0f;
-        }
+        // Gain, pitch, routing and volume defaults
+        Mixer_DefaultMix(buffer);
         
-        // Generate OpenAL objects
-        alGenBuffers(1, &buffer->alBuffer);
-        alGenSources(1, &buffer->alSource);
+        buffer->voice = Mixer_CreateVoice(*buffer);
+        linkBuffer(buffer);
         
-        // Choose format – assuming 16-bit PCM (adjust if necessary)
-        ALenum format = (buffer->channels == 1) ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
-        alBufferData(buffer->alBuffer, format, buffer->data, buffer->size, buffer->sampleRate);
-        alSourcei(buffer->alSource, AL_BUFFER, buffer->alBuffer);
+        if (g_traceEnabled.load(std::memory_order_relaxed)) {
+            // User memory may already hold samples, so record it with the call
+            buffer->traceId = Trace_NewHandle();
+            TRACE_RECORD(CreateBuffer, buffer->userMem ? buffer->data : nullptr, buffer->size,
+                buffer->traceId, pConfig->dwPriority, pConfig->dwSampleRate, pConfig->dwSampleFormat,
+                pConfig->byNumChans, buffer->size, dwFlags);
+        }
         
         *phHandle = buffer;
         return SetStatus(OPEN_SEGA_SUCCESS);
@@ -182,7 +236,8 @@ extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_CreateBuffer(
 // ======================================================================
 // SEGAAPI_DestroyBuffer
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_DestroyBuffer(void* hHandle) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_DestroyBuffer(void* hHandle) {
+    TRACE_CALL(DestroyBuffer, traceHandle(hHandle));
     if (!hHandle) {
         info("SEGAAPI_DestroyBuffer: Bad handle");
         return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
@@ -190,14 +245,61 @@ extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_DestroyBuffer(void* hHa
     info("SEGAAPI_DestroyBuffer: Handle %p", hHandle);
     try {
         auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
-        alSourceStop(buffer->alSource);
-        alDeleteSources(1, &buffer->alSource);
-        alDeleteBuffers(1, &buffer->alBuffer);
-        // Free audio data if it was allocated by this API
-        if (!(buffer->priority & (OPEN_HABUF_ALLOC_USER_MEM | OPEN_HABUF_USE_MAPPED_MEM))) {
-            free(buffer->data);
+        unlinkBuffer(buffer);
+        Mixer_DestroyVoice(buffer->voice);
+        buffer->voice = nullptr;
+        releaseBuffer(buffer);
+        return SetStatus(OPEN_SEGA_SUCCESS);
+    } catch (...) {
+        return SetStatus(OPEN_SEGAERR_UNKNOWN);
+    }
+}
+
+// ======================================================================
+// SEGAAPI_CreateInstance
+// (A handle with its own voice over another buffer's sample data. It
+// starts with the settings that buffer has now and changes them on its
+// own from then on; the data, its size and the user data are not copied.)
+// ======================================================================
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_CreateInstance(void* hSource, void** phHandle) {
+    TRACE_SCOPE(CreateInstance);
+    if (!hSource) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
+    if (!phHandle) return SetStatus(OPEN_SEGAERR_BAD_POINTER);
+    try {
+        auto* source = static_cast<OPEN_segaapiBuffer_t*>(hSource);
+        OPEN_segaapiBuffer_t* owner = source->owner ? source->owner : source;
+        // Several voices read the data from now on, so it has to be PCM in place
+        if (owner->memory) Samples_Expand(owner->memory);
+
+        auto* buffer = new OPEN_segaapiBuffer_t();
+        static_cast<MixerVoiceParams&>(*buffer) = *source;
+        buffer->userMem = owner->userMem;
+        buffer->memory = owner->memory;
+        buffer->owner = owner;
+        buffer->references = 1;
+        owner->references.fetch_add(1, std::memory_order_relaxed);
+        buffer->priority = source->priority;
+        memcpy(buffer->synthParams, source->synthParams, sizeof(buffer->synthParams));
+        buffer->synthParamsSet = source->synthParamsSet;
+        buffer->synthStale = true;
+
+        buffer->voice = Mixer_CreateVoice(*buffer);
+        linkBuffer(buffer);
+        // The synth engine keeps the parameters per voice
+        if (buffer->synth) {
+            for (unsigned int param = 0; param < NUM_SYNTH_PARAMS; param++) {
+                if (!(buffer->synthParamsSet & (1u << param))) continue;
+                MixerCommand command = { buffer->voice, MIXER_CMD_SET_SYNTH_PARAM, param, static_cast<uint32_t>(buffer->synthParams[param]) };
+                Mixer_Push(command);
+            }
+        }
+
+        if (g_traceEnabled.load(std::memory_order_relaxed)) {
+            buffer->traceId = Trace_NewHandle();
+            TRACE_RECORD(CreateInstance, nullptr, 0, buffer->traceId, traceHandle(hSource));
         }
-        delete buffer;
+
+        *phHandle = buffer;
         return SetStatus(OPEN_SEGA_SUCCESS);
     } catch (...) {
         return SetStatus(OPEN_SEGAERR_UNKNOWN);
@@ -207,7 +309,8 @@ extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_DestroyBuffer(void* hHa
 // ======================================================================
 // SEGAAPI_SetUserData / SEGAAPI_GetUserData
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetUserData(void* hHandle, void* hUserData) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetUserData(void* hHandle, void* hUserData) {
+    TRACE_CALL(SetUserData, traceHandle(hHandle));
     if (!hHandle) {
         info("SEGAAPI_SetUserData: Bad handle");
         return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
@@ -217,7 +320,8 @@ extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetUserData(void* hHand
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) void* SEGAAPI_GetUserData(void* hHandle) {
+extern "C" OPENSEGAAPI_API void* SEGAAPI_GetUserData(void* hHandle) {
+    TRACE_CALL(GetUserData, traceHandle(hHandle));
     if (!hHandle) {
         info("SEGAAPI_GetUserData: Bad handle");
         SetStatus(OPEN_SEGAERR_BAD_HANDLE);
@@ -230,39 +334,46 @@ extern "C" __declspec(dllexport) void* SEGAAPI_GetUserData(void* hHandle) {
 // ======================================================================
 // SEGAAPI_SetFormat / SEGAAPI_GetFormat
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetFormat(void* hHandle, OPEN_HAWOSEFORMAT* pFormat) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetFormat(void* hHandle, OPEN_HAWOSEFORMAT* pFormat) {
+    TRACE_CALL(SetFormat, traceHandle(hHandle), pFormat ? pFormat->dwSampleRate : 0, pFormat ? pFormat->dwSampleFormat : 0, pFormat ? pFormat->byNumChans : 0);
     if (!hHandle || !pFormat) return SetStatus(OPEN_SEGAERR_BAD_POINTER);
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
-    buffer->sampleRate = pFormat->dwSampleRate;
-    buffer->channels   = pFormat->byNumChans;
-    ALenum formatEnum = (buffer->channels == 1) ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
-    alBufferData(buffer->alBuffer, formatEnum, buffer->data, buffer->size, buffer->sampleRate);
+    // ADPCM storage is made for the old format; go back to PCM first
+    if (buffer->memory) Samples_Expand(buffer->memory);
+    buffer->sampleRate   = pFormat->dwSampleRate;
+    buffer->sampleFormat = pFormat->dwSampleFormat;
+    buffer->channels     = pFormat->byNumChans;
+    buffer->synthStale = true;
+    Mixer_Command(buffer->voice, MIXER_CMD_SET_SAMPLE_RATE, buffer->sampleRate);
+    Mixer_Command(buffer->voice, MIXER_CMD_SET_FORMAT, buffer->sampleFormat, buffer->channels);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_GetFormat(void* hHandle, OPEN_HAWOSEFORMAT* pFormat) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetFormat(void* hHandle, OPEN_HAWOSEFORMAT* pFormat) {
+    TRACE_CALL(GetFormat, traceHandle(hHandle));
     if (!hHandle || !pFormat) return SetStatus(OPEN_SEGAERR_BAD_POINTER);
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     pFormat->dwSampleRate = buffer->sampleRate;
     pFormat->byNumChans = buffer->channels;
-    pFormat->dwSampleFormat = OPEN_HASF_SIGNED_16PCM; // assumed format
+    pFormat->dwSampleFormat = buffer->sampleFormat;
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
 // ======================================================================
 // SEGAAPI_SetSampleRate / SEGAAPI_GetSampleRate
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSampleRate(void* hHandle, unsigned int dwSampleRate) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSampleRate(void* hHandle, unsigned int dwSampleRate) {
+    TRACE_CALL(SetSampleRate, traceHandle(hHandle), dwSampleRate);
     if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
     if (dwSampleRate < 8000 || dwSampleRate > 192000) return SetStatus(OPEN_SEGAERR_BAD_PARAM);
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     buffer->sampleRate = dwSampleRate;
-    ALenum formatEnum = (buffer->channels == 1) ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
-    alBufferData(buffer->alBuffer, formatEnum, buffer->data, buffer->size, buffer->sampleRate);
+    Mixer_Command(buffer->voice, MIXER_CMD_SET_SAMPLE_RATE, dwSampleRate);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) unsigned int SEGAAPI_GetSampleRate(void* hHandle) {
+extern "C" OPENSEGAAPI_API unsigned int SEGAAPI_GetSampleRate(void* hHandle) {
+    TRACE_CALL(GetSampleRate, traceHandle(hHandle));
     if (!hHandle) { SetStatus(OPEN_SEGAERR_BAD_HANDLE); return 0; }
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     return buffer->sampleRate;
@@ -271,14 +382,16 @@ extern "C" __declspec(dllexport) unsigned int SEGAAPI_GetSampleRate(void* hHandl
 // ======================================================================
 // SEGAAPI_SetPriority / SEGAAPI_GetPriority
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetPriority(void* hHandle, unsigned int dwPriority) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetPriority(void* hHandle, unsigned int dwPriority) {
+    TRACE_CALL(SetPriority, traceHandle(hHandle), dwPriority);
     if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     buffer->priority = dwPriority;
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) unsigned int SEGAAPI_GetPriority(void* hHandle) {
+extern "C" OPENSEGAAPI_API unsigned int SEGAAPI_GetPriority(void* hHandle) {
+    TRACE_CALL(GetPriority, traceHandle(hHandle));
     if (!hHandle) { SetStatus(OPEN_SEGAERR_BAD_HANDLE); return 0; }
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     return buffer->priority;
@@ -286,18 +399,22 @@ extern "C" __declspec(dllexport) unsigned int SEGAAPI_GetPriority(void* hHandle)
 
 // ======================================================================
 // SEGAAPI_SetSendRouting / SEGAAPI_GetSendRouting
-// (Routing data is stored only; OpenAL does not support submix routing.) 
+// (Routes are folded down to stereo by the mixer; FX slots are ignored.)
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSendRouting(void* hHandle, unsigned int dwChannel, unsigned int dwSend, OPEN_HAROUTING dwDest) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSendRouting(void* hHandle, unsigned int dwChannel, unsigned int dwSend, OPEN_HAROUTING dwDest) {
+    TRACE_CALL(SetSendRouting, traceHandle(hHandle), dwChannel, dwSend, dwDest);
     if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     if (dwSend >= MAX_ROUTES || dwChannel >= buffer->channels) return SetStatus(OPEN_SEGAERR_INVALID_PARAM);
     buffer->sendRoutes[dwSend] = dwDest;
     buffer->sendChannels[dwSend] = dwChannel;
+    MixerCommand command = { buffer->voice, MIXER_CMD_SET_SEND_ROUTE, dwSend, static_cast<uint32_t>(dwDest), dwChannel, 0.0f };
+    Mixer_Push(command);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) OPEN_HAROUTING SEGAAPI_GetSendRouting(void* hHandle, unsigned int dwChannel, unsigned int dwSend) {
+extern "C" OPENSEGAAPI_API OPEN_HAROUTING SEGAAPI_GetSendRouting(void* hHandle, unsigned int dwChannel, unsigned int dwSend) {
+    TRACE_CALL(GetSendRouting, traceHandle(hHandle), dwChannel, dwSend);
     if (!hHandle) { SetStatus(OPEN_SEGAERR_BAD_HANDLE); return OPEN_HA_UNUSED_PORT; }
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     if (dwSend >= MAX_ROUTES || dwChannel >= buffer->channels) { SetStatus(OPEN_SEGAERR_INVALID_PARAM); return OPEN_HA_UNUSED_PORT; }
@@ -307,17 +424,20 @@ extern "C" __declspec(dllexport) OPEN_HAROUTING SEGAAPI_GetSendRouting(void* hHa
 // ======================================================================
 // SEGAAPI_SetSendLevel / SEGAAPI_GetSendLevel
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSendLevel(void* hHandle, unsigned int dwChannel, unsigned int dwSend, unsigned int dwLevel) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSendLevel(void* hHandle, unsigned int dwChannel, unsigned int dwSend, unsigned int dwLevel) {
+    TRACE_CALL(SetSendLevel, traceHandle(hHandle), dwChannel, dwSend, dwLevel);
     if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     if (dwSend >= MAX_ROUTES || dwChannel >= buffer->channels) return SetStatus(OPEN_SEGAERR_INVALID_PARAM);
     constexpr float MAX_LEVEL = static_cast<float>(0xFFFFFFFF);
     buffer->sendVolumes[dwSend] = dwLevel / MAX_LEVEL;
     buffer->sendChannels[dwSend] = dwChannel;
+    Mixer_Command(buffer->voice, MIXER_CMD_SET_SEND_LEVEL, dwSend, dwChannel, buffer->sendVolumes[dwSend]);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) unsigned int SEGAAPI_GetSendLevel(void* hHandle, unsigned int dwChannel, unsigned int dwSend) {
+extern "C" OPENSEGAAPI_API unsigned int SEGAAPI_GetSendLevel(void* hHandle, unsigned int dwChannel, unsigned int dwSend) {
+    TRACE_CALL(GetSendLevel, traceHandle(hHandle), dwChannel, dwSend);
     if (!hHandle) { SetStatus(OPEN_SEGAERR_BAD_HANDLE); return 0; }
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     if (dwSend >= MAX_ROUTES || dwChannel >= buffer->channels) { SetStatus(OPEN_SEGAERR_INVALID_PARAM); return 0; }
@@ -327,21 +447,23 @@ extern "C" __declspec(dllexport) unsigned int SEGAAPI_GetSendLevel(void* hHandle
 
 // ======================================================================
 // SEGAAPI_SetChannelVolume / SEGAAPI_GetChannelVolume
-// (Stored only; per-channel mixing not directly implemented in OpenAL.)
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetChannelVolume(void* hHandle, unsigned int dwChannel, unsigned int dwVolume) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetChannelVolume(void* hHandle, unsigned int dwChannel, unsigned int dwVolume) {
+    TRACE_CALL(SetChannelVolume, traceHandle(hHandle), dwChannel, dwVolume);
     if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
-    if (dwChannel >= buffer->channels) return SetStatus(OPEN_SEGAERR_INVALID_PARAM);
+    if (dwChannel >= buffer->channels || dwChannel >= MAX_VOICE_CHANNELS) return SetStatus(OPEN_SEGAERR_INVALID_PARAM);
     constexpr float MAX_VOLUME = static_cast<float>(0xFFFFFFFF);
     buffer->channelVolumes[dwChannel] = dwVolume / MAX_VOLUME;
+    Mixer_Command(buffer->voice, MIXER_CMD_SET_CHANNEL_VOLUME, dwChannel, 0, buffer->channelVolumes[dwChannel]);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) unsigned int SEGAAPI_GetChannelVolume(void* hHandle, unsigned int dwChannel) {
+extern "C" OPENSEGAAPI_API unsigned int SEGAAPI_GetChannelVolume(void* hHandle, unsigned int dwChannel) {
+    TRACE_CALL(GetChannelVolume, traceHandle(hHandle), dwChannel);
     if (!hHandle) { SetStatus(OPEN_SEGAERR_BAD_HANDLE); return 0; }
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
-    if (dwChannel >= buffer->channels) { SetStatus(OPEN_SEGAERR_INVALID_PARAM); return 0; }
+    if (dwChannel >= buffer->channels || dwChannel >= MAX_VOICE_CHANNELS) { SetStatus(OPEN_SEGAERR_INVALID_PARAM); return 0; }
     constexpr float MAX_VOLUME = static_cast<float>(0xFFFFFFFF);
     return static_cast<unsigned int>(buffer->channelVolumes[dwChannel] * MAX_VOLUME);
 }
@@ -349,83 +471,117 @@ extern "C" __declspec(dllexport) unsigned int SEGAAPI_GetChannelVolume(void* hHa
 // ======================================================================
 // SEGAAPI_SetPlaybackPosition / SEGAAPI_GetPlaybackPosition
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetPlaybackPosition(void* hHandle, unsigned int dwPlaybackPos) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetPlaybackPosition(void* hHandle, unsigned int dwPlaybackPos) {
+    TRACE_CALL(SetPlaybackPosition, traceHandle(hHandle), dwPlaybackPos);
     if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     if (dwPlaybackPos > buffer->size) return SetStatus(OPEN_SEGAERR_BAD_PARAM);
-    unsigned int sampleSize = bufferSampleSize(buffer);
-    unsigned int sampleOffset = dwPlaybackPos / sampleSize;
-    alSourceStop(buffer->alSource);
-    alSourcei(buffer->alSource, AL_SAMPLE_OFFSET, sampleOffset);
-    buffer->currentPosition = dwPlaybackPos;
-    if (buffer->playing) alSourcePlay(buffer->alSource);
+    unsigned int frameBytes = Mixer_FrameBytes(buffer->sampleFormat, buffer->channels);
+    if (!frameBytes) return SetStatus(OPEN_SEGAERR_BAD_PARAM);
+    // Published right away so that a read straight after sees it
+    buffer->voice->playbackPosition.store(dwPlaybackPos / frameBytes * frameBytes, std::memory_order_relaxed);
+    Mixer_Command(buffer->voice, MIXER_CMD_SET_POSITION, dwPlaybackPos);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) unsigned int SEGAAPI_GetPlaybackPosition(void* hHandle) {
+// (The mixer publishes every voice's position after each period, so
+// reading it is a single load with no driver round-trip.)
+extern "C" OPENSEGAAPI_API unsigned int SEGAAPI_GetPlaybackPosition(void* hHandle) {
+    TRACE_CALL(GetPlaybackPosition, traceHandle(hHandle));
     if (!hHandle) { SetStatus(OPEN_SEGAERR_BAD_HANDLE); return 0; }
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
-    ALint sampleOffset = 0;
-    alGetSourcei(buffer->alSource, AL_SAMPLE_OFFSET, &sampleOffset);
-    unsigned int byteOffset = sampleOffset * bufferSampleSize(buffer);
-    return byteOffset;
+    return buffer->voice->playbackPosition.load(std::memory_order_relaxed);
+}
+
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetPlaybackPositions(unsigned int dwNumHandles, void** phHandles, unsigned int* pdwPositions) {
+    TRACE_SCOPE(GetPlaybackPositions);
+    if (traceScope_.outermost() && phHandles) {
+        // The handles travel as their trace ids
+        std::vector<uint32_t> ids(dwNumHandles);
+        for (unsigned int i = 0; i < dwNumHandles; i++) ids[i] = static_cast<uint32_t>(traceHandle(phHandles[i]));
+        Trace_Call(EXPORT_GetPlaybackPositions, ids.data(), ids.size() * sizeof(uint32_t), { dwNumHandles });
+    }
+    if (dwNumHandles && (!phHandles || !pdwPositions)) return SetStatus(OPEN_SEGAERR_BAD_POINTER);
+    OPEN_SEGASTATUS status = OPEN_SEGA_SUCCESS;
+    for (unsigned int i = 0; i < dwNumHandles; i++) {
+        auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(phHandles[i]);
+        if (!buffer) {
+            pdwPositions[i] = 0;
+            status = OPEN_SEGAERR_BAD_HANDLE;
+            continue;
+        }
+        pdwPositions[i] = buffer->voice->playbackPosition.load(std::memory_order_relaxed);
+    }
+    return SetStatus(status);
 }
 
 // ======================================================================
 // Notification functions (stubs since OpenAL does not provide callbacks)
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetNotificationFrequency(void* hHandle, unsigned int dwFrameCount) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetNotificationFrequency(void* hHandle, unsigned int dwFrameCount) {
+    TRACE_CALL(SetNotificationFrequency, traceHandle(hHandle), dwFrameCount);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetNotificationPoint(void* hHandle, unsigned int dwBufferOffset) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetNotificationPoint(void* hHandle, unsigned int dwBufferOffset) {
+    TRACE_CALL(SetNotificationPoint, traceHandle(hHandle), dwBufferOffset);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_ClearNotificationPoint(void* hHandle, unsigned int dwBufferOffset) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_ClearNotificationPoint(void* hHandle, unsigned int dwBufferOffset) {
+    TRACE_CALL(ClearNotificationPoint, traceHandle(hHandle), dwBufferOffset);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
 // ======================================================================
 // Loop offsets
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetStartLoopOffset(void* hHandle, unsigned int dwOffset) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetStartLoopOffset(void* hHandle, unsigned int dwOffset) {
+    TRACE_CALL(SetStartLoopOffset, traceHandle(hHandle), dwOffset);
     if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     if (dwOffset > buffer->size) return SetStatus(OPEN_SEGAERR_BAD_PARAM);
     buffer->startLoop = dwOffset;
+    Mixer_Command(buffer->voice, MIXER_CMD_SET_START_LOOP, dwOffset);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) unsigned int SEGAAPI_GetStartLoopOffset(void* hHandle) {
+extern "C" OPENSEGAAPI_API unsigned int SEGAAPI_GetStartLoopOffset(void* hHandle) {
+    TRACE_CALL(GetStartLoopOffset, traceHandle(hHandle));
     if (!hHandle) { SetStatus(OPEN_SEGAERR_BAD_HANDLE); return 0; }
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     return buffer->startLoop;
 }
 
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetEndLoopOffset(void* hHandle, unsigned int dwOffset) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetEndLoopOffset(void* hHandle, unsigned int dwOffset) {
+    TRACE_CALL(SetEndLoopOffset, traceHandle(hHandle), dwOffset);
     if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     if (dwOffset > buffer->size) return SetStatus(OPEN_SEGAERR_BAD_PARAM);
     buffer->endLoop = dwOffset;
+    Mixer_Command(buffer->voice, MIXER_CMD_SET_END_LOOP, dwOffset);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) unsigned int SEGAAPI_GetEndLoopOffset(void* hHandle) {
+extern "C" OPENSEGAAPI_API unsigned int SEGAAPI_GetEndLoopOffset(void* hHandle) {
+    TRACE_CALL(GetEndLoopOffset, traceHandle(hHandle));
     if (!hHandle) { SetStatus(OPEN_SEGAERR_BAD_HANDLE); return 0; }
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     return buffer->endLoop;
 }
 
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetEndOffset(void* hHandle, unsigned int dwOffset) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetEndOffset(void* hHandle, unsigned int dwOffset) {
+    TRACE_CALL(SetEndOffset, traceHandle(hHandle), dwOffset);
     if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     if (dwOffset > buffer->size) return SetStatus(OPEN_SEGAERR_BAD_PARAM);
     buffer->endOffset = dwOffset;
+    Mixer_Command(buffer->voice, MIXER_CMD_SET_END_OFFSET, dwOffset);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) unsigned int SEGAAPI_GetEndOffset(void* hHandle) {
+extern "C" OPENSEGAAPI_API unsigned int SEGAAPI_GetEndOffset(void* hHandle) {
+    TRACE_CALL(GetEndOffset, traceHandle(hHandle));
     if (!hHandle) { SetStatus(OPEN_SEGAERR_BAD_HANDLE); return 0; }
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     return buffer->endOffset;
@@ -434,15 +590,17 @@ extern "C" __declspec(dllexport) unsigned int SEGAAPI_GetEndOffset(void* hHandle
 // ======================================================================
 // Loop state
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetLoopState(void* hHandle, int bDoContinuousLooping) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetLoopState(void* hHandle, int bDoContinuousLooping) {
+    TRACE_CALL(SetLoopState, traceHandle(hHandle), bDoContinuousLooping);
     if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     buffer->loop = (bDoContinuousLooping != 0);
-    alSourcei(buffer->alSource, AL_LOOPING, buffer->loop ? AL_TRUE : AL_FALSE);
+    Mixer_Command(buffer->voice, MIXER_CMD_SET_LOOP, buffer->loop ? 1 : 0);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) int SEGAAPI_GetLoopState(void* hHandle) {
+extern "C" OPENSEGAAPI_API int SEGAAPI_GetLoopState(void* hHandle) {
+    TRACE_CALL(GetLoopState, traceHandle(hHandle));
     if (!hHandle) { SetStatus(OPEN_SEGAERR_BAD_HANDLE); return 0; }
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
     return buffer->loop ? 1 : 0;
@@ -450,55 +608,67 @@ extern "C" __declspec(dllexport) int SEGAAPI_GetLoopState(void* hHandle) {
 
 // ======================================================================
 // SEGAAPI_UpdateBuffer
-// (For streaming updates, re-buffer the entire data)
+// (The mixer reads sample memory directly, so there is nothing to upload.)
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_UpdateBuffer(void* hHandle, unsigned int dwStartOffset, unsigned int dwLength) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_UpdateBuffer(void* hHandle, unsigned int dwStartOffset, unsigned int dwLength) {
+    TRACE_SCOPE(UpdateBuffer);
     if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
-    if (dwStartOffset + dwLength > buffer->size) return SetStatus(OPEN_SEGAERR_BAD_PARAM);
-    ALenum formatEnum = (buffer->channels == 1) ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
-    alBufferData(buffer->alBuffer, formatEnum, buffer->data, buffer->size, buffer->sampleRate);
+    if (dwStartOffset > buffer->size || dwLength > buffer->size - dwStartOffset) return SetStatus(OPEN_SEGAERR_BAD_PARAM);
+    TRACE_RECORD(UpdateBuffer, buffer->data + dwStartOffset, dwLength, buffer->traceId, dwStartOffset, dwLength);
+    if (buffer->memory) Samples_Changed(buffer->memory, dwStartOffset, dwLength);
+    (buffer->owner ? buffer->owner : buffer)->dataGeneration.fetch_add(1, std::memory_order_relaxed);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
 // ======================================================================
-// Synth Parameters (only attenuation and pitch are implemented)
+// Synth Parameters (only attenuation and pitch affect the mix;
+// the others are stored and read back)
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSynthParam(void* hHandle, OPEN_HASYNTHPARAMSEXT param, int lPARWValue) {
-    if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
-    auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
+// Stores a parameter and passes the ones the mixer uses on, at once or at a sample time
+static void applySynthParam(OPEN_segaapiBuffer_t* buffer, OPEN_HASYNTHPARAMSEXT param, int lPARWValue, uint64_t sampleTime) {
+    buffer->synthParams[param] = lPARWValue;
+    buffer->synthParamsSet |= 1u << param;
     if (param == OPEN_HAVP_ATTENUATION) {
         // Convert dB*10 to gain (example conversion)
         float volume = powf(10.0f, -lPARWValue / 200.0f);
-        alSourcef(buffer->alSource, AL_GAIN, volume);
+        buffer->gain = volume;
+        MixerCommand command = { buffer->voice, MIXER_CMD_SET_GAIN, 0, 0, 0, volume, sampleTime };
+        Mixer_Push(command);
         info("SEGAAPI_SetSynthParam: Attenuation set, gain = %f", volume);
     } else if (param == OPEN_HAVP_PITCH) {
         float semitones = lPARWValue / 100.0f;
         float pitchFactor = powf(2.0f, semitones / 12.0f);
-        alSourcef(buffer->alSource, AL_PITCH, pitchFactor);
+        buffer->pitch = pitchFactor;
+        MixerCommand command = { buffer->voice, MIXER_CMD_SET_PITCH, 0, 0, 0, pitchFactor, sampleTime };
+        Mixer_Push(command);
         info("SEGAAPI_SetSynthParam: Pitch set, factor = %f", pitchFactor);
-    } 
-    // Additional parameters can be handled as needed.
+    } else if (buffer->synth) {
+        // The others shape the synth engine's next note
+        MixerCommand command = { buffer->voice, MIXER_CMD_SET_SYNTH_PARAM, static_cast<uint32_t>(param), static_cast<uint32_t>(lPARWValue), 0, 0.0f, sampleTime };
+        Mixer_Push(command);
+    }
+}
+
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSynthParam(void* hHandle, OPEN_HASYNTHPARAMSEXT param, int lPARWValue) {
+    TRACE_CALL(SetSynthParam, traceHandle(hHandle), param, lPARWValue);
+    if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
+    auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
+    if (static_cast<int>(param) < 0 || param >= NUM_SYNTH_PARAMS) return SetStatus(OPEN_SEGAERR_BAD_PARAM);
+    applySynthParam(buffer, param, lPARWValue, 0);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) int SEGAAPI_GetSynthParam(void* hHandle, OPEN_HASYNTHPARAMSEXT param) {
+extern "C" OPENSEGAAPI_API int SEGAAPI_GetSynthParam(void* hHandle, OPEN_HASYNTHPARAMSEXT param) {
+    TRACE_CALL(GetSynthParam, traceHandle(hHandle), param);
     if (!hHandle) { SetStatus(OPEN_SEGAERR_BAD_HANDLE); return 0; }
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
-    float value = 0.0f;
-    if (param == OPEN_HAVP_ATTENUATION) {
-        alGetSourcef(buffer->alSource, AL_GAIN, &value);
-        float dB = -20.0f * log10f(value);
-        return static_cast<int>(dB * 10);
-    } else if (param == OPEN_HAVP_PITCH) {
-        alGetSourcef(buffer->alSource, AL_PITCH, &value);
-        float semitones = 12.0f * logf(value) / logf(2.0f);
-        return static_cast<int>(semitones * 100);
-    }
-    return 0;
+    if (static_cast<int>(param) < 0 || param >= NUM_SYNTH_PARAMS) { SetStatus(OPEN_SEGAERR_BAD_PARAM); return 0; }
+    return buffer->synthParams[param];
 }
 
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSynthParamMultiple(void* hHandle, unsigned int dwNumParams, OPEN_SynthParamSet* pSynthParams) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSynthParamMultiple(void* hHandle, unsigned int dwNumParams, OPEN_SynthParamSet* pSynthParams) {
+    TRACE_CALL_BLOB(SetSynthParamMultiple, pSynthParams, dwNumParams * sizeof(OPEN_SynthParamSet), traceHandle(hHandle), dwNumParams);
     if (!hHandle || !pSynthParams || dwNumParams == 0) return SetStatus(OPEN_SEGAERR_INVALID_PARAM);
     for (unsigned int i = 0; i < dwNumParams; i++) {
         OPEN_SEGASTATUS status = SEGAAPI_SetSynthParam(hHandle, pSynthParams[i].param, pSynthParams[i].lPARWValue);
@@ -507,7 +677,8 @@ extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSynthParamMultiple(v
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_GetSynthParamMultiple(void* hHandle, unsigned int dwNumParams, OPEN_SynthParamSet* pSynthParams) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetSynthParamMultiple(void* hHandle, unsigned int dwNumParams, OPEN_SynthParamSet* pSynthParams) {
+    TRACE_CALL_BLOB(GetSynthParamMultiple, pSynthParams, dwNumParams * sizeof(OPEN_SynthParamSet), traceHandle(hHandle), dwNumParams);
     if (!hHandle || !pSynthParams || dwNumParams == 0) return SetStatus(OPEN_SEGAERR_INVALID_PARAM);
     for (unsigned int i = 0; i < dwNumParams; i++) {
         pSynthParams[i].lPARWValue = SEGAAPI_GetSynthParam(hHandle, pSynthParams[i].param);
@@ -518,27 +689,121 @@ extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_GetSynthParamMultiple(v
 // ======================================================================
 // SEGAAPI_SetReleaseState
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetReleaseState(void* hHandle, int bSet) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetReleaseState(void* hHandle, int bSet) {
+    TRACE_CALL(SetReleaseState, traceHandle(hHandle), bSet);
     if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
     auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
-    if (bSet) {
-        buffer->playing = false;
-        alSourceStop(buffer->alSource);
+    // Synth notes play out their release; other voices just stop
+    if (bSet && buffer->synth) Mixer_ReleaseVoice(buffer->voice);
+    else if (bSet) Mixer_StopVoice(buffer->voice, 0);
+    return SetStatus(OPEN_SEGA_SUCCESS);
+}
+
+// ======================================================================
+// SEGAAPI_Play / SEGAAPI_Pause / SEGAAPI_Stop / SEGAAPI_GetPlaybackStatus
+// (The status is an atomic word kept by the voice itself; voices that
+// reach the end of their data go back to STOP on their own, see mixer.h.)
+// ======================================================================
+// Content that settled by the time it plays is shared with identical buffers,
+// or kept as ADPCM (see samples.h). Returns false if the sample memory was
+// lost on the way, after which the buffer must not play.
+// (Not while other voices read the same data, see SEGAAPI_CreateInstance.)
+static bool shareSamples(OPEN_segaapiBuffer_t* buffer) {
+    if (!buffer->memory || buffer->owner || buffer->references.load(std::memory_order_acquire) > 1) return true;
+    if (!Mixer_VoiceIdle(buffer->voice)) return true;
+    if (!Samples_Share(buffer->memory)) return false;
+    // (Synth buffers keep their own copy, see prepareSynth)
+    if (buffer->sampleFormat != OPEN_HASF_SIGNED_16PCM || buffer->synth) return true;
+    MixerAdpcmSource* source = Samples_Compress(buffer->memory, buffer->channels);
+    if (source) Mixer_SetAdpcm(buffer->voice, source);
+    return true;
+}
+
+// Synth buffers play a converted copy of their data, made again when the
+// format changed or UpdateBuffer reported different data since the last
+// Play (see synth.h); the data is only hashed in that case
+static void prepareSynth(OPEN_segaapiBuffer_t* buffer) {
+    if (!buffer->synth || !buffer->data) return;
+    uint32_t generation = (buffer->owner ? buffer->owner : buffer)->dataGeneration.load(std::memory_order_relaxed);
+    if (!buffer->synthStale && generation == buffer->synthGeneration) return;
+    uint64_t hash = Hash64(buffer->data, buffer->size, (static_cast<uint64_t>(buffer->sampleFormat) << 32) | buffer->channels);
+    if (buffer->synthStale || hash != buffer->synthHash) {
+        SynthSamples* samples = Synth_NewSamples(buffer->data, buffer->size, buffer->sampleFormat, buffer->channels);
+        if (!samples) return;
+        buffer->synthHash = hash;
+        Mixer_SetSynthSamples(buffer->voice, samples);
     }
+    buffer->synthGeneration = generation;
+    buffer->synthStale = false;
+}
+
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_Play(void* hHandle) {
+    TRACE_CALL(Play, traceHandle(hHandle));
+    if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
+    auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
+    if (!shareSamples(buffer)) return SetStatus(OPEN_SEGAERR_UNKNOWN);
+    prepareSynth(buffer);
+    Mixer_PlayVoice(buffer->voice, 0);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_Pause(void* hHandle) {
+    TRACE_CALL(Pause, traceHandle(hHandle));
+    if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
+    auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
+    // Pausing a voice that is not playing leaves it as it is
+    Mixer_PauseVoice(buffer->voice);
+    return SetStatus(OPEN_SEGA_SUCCESS);
+}
+
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_Stop(void* hHandle) {
+    TRACE_CALL(Stop, traceHandle(hHandle));
+    if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
+    auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
+    Mixer_StopVoice(buffer->voice, 0);
+    return SetStatus(OPEN_SEGA_SUCCESS);
+}
+
+extern "C" OPENSEGAAPI_API OPEN_HAWOSTATUS SEGAAPI_GetPlaybackStatus(void* hHandle) {
+    TRACE_CALL(GetPlaybackStatus, traceHandle(hHandle));
+    if (!hHandle) {
+        SetStatus(OPEN_SEGAERR_BAD_HANDLE);
+        return OPEN_HAWOSTATUS_INVALID;
+    }
+    auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
+    return Mixer_VoiceStatus(buffer->voice);
+}
+
 // ======================================================================
 // SEGAAPI_PlayWithSetup
 // (Apply send routing, voice parameters, and synth parameters, then play)
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_PlayWithSetup(
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_PlayWithSetup(
     void* hHandle,
     unsigned int dwNumSendRouteParams, OPEN_SendRouteParamSet* pSendRouteParams,
     unsigned int dwNumSendLevelParams, OPEN_SendLevelParamSet* pSendLevelParams,
     unsigned int dwNumVoiceParams, OPEN_VoiceParamSet* pVoiceParams,
     unsigned int dwNumSynthParams, OPEN_SynthParamSet* pSynthParams
 ) {
+    TRACE_SCOPE(PlayWithSetup);
+    if (traceScope_.outermost()) {
+        // All four parameter arrays travel as one blob, in argument order
+        if (!pSendRouteParams) dwNumSendRouteParams = 0;
+        if (!pSendLevelParams) dwNumSendLevelParams = 0;
+        if (!pVoiceParams) dwNumVoiceParams = 0;
+        if (!pSynthParams) dwNumSynthParams = 0;
+        std::vector<uint8_t> setup;
+        auto append = [&setup](const void* data, size_t size) {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            if (size) setup.insert(setup.end(), bytes, bytes + size);
+        };
+        append(pSendRouteParams, dwNumSendRouteParams * sizeof(OPEN_SendRouteParamSet));
+        append(pSendLevelParams, dwNumSendLevelParams * sizeof(OPEN_SendLevelParamSet));
+        append(pVoiceParams, dwNumVoiceParams * sizeof(OPEN_VoiceParamSet));
+        append(pSynthParams, dwNumSynthParams * sizeof(OPEN_SynthParamSet));
+        Trace_Call(EXPORT_PlayWithSetup, setup.data(), setup.size(), { traceHandle(hHandle),
+            dwNumSendRouteParams, dwNumSendLevelParams, dwNumVoiceParams, dwNumSynthParams });
+    }
     if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
     if (pSendRouteParams && dwNumSendRouteParams > 0) {
         for (unsigned int i = 0; i < dwNumSendRouteParams; i++) {
@@ -582,81 +847,233 @@ extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_PlayWithSetup(
     return SEGAAPI_Play(hHandle);
 }
 
+// ======================================================================
+// Scheduled playback
+// (Traces record how far ahead of the audio clock each event was set, so
+// a replay schedules it the same distance ahead of its own clock.)
+// ======================================================================
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetAudioClock(unsigned long long* pqwSampleTime) {
+    TRACE_CALL(GetAudioClock);
+    if (!pqwSampleTime) return SetStatus(OPEN_SEGAERR_BAD_POINTER);
+    *pqwSampleTime = Mixer_Clock();
+    return SetStatus(OPEN_SEGA_SUCCESS);
+}
+
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_PlayAtTime(void* hHandle, unsigned long long qwSampleTime) {
+    TRACE_CALL(PlayAtTime, traceHandle(hHandle), static_cast<int64_t>(qwSampleTime - Mixer_Clock()));
+    if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
+    auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
+    if (!shareSamples(buffer)) return SetStatus(OPEN_SEGAERR_UNKNOWN);
+    prepareSynth(buffer);
+    Mixer_PlayVoice(buffer->voice, qwSampleTime);
+    return SetStatus(OPEN_SEGA_SUCCESS);
+}
+
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_StopAtTime(void* hHandle, unsigned long long qwSampleTime) {
+    TRACE_CALL(StopAtTime, traceHandle(hHandle), static_cast<int64_t>(qwSampleTime - Mixer_Clock()));
+    if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
+    auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
+    Mixer_StopVoice(buffer->voice, qwSampleTime);
+    return SetStatus(OPEN_SEGA_SUCCESS);
+}
+
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSynthParamAtTime(void* hHandle, OPEN_HASYNTHPARAMSEXT param, int lPARWValue, unsigned long long qwSampleTime) {
+    TRACE_CALL(SetSynthParamAtTime, traceHandle(hHandle), param, lPARWValue, static_cast<int64_t>(qwSampleTime - Mixer_Clock()));
+    if (!hHandle) return SetStatus(OPEN_SEGAERR_BAD_HANDLE);
+    auto* buffer = static_cast<OPEN_segaapiBuffer_t*>(hHandle);
+    if (static_cast<int>(param) < 0 || param >= NUM_SYNTH_PARAMS) return SetStatus(OPEN_SEGAERR_BAD_PARAM);
+    applySynthParam(buffer, param, lPARWValue, qwSampleTime);
+    return SetStatus(OPEN_SEGA_SUCCESS);
+}
+
 // ======================================================================
 // Global EAX Property Functions (stubs for OpenAL)
 // ======================================================================
-extern "C" __declspec(dllexport) int SEGAAPI_SetGlobalEAXProperty(GUID* guid, unsigned long ulProperty, void* pData, unsigned long ulDataSize) {
-    return TRUE;
+// GUID followed by the property data, as recorded in traces
+static std::vector<uint8_t> traceEAXBlob(const GUID* guid, const void* pData, unsigned long ulDataSize) {
+    std::vector<uint8_t> blob(sizeof(GUID) + (pData ? ulDataSize : 0));
+    if (guid) memcpy(blob.data(), guid, sizeof(GUID));
+    if (pData && ulDataSize) memcpy(blob.data() + sizeof(GUID), pData, ulDataSize);
+    return blob;
 }
 
-extern "C" __declspec(dllexport) int SEGAAPI_GetGlobalEAXProperty(GUID* guid, unsigned long ulProperty, void* pData, unsigned long ulDataSize) {
-    return TRUE;
+extern "C" OPENSEGAAPI_API int SEGAAPI_SetGlobalEAXProperty(GUID* guid, unsigned long ulProperty, void* pData, unsigned long ulDataSize) {
+    TRACE_SCOPE(SetGlobalEAXProperty);
+    if (traceScope_.outermost()) {
+        std::vector<uint8_t> blob = traceEAXBlob(guid, pData, ulDataSize);
+        Trace_Call(EXPORT_SetGlobalEAXProperty, blob.data(), blob.size(), { static_cast<int64_t>(ulProperty), static_cast<int64_t>(ulDataSize) });
+    }
+    return 1;
+}
+
+extern "C" OPENSEGAAPI_API int SEGAAPI_GetGlobalEAXProperty(GUID* guid, unsigned long ulProperty, void* pData, unsigned long ulDataSize) {
+    TRACE_SCOPE(GetGlobalEAXProperty);
+    if (traceScope_.outermost()) {
+        std::vector<uint8_t> blob = traceEAXBlob(guid, nullptr, 0);
+        Trace_Call(EXPORT_GetGlobalEAXProperty, blob.data(), blob.size(), { static_cast<int64_t>(ulProperty), static_cast<int64_t>(ulDataSize) });
+    }
+    return 1;
 }
 
 // ======================================================================
 // SPDIF Out functions (stubs for OpenAL)
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSPDIFOutChannelStatus(unsigned int dwChannelStatus, unsigned int dwExtChannelStatus) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSPDIFOutChannelStatus(unsigned int dwChannelStatus, unsigned int dwExtChannelStatus) {
+    TRACE_CALL(SetSPDIFOutChannelStatus, dwChannelStatus, dwExtChannelStatus);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_GetSPDIFOutChannelStatus(unsigned int* pdwChannelStatus, unsigned int* pdwExtChannelStatus) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetSPDIFOutChannelStatus(unsigned int* pdwChannelStatus, unsigned int* pdwExtChannelStatus) {
+    TRACE_CALL(GetSPDIFOutChannelStatus);
     if (!pdwChannelStatus || !pdwExtChannelStatus) return SetStatus(OPEN_SEGAERR_BAD_POINTER);
     *pdwChannelStatus = 0;
     *pdwExtChannelStatus = 0;
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSPDIFOutSampleRate(OPEN_HASPDIFOUTRATE dwSamplingRate) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSPDIFOutSampleRate(OPEN_HASPDIFOUTRATE dwSamplingRate) {
+    TRACE_CALL(SetSPDIFOutSampleRate, dwSamplingRate);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) OPEN_HASPDIFOUTRATE SEGAAPI_GetSPDIFOutSampleRate(void) {
+extern "C" OPENSEGAAPI_API OPEN_HASPDIFOUTRATE SEGAAPI_GetSPDIFOutSampleRate(void) {
+    TRACE_CALL(GetSPDIFOutSampleRate);
     return OPEN_HASPDIFOUT_44_1KHZ;
 }
 
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSPDIFOutChannelRouting(unsigned int dwChannel, OPEN_HAROUTING dwSource) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSPDIFOutChannelRouting(unsigned int dwChannel, OPEN_HAROUTING dwSource) {
+    TRACE_CALL(SetSPDIFOutChannelRouting, dwChannel, dwSource);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) OPEN_HAROUTING SEGAAPI_GetSPDIFOutChannelRouting(unsigned int dwChannel) {
+extern "C" OPENSEGAAPI_API OPEN_HAROUTING SEGAAPI_GetSPDIFOutChannelRouting(unsigned int dwChannel) {
+    TRACE_CALL(GetSPDIFOutChannelRouting, dwChannel);
     return OPEN_HA_UNUSED_PORT;
 }
 
 // ======================================================================
-// IO Volume functions (mapped to listener gain)
+// IO Volume functions (mapped to the mixer's master gain)
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetIOVolume(OPEN_HAPHYSICALIO dwPhysIO, unsigned int dwVolume) {
+static float g_ioVolume = 1.0f;
+
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetIOVolume(OPEN_HAPHYSICALIO dwPhysIO, unsigned int dwVolume) {
+    TRACE_CALL(SetIOVolume, dwPhysIO, dwVolume);
     constexpr float MAX_VOLUME = static_cast<float>(0xFFFFFFFF);
-    float normalized = std::clamp(dwVolume / MAX_VOLUME, 0.0f, 1.0f);
-    alListenerf(AL_GAIN, normalized);
+    g_ioVolume = std::clamp(dwVolume / MAX_VOLUME, 0.0f, 1.0f);
+    Mixer_Command(nullptr, MIXER_CMD_SET_MASTER_GAIN, 0, 0, g_ioVolume);
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
-extern "C" __declspec(dllexport) unsigned int SEGAAPI_GetIOVolume(OPEN_HAPHYSICALIO dwPhysIO) {
-    float gain = 1.0f;
-    alGetListenerf(AL_GAIN, &gain);
+extern "C" OPENSEGAAPI_API unsigned int SEGAAPI_GetIOVolume(OPEN_HAPHYSICALIO dwPhysIO) {
+    TRACE_CALL(GetIOVolume, dwPhysIO);
     constexpr float MAX_VOLUME = static_cast<float>(0xFFFFFFFF);
-    return static_cast<unsigned int>(gain * MAX_VOLUME);
+    return static_cast<unsigned int>(g_ioVolume * MAX_VOLUME);
 }
 
 // ======================================================================
 // Set/Get Last Status
 // ======================================================================
-extern "C" __declspec(dllexport) void SEGAAPI_SetLastStatus(OPEN_SEGASTATUS LastStatus) {
+extern "C" OPENSEGAAPI_API void SEGAAPI_SetLastStatus(OPEN_SEGASTATUS LastStatus) {
+    TRACE_CALL(SetLastStatus, LastStatus);
     g_lastStatus = LastStatus;
 }
 
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_GetLastStatus(void) {
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetLastStatus(void) {
+    TRACE_CALL(GetLastStatus);
     return g_lastStatus;
 }
 
 // ======================================================================
 // SEGAAPI_Reset
-// (Reset listener gain and flush any internal states.)
+// (Stops every buffer, drops scheduled commands and restores the default
+// mix and master gain. Buffers stay allocated and the device stays open,
+// so this is a cheap alternative to SEGAAPI_Exit + SEGAAPI_Init.)
+// ======================================================================
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_Reset(void) {
+    TRACE_CALL(Reset);
+    g_ioVolume = 1.0f;
+    Mixer_ClearSchedule();
+    Mixer_Command(nullptr, MIXER_CMD_SET_MASTER_GAIN, 0, 0, 1.0f);
+    std::lock_guard<std::mutex> lock(g_buffersLock);
+    for (OPEN_segaapiBuffer_t* buffer = g_buffers; buffer; buffer = buffer->next) {
+        Mixer_DefaultMix(buffer);
+        memset(buffer->synthParams, 0, sizeof(buffer->synthParams));
+        buffer->synthParamsSet = 0;
+        Mixer_ResetVoice(buffer->voice);
+    }
+    return SetStatus(OPEN_SEGA_SUCCESS);
+}
+
+// ======================================================================
+// SEGAAPI_GetStartupTimings
+// ======================================================================
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetStartupTimings(OPEN_HASTARTUPTIMINGS* pTimings) {
+    TRACE_CALL(GetStartupTimings);
+    if (!pTimings) return SetStatus(OPEN_SEGAERR_BAD_POINTER);
+    Device_ReadTimings(pTimings);
+    pTimings->dwInitUs = g_initUs;
+    return SetStatus(OPEN_SEGA_SUCCESS);
+}
+
+// ======================================================================
+// SEGAAPI_GetAdpcmStats
+// ======================================================================
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetAdpcmStats(OPEN_HAADPCMSTATS* pStats) {
+    TRACE_CALL(GetAdpcmStats);
+    if (!pStats) return SetStatus(OPEN_SEGAERR_BAD_POINTER);
+    Samples_ReadStats(pStats);
+    return SetStatus(OPEN_SEGA_SUCCESS);
+}
+
+// ======================================================================
+// Call statistics
+// (Per-export call counts and latency histograms, see stats.h)
+// ======================================================================
+extern "C" OPENSEGAAPI_API unsigned int SEGAAPI_GetStatsCount(void) {
+    TRACE_CALL(GetStatsCount);
+    return EXPORT_COUNT;
+}
+
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetStats(unsigned int dwExport, OPEN_HAEXPORTSTATS* pStats) {
+    TRACE_CALL(GetStats, dwExport);
+    if (!pStats) return SetStatus(OPEN_SEGAERR_BAD_POINTER);
+    if (dwExport >= EXPORT_COUNT) return SetStatus(OPEN_SEGAERR_BAD_PARAM);
+
+    StatsSnapshot snapshot;
+    Stats_Read(static_cast<OPEN_EXPORT>(dwExport), &snapshot);
+    memset(pStats, 0, sizeof(*pStats));
+    strncpy(pStats->szName, g_exportNames[dwExport], sizeof(pStats->szName) - 1);
+    pStats->qwCalls = snapshot.calls;
+    pStats->qwTotalNs = snapshot.totalNs;
+    pStats->qwMaxNs = snapshot.maxNs;
+    static_assert(OPEN_HASTATS_NUM_BUCKETS == STATS_NUM_BUCKETS, "bucket count mismatch");
+    for (int i = 0; i < OPEN_HASTATS_NUM_BUCKETS; i++) {
+        pStats->qwBuckets[i] = snapshot.buckets[i];
+        pStats->qwBucketLimitNs[i] = snapshot.bucketLimitNs[i];
+    }
+    return SetStatus(OPEN_SEGA_SUCCESS);
+}
+
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_ResetStats(void) {
+    TRACE_CALL(ResetStats);
+    Stats_Reset();
+    return SetStatus(OPEN_SEGA_SUCCESS);
+}
+
 // ======================================================================
-extern "C" __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_Reset(void) {
-    alListenerf(AL_GAIN, 1.0f);
+// Mixer telemetry
+// (Render timing, underruns and headroom of the software mixer, see mixer.h)
+// ======================================================================
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetMixerTelemetry(OPEN_HAMIXERTELEMETRY* pTelemetry) {
+    TRACE_CALL(GetMixerTelemetry);
+    if (!pTelemetry) return SetStatus(OPEN_SEGAERR_BAD_POINTER);
+    Mixer_ReadTelemetry(pTelemetry);
+    return SetStatus(OPEN_SEGA_SUCCESS);
+}
+
+extern "C" OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_ResetMixerTelemetry(void) {
+    TRACE_CALL(ResetMixerTelemetry);
+    Mixer_ResetTelemetry();
     return SetStatus(OPEN_SEGA_SUCCESS);
 }
 
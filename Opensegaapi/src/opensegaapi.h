@@ -5,9 +5,27 @@
 extern "C" {
 #endif
 
-#include <guiddef.h>
 #include <stdint.h>
 
+// ----------------------------------------------------------------------
+// Portability: export attribute and the GUID type of the EAX calls
+// ----------------------------------------------------------------------
+#ifdef _WIN32
+#include <guiddef.h>
+#define OPENSEGAAPI_API __declspec(dllexport)
+#else
+#define OPENSEGAAPI_API __attribute__((visibility("default")))
+#ifndef GUID_DEFINED
+#define GUID_DEFINED
+typedef struct _GUID {
+    uint32_t Data1;
+    uint16_t Data2;
+    uint16_t Data3;
+    uint8_t Data4[8];
+} GUID;
+#endif
+#endif
+
 // ----------------------------------------------------------------------
 // Status codes and helper macros
 // ----------------------------------------------------------------------
@@ -19,6 +37,8 @@ extern "C" {
 #define OPEN_SEGAERR_INVALID_SEND OPEN_SEGARESULT_FAILURE(11)
 #define OPEN_SEGAERR_BAD_HANDLE OPEN_SEGARESULT_FAILURE(18)
 #define OPEN_SEGAERR_BAD_SAMPLERATE OPEN_SEGARESULT_FAILURE(28)
+#define OPEN_SEGAERR_OUT_OF_MEMORY OPEN_SEGARESULT_FAILURE(31)
+#define OPEN_SEGAERR_INVALID_PARAM OPEN_SEGAERR_BAD_PARAM
 
 typedef int OPEN_SEGASTATUS;
 
@@ -179,6 +199,72 @@ typedef struct {
     int lPARWValue;
 } OPEN_SynthParamSet;
 
+// ----------------------------------------------------------------------
+// Per-export call statistics (SEGAAPI_GetStats)
+// ----------------------------------------------------------------------
+#define OPEN_HASTATS_NUM_BUCKETS 32
+
+typedef struct {
+    char szName[48];
+    unsigned long long qwCalls;
+    unsigned long long qwTotalNs;
+    unsigned long long qwMaxNs;
+    // Bucket i counts calls that took longer than bucket i-1's limit and up to qwBucketLimitNs[i]
+    unsigned long long qwBuckets[OPEN_HASTATS_NUM_BUCKETS];
+    unsigned long long qwBucketLimitNs[OPEN_HASTATS_NUM_BUCKETS];
+} OPEN_HAEXPORTSTATS;
+
+// ----------------------------------------------------------------------
+// Mixer health (SEGAAPI_GetMixerTelemetry)
+// ----------------------------------------------------------------------
+typedef struct {
+    unsigned int dwSampleRate;
+    unsigned int dwPeriodFrames;
+    unsigned int dwPeriodCount;
+    unsigned int dwPeriodNs;            // time budget of one period
+    unsigned long long qwPeriods;       // periods rendered
+    unsigned long long qwUnderruns;     // times the device ran out of queued audio
+    unsigned int dwRenderNsLast;        // time spent rendering the last period
+    unsigned int dwRenderNsAvg;         // moving average over recent periods
+    unsigned int dwRenderNsMax;
+    unsigned int dwJitterNsMax;         // worst lateness of a period refill
+    unsigned int dwActiveVoices;        // voices mixed in the last period
+    unsigned int dwPeakVoices;
+    float fHeadroomPercent;             // 100 * (1 - average render time / period)
+} OPEN_HAMIXERTELEMETRY;
+
+// ----------------------------------------------------------------------
+// Device bring-up (SEGAAPI_GetStartupTimings)
+// ----------------------------------------------------------------------
+typedef enum {
+    OPEN_HASTARTUP_CLOSED,
+    OPEN_HASTARTUP_OPENING,
+    OPEN_HASTARTUP_READY,
+    OPEN_HASTARTUP_FAILED
+} OPEN_HASTARTUPSTATE;
+
+typedef struct {
+    unsigned int dwState;               // OPEN_HASTARTUPSTATE
+    unsigned int dwOpenDeviceUs;        // alcOpenDevice
+    unsigned int dwCreateContextUs;     // latency profile selection and alcCreateContext
+    unsigned int dwStartMixerUs;
+    unsigned int dwReadyUs;             // from the start of the open until ready (or failed)
+    unsigned int dwInitUs;              // time spent inside SEGAAPI_Init
+} OPEN_HASTARTUPTIMINGS;
+
+// ----------------------------------------------------------------------
+// ADPCM sample storage (SEGAAPI_GetAdpcmStats)
+// ----------------------------------------------------------------------
+typedef struct {
+    unsigned int dwBuffers;             // buffers currently held as ADPCM
+    unsigned long long qwPcmBytes;      // their size as PCM
+    unsigned long long qwAdpcmBytes;    // their size as ADPCM
+    unsigned long long qwEncodeNs;      // total time spent encoding
+    unsigned long long qwBlocksDecoded; // blocks decoded by the mixer
+    unsigned long long qwDecodeNs;      // time the mixer spent on them
+    unsigned long long qwExpansions;    // buffers decoded back because the game touched them
+} OPEN_HAADPCMSTATS;
+
 // ----------------------------------------------------------------------
 // Callback definition (message type is represented as int here)
 // ----------------------------------------------------------------------
@@ -187,61 +273,95 @@ typedef void(*OPEN_HAWOSEGABUFFERCALLBACK)(void* hHandle, int message);
 // ----------------------------------------------------------------------
 // Function Declarations
 // ----------------------------------------------------------------------
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_Init(void);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_Exit(void);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_CreateBuffer(OPEN_HAWOSEBUFFERCONFIG* pConfig, OPEN_HAWOSEGABUFFERCALLBACK pCallback, unsigned int dwFlags, void** phHandle);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_DestroyBuffer(void* hHandle);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetUserData(void* hHandle, void* hUserData);
-__declspec(dllexport) void* SEGAAPI_GetUserData(void* hHandle);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetFormat(void* hHandle, OPEN_HAWOSEFORMAT* pFormat);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_GetFormat(void* hHandle, OPEN_HAWOSEFORMAT* pFormat);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSampleRate(void* hHandle, unsigned int dwSampleRate);
-__declspec(dllexport) unsigned int SEGAAPI_GetSampleRate(void* hHandle);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetPriority(void* hHandle, unsigned int dwPriority);
-__declspec(dllexport) unsigned int SEGAAPI_GetPriority(void* hHandle);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSendRouting(void* hHandle, unsigned int dwChannel, unsigned int dwSend, OPEN_HAROUTING dwDest);
-__declspec(dllexport) OPEN_HAROUTING SEGAAPI_GetSendRouting(void* hHandle, unsigned int dwChannel, unsigned int dwSend);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSendLevel(void* hHandle, unsigned int dwChannel, unsigned int dwSend, unsigned int dwLevel);
-__declspec(dllexport) unsigned int SEGAAPI_GetSendLevel(void* hHandle, unsigned int dwChannel, unsigned int dwSend);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetChannelVolume(void* hHandle, unsigned int dwChannel, unsigned int dwVolume);
-__declspec(dllexport) unsigned int SEGAAPI_GetChannelVolume(void* hHandle, unsigned int dwChannel);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetPlaybackPosition(void* hHandle, unsigned int dwPlaybackPos);
-__declspec(dllexport) unsigned int SEGAAPI_GetPlaybackPosition(void* hHandle);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetNotificationFrequency(void* hHandle, unsigned int dwFrameCount);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetNotificationPoint(void* hHandle, unsigned int dwBufferOffset);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_ClearNotificationPoint(void* hHandle, unsigned int dwBufferOffset);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetStartLoopOffset(void* hHandle, unsigned int dwOffset);
-__declspec(dllexport) unsigned int SEGAAPI_GetStartLoopOffset(void* hHandle);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetEndLoopOffset(void* hHandle, unsigned int dwOffset);
-__declspec(dllexport) unsigned int SEGAAPI_GetEndLoopOffset(void* hHandle);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetEndOffset(void* hHandle, unsigned int dwOffset);
-__declspec(dllexport) unsigned int SEGAAPI_GetEndOffset(void* hHandle);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetLoopState(void* hHandle, int bDoContinuousLooping);
-__declspec(dllexport) int SEGAAPI_GetLoopState(void* hHandle);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_UpdateBuffer(void* hHandle, unsigned int dwStartOffset, unsigned int dwLength);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSynthParam(void* hHandle, OPEN_HASYNTHPARAMSEXT param, int lPARWValue);
-__declspec(dllexport) int SEGAAPI_GetSynthParam(void* hHandle, OPEN_HASYNTHPARAMSEXT param);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSynthParamMultiple(void* hHandle, unsigned int dwNumParams, OPEN_SynthParamSet* pSynthParams);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_GetSynthParamMultiple(void* hHandle, unsigned int dwNumParams, OPEN_SynthParamSet* pSynthParams);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetReleaseState(void* hHandle, int bSet);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_PlayWithSetup(void* hHandle,
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_Init(void);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_Exit(void);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_CreateBuffer(OPEN_HAWOSEBUFFERCONFIG* pConfig, OPEN_HAWOSEGABUFFERCALLBACK pCallback, unsigned int dwFlags, void** phHandle);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_DestroyBuffer(void* hHandle);
+// A new handle playing the sample data of hSource, with its own position,
+// pitch, gain, routing and loop settings (no copy of the samples). Destroy
+// it with SEGAAPI_DestroyBuffer; the data stays until all handles are gone.
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_CreateInstance(void* hSource, void** phHandle);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetUserData(void* hHandle, void* hUserData);
+OPENSEGAAPI_API void* SEGAAPI_GetUserData(void* hHandle);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetFormat(void* hHandle, OPEN_HAWOSEFORMAT* pFormat);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetFormat(void* hHandle, OPEN_HAWOSEFORMAT* pFormat);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSampleRate(void* hHandle, unsigned int dwSampleRate);
+OPENSEGAAPI_API unsigned int SEGAAPI_GetSampleRate(void* hHandle);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetPriority(void* hHandle, unsigned int dwPriority);
+OPENSEGAAPI_API unsigned int SEGAAPI_GetPriority(void* hHandle);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSendRouting(void* hHandle, unsigned int dwChannel, unsigned int dwSend, OPEN_HAROUTING dwDest);
+OPENSEGAAPI_API OPEN_HAROUTING SEGAAPI_GetSendRouting(void* hHandle, unsigned int dwChannel, unsigned int dwSend);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSendLevel(void* hHandle, unsigned int dwChannel, unsigned int dwSend, unsigned int dwLevel);
+OPENSEGAAPI_API unsigned int SEGAAPI_GetSendLevel(void* hHandle, unsigned int dwChannel, unsigned int dwSend);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetChannelVolume(void* hHandle, unsigned int dwChannel, unsigned int dwVolume);
+OPENSEGAAPI_API unsigned int SEGAAPI_GetChannelVolume(void* hHandle, unsigned int dwChannel);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetPlaybackPosition(void* hHandle, unsigned int dwPlaybackPos);
+OPENSEGAAPI_API unsigned int SEGAAPI_GetPlaybackPosition(void* hHandle);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetNotificationFrequency(void* hHandle, unsigned int dwFrameCount);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetNotificationPoint(void* hHandle, unsigned int dwBufferOffset);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_ClearNotificationPoint(void* hHandle, unsigned int dwBufferOffset);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetStartLoopOffset(void* hHandle, unsigned int dwOffset);
+OPENSEGAAPI_API unsigned int SEGAAPI_GetStartLoopOffset(void* hHandle);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetEndLoopOffset(void* hHandle, unsigned int dwOffset);
+OPENSEGAAPI_API unsigned int SEGAAPI_GetEndLoopOffset(void* hHandle);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetEndOffset(void* hHandle, unsigned int dwOffset);
+OPENSEGAAPI_API unsigned int SEGAAPI_GetEndOffset(void* hHandle);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetLoopState(void* hHandle, int bDoContinuousLooping);
+OPENSEGAAPI_API int SEGAAPI_GetLoopState(void* hHandle);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_UpdateBuffer(void* hHandle, unsigned int dwStartOffset, unsigned int dwLength);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSynthParam(void* hHandle, OPEN_HASYNTHPARAMSEXT param, int lPARWValue);
+OPENSEGAAPI_API int SEGAAPI_GetSynthParam(void* hHandle, OPEN_HASYNTHPARAMSEXT param);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSynthParamMultiple(void* hHandle, unsigned int dwNumParams, OPEN_SynthParamSet* pSynthParams);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetSynthParamMultiple(void* hHandle, unsigned int dwNumParams, OPEN_SynthParamSet* pSynthParams);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetReleaseState(void* hHandle, int bSet);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_Play(void* hHandle);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_Pause(void* hHandle);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_Stop(void* hHandle);
+OPENSEGAAPI_API OPEN_HAWOSTATUS SEGAAPI_GetPlaybackStatus(void* hHandle);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_PlayWithSetup(void* hHandle,
     unsigned int dwNumSendRouteParams, OPEN_SendRouteParamSet* pSendRouteParams,
     unsigned int dwNumSendLevelParams, OPEN_SendLevelParamSet* pSendLevelParams,
     unsigned int dwNumVoiceParams, OPEN_VoiceParamSet* pVoiceParams,
     unsigned int dwNumSynthParams, OPEN_SynthParamSet* pSynthParams);
-__declspec(dllexport) int SEGAAPI_SetGlobalEAXProperty(GUID* guid, unsigned long ulProperty, void* pData, unsigned long ulDataSize);
-__declspec(dllexport) int SEGAAPI_GetGlobalEAXProperty(GUID* guid, unsigned long ulProperty, void* pData, unsigned long ulDataSize);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSPDIFOutChannelStatus(unsigned int dwChannelStatus, unsigned int dwExtChannelStatus);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_GetSPDIFOutChannelStatus(unsigned int* pdwChannelStatus, unsigned int* pdwExtChannelStatus);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSPDIFOutSampleRate(OPEN_HASPDIFOUTRATE dwSamplingRate);
-__declspec(dllexport) OPEN_HASPDIFOUTRATE SEGAAPI_GetSPDIFOutSampleRate(void);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSPDIFOutChannelRouting(unsigned int dwChannel, OPEN_HAROUTING dwSource);
-__declspec(dllexport) OPEN_HAROUTING SEGAAPI_GetSPDIFOutChannelRouting(unsigned int dwChannel);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetIOVolume(OPEN_HAPHYSICALIO dwPhysIO, unsigned int dwVolume);
-__declspec(dllexport) unsigned int SEGAAPI_GetIOVolume(OPEN_HAPHYSICALIO dwPhysIO);
-__declspec(dllexport) void SEGAAPI_SetLastStatus(OPEN_SEGASTATUS LastStatus);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_GetLastStatus(void);
-__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_Reset(void);
+OPENSEGAAPI_API int SEGAAPI_SetGlobalEAXProperty(GUID* guid, unsigned long ulProperty, void* pData, unsigned long ulDataSize);
+OPENSEGAAPI_API int SEGAAPI_GetGlobalEAXProperty(GUID* guid, unsigned long ulProperty, void* pData, unsigned long ulDataSize);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSPDIFOutChannelStatus(unsigned int dwChannelStatus, unsigned int dwExtChannelStatus);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetSPDIFOutChannelStatus(unsigned int* pdwChannelStatus, unsigned int* pdwExtChannelStatus);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSPDIFOutSampleRate(OPEN_HASPDIFOUTRATE dwSamplingRate);
+OPENSEGAAPI_API OPEN_HASPDIFOUTRATE SEGAAPI_GetSPDIFOutSampleRate(void);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSPDIFOutChannelRouting(unsigned int dwChannel, OPEN_HAROUTING dwSource);
+OPENSEGAAPI_API OPEN_HAROUTING SEGAAPI_GetSPDIFOutChannelRouting(unsigned int dwChannel);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetIOVolume(OPEN_HAPHYSICALIO dwPhysIO, unsigned int dwVolume);
+OPENSEGAAPI_API unsigned int SEGAAPI_GetIOVolume(OPEN_HAPHYSICALIO dwPhysIO);
+OPENSEGAAPI_API void SEGAAPI_SetLastStatus(OPEN_SEGASTATUS LastStatus);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetLastStatus(void);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_Reset(void);
+OPENSEGAAPI_API unsigned int SEGAAPI_GetStatsCount(void);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetStats(unsigned int dwExport, OPEN_HAEXPORTSTATS* pStats);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_ResetStats(void);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetMixerTelemetry(OPEN_HAMIXERTELEMETRY* pTelemetry);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_ResetMixerTelemetry(void);
+
+// Scheduled playback. Times are output sample frames on the audio clock
+// (SEGAAPI_GetAudioClock returns the next frame the mixer will render;
+// it is heard about one period count of latency later). Events land on
+// their exact frame; times already rendered apply at the next period.
+// A voice started with SEGAAPI_PlayAtTime reports OPEN_HAWOSTATUS_STOP
+// until the mixer reaches its frame, then OPEN_HAWOSTATUS_ACTIVE.
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetAudioClock(unsigned long long* pqwSampleTime);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_PlayAtTime(void* hHandle, unsigned long long qwSampleTime);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_StopAtTime(void* hHandle, unsigned long long qwSampleTime);
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_SetSynthParamAtTime(void* hHandle, OPEN_HASYNTHPARAMSEXT param, int lPARWValue, unsigned long long qwSampleTime);
+
+// Playback positions (bytes) of several buffers in one call; null handles read as 0
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetPlaybackPositions(unsigned int dwNumHandles, void** phHandles, unsigned int* pdwPositions);
+
+// The device is opened in the background from DLL load; SEGAAPI_Init returns
+// at once and calls made meanwhile take effect once it is ready
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetStartupTimings(OPEN_HASTARTUPTIMINGS* pTimings);
+
+// Large 16 bit buffers can be kept as IMA-ADPCM (OPENSEGAAPI_ADPCM_MIN_BYTES)
+OPENSEGAAPI_API OPEN_SEGASTATUS SEGAAPI_GetAdpcmStats(OPEN_HAADPCMSTATS* pStats);
 
 #ifdef __cplusplus
 }
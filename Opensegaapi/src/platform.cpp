@@ -0,0 +1,329 @@
+// platform.cpp - Operating system services for Windows and Linux
+//
+// This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+
+#include "platform.h"
+#include "config.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#include <cstdio>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+#endif
+
+#ifdef _WIN32
+// ======================================================================
+// Windows
+// ======================================================================
+void Platform_DebugOutput(const char* text) {
+    OutputDebugStringA(text);
+}
+
+void Platform_RealtimeThread(int levelsBelow) {
+    // TIME_CRITICAL, then the normal scale down from HIGHEST
+    SetThreadPriority(GetCurrentThread(), levelsBelow <= 0 ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST + 1 - levelsBelow);
+}
+
+// WaitOnAddress is looked up at run time, as Windows 7 does not have it
+struct PlatformAddressWaits {
+    BOOL (WINAPI* waitOnAddress)(volatile VOID*, PVOID, SIZE_T, DWORD);
+    void (WINAPI* wakeByAddressAll)(PVOID);
+};
+
+static const PlatformAddressWaits* platformAddressWaits() {
+    static const PlatformAddressWaits* waits = [] () -> const PlatformAddressWaits* {
+        static PlatformAddressWaits api;
+        HMODULE kernel = GetModuleHandleW(L"kernelbase.dll");
+        if (!kernel) return nullptr;
+        api.waitOnAddress = reinterpret_cast<decltype(api.waitOnAddress)>(GetProcAddress(kernel, "WaitOnAddress"));
+        api.wakeByAddressAll = reinterpret_cast<decltype(api.wakeByAddressAll)>(GetProcAddress(kernel, "WakeByAddressAll"));
+        return api.waitOnAddress && api.wakeByAddressAll ? &api : nullptr;
+    }();
+    return waits;
+}
+
+void Platform_WaitOnAddress(const std::atomic<uint32_t>* address, uint32_t value) {
+    if (const PlatformAddressWaits* api = platformAddressWaits())
+        api->waitOnAddress(const_cast<std::atomic<uint32_t>*>(address), &value, sizeof(value), INFINITE);
+}
+
+void Platform_WakeAddress(const std::atomic<uint32_t>* address) {
+    if (const PlatformAddressWaits* api = platformAddressWaits())
+        api->wakeByAddressAll(const_cast<std::atomic<uint32_t>*>(address));
+}
+
+bool Platform_CanWaitOnAddress() {
+    return platformAddressWaits() != nullptr;
+}
+
+void Platform_BeginTimerPeriod() {
+    timeBeginPeriod(1);
+}
+
+void Platform_EndTimerPeriod() {
+    timeEndPeriod(1);
+}
+
+void Platform_PinLibrary(bool pinned) {
+    static HMODULE library = nullptr;
+    if (pinned && !library) {
+        GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+            reinterpret_cast<LPCWSTR>(&Platform_PinLibrary), &library);
+    } else if (!pinned && library) {
+        FreeLibrary(library);
+        library = nullptr;
+    }
+}
+
+std::string Platform_ComputerName() {
+    char computer[256] = "";
+    DWORD computerSize = sizeof(computer);
+    if (!GetComputerNameA(computer, &computerSize)) return std::string();
+    return computer;
+}
+
+std::string Platform_DataPath(const char* name) {
+    const char* appData = ConfigGetString("LOCALAPPDATA");
+    return appData ? std::string(appData) + "\\" + name : std::string();
+}
+
+// Placeholders (Windows 10 1803 and up) keep an address range reserved
+// while what is mapped in it is swapped, so no other thread can take it
+// meanwhile. They are looked up at run time, as the SDK and older systems
+// do not have them; without them Platform_ReplaceView always fails.
+#ifndef MEM_RESERVE_PLACEHOLDER
+#define MEM_RESERVE_PLACEHOLDER 0x00040000
+#define MEM_REPLACE_PLACEHOLDER 0x00004000
+#define MEM_PRESERVE_PLACEHOLDER 0x00000002
+#endif
+
+struct PlatformPlaceholders {
+    PVOID (WINAPI* virtualAlloc2)(HANDLE, PVOID, SIZE_T, ULONG, ULONG, void*, ULONG);
+    PVOID (WINAPI* mapViewOfFile3)(HANDLE, HANDLE, PVOID, ULONG64, SIZE_T, ULONG, ULONG, void*, ULONG);
+    BOOL (WINAPI* unmapViewOfFile2)(HANDLE, PVOID, ULONG);
+};
+
+static const PlatformPlaceholders* platformPlaceholders() {
+    static const PlatformPlaceholders* placeholders = [] () -> const PlatformPlaceholders* {
+        static PlatformPlaceholders api;
+        HMODULE kernel = GetModuleHandleW(L"kernelbase.dll");
+        if (!kernel) return nullptr;
+        api.virtualAlloc2 = reinterpret_cast<decltype(api.virtualAlloc2)>(GetProcAddress(kernel, "VirtualAlloc2"));
+        api.mapViewOfFile3 = reinterpret_cast<decltype(api.mapViewOfFile3)>(GetProcAddress(kernel, "MapViewOfFile3"));
+        api.unmapViewOfFile2 = reinterpret_cast<decltype(api.unmapViewOfFile2)>(GetProcAddress(kernel, "UnmapViewOfFile2"));
+        return api.virtualAlloc2 && api.mapViewOfFile3 && api.unmapViewOfFile2 ? &api : nullptr;
+    }();
+    return placeholders;
+}
+
+// Placeholders are whole pages
+static size_t platformPages(size_t size) {
+    const size_t PAGE_BYTES = 4096;
+    return (size + PAGE_BYTES - 1) / PAGE_BYTES * PAGE_BYTES;
+}
+
+PlatformSection* Platform_NewSection(size_t size) {
+    return reinterpret_cast<PlatformSection*>(CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), nullptr));
+}
+
+void Platform_CloseSection(PlatformSection* section) {
+    CloseHandle(reinterpret_cast<HANDLE>(section));
+}
+
+void* Platform_MapView(PlatformSection* section, size_t size, PlatformViewAccess access, void* at) {
+    static const DWORD accessFlags[] = { FILE_MAP_READ, FILE_MAP_WRITE, FILE_MAP_COPY };
+    void* view = MapViewOfFileEx(reinterpret_cast<HANDLE>(section), accessFlags[access], 0, 0, size, at);
+    if (view && at && view != at) {
+        UnmapViewOfFile(view);
+        return nullptr;
+    }
+    return view;
+}
+
+void Platform_UnmapView(void* view, size_t size) {
+    UnmapViewOfFile(view);
+}
+
+// The range goes back to being a placeholder, then the view replaces it.
+// Ranges from Platform_Reserve are placeholders to begin with, and views
+// mapped here leave one behind too.
+PlatformReplace Platform_ReplaceView(PlatformSection* section, size_t size, PlatformViewAccess access, void* at) {
+    static const ULONG protections[] = { PAGE_READONLY, PAGE_READWRITE, PAGE_WRITECOPY };
+    const PlatformPlaceholders* api = platformPlaceholders();
+    MEMORY_BASIC_INFORMATION range;
+    if (!api || !VirtualQuery(at, &range, sizeof(range))) return PLATFORM_KEPT;
+    HANDLE process = GetCurrentProcess();
+    BOOL released = range.Type == MEM_MAPPED ? api->unmapViewOfFile2(process, at, MEM_PRESERVE_PLACEHOLDER)
+                                             : VirtualFree(at, 0, MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER);
+    if (!released) return PLATFORM_KEPT;
+    if (api->mapViewOfFile3(reinterpret_cast<HANDLE>(section), process, at, 0, size, MEM_REPLACE_PLACEHOLDER,
+            protections[access], nullptr, 0)) {
+        return PLATFORM_REPLACED;
+    }
+
+    // The placeholder is still ours: fill it with a private copy of the section
+    void* view = Platform_MapView(section, size, PLATFORM_VIEW_READ);
+    if (!view) return PLATFORM_LOST;
+    bool copied = api->virtualAlloc2(process, at, platformPages(size), MEM_RESERVE | MEM_COMMIT | MEM_REPLACE_PLACEHOLDER,
+        PAGE_READWRITE, nullptr, 0) != nullptr;
+    if (copied) memcpy(at, view, size);
+    Platform_UnmapView(view, size);
+    return copied ? PLATFORM_COPIED : PLATFORM_LOST;
+}
+
+void* Platform_Reserve(void* at, size_t size, bool commit) {
+    DWORD type = commit ? MEM_RESERVE | MEM_COMMIT : MEM_RESERVE;
+    DWORD protection = commit ? PAGE_READWRITE : PAGE_NOACCESS;
+    void* range = nullptr;
+    if (const PlatformPlaceholders* api = platformPlaceholders()) {
+        // In a placeholder, for Platform_ReplaceView
+        size = platformPages(size);
+        range = api->virtualAlloc2(nullptr, at, size, MEM_RESERVE | MEM_RESERVE_PLACEHOLDER, PAGE_NOACCESS, nullptr, 0);
+        if (range && !api->virtualAlloc2(nullptr, range, size, type | MEM_REPLACE_PLACEHOLDER, protection, nullptr, 0)) {
+            VirtualFree(range, 0, MEM_RELEASE);
+            range = nullptr;
+        }
+    } else {
+        range = VirtualAlloc(at, size, type, protection);
+    }
+    if (range && at && range != at) {
+        VirtualFree(range, 0, MEM_RELEASE);
+        return nullptr;
+    }
+    return range;
+}
+
+bool Platform_Discard(void* address, size_t size) {
+    return VirtualAlloc(address, size, MEM_RESET, PAGE_READWRITE) != nullptr;
+}
+
+void Platform_Release(void* address, size_t size) {
+    VirtualFree(address, 0, MEM_RELEASE);
+}
+
+#else
+// ======================================================================
+// Linux
+// ======================================================================
+void Platform_DebugOutput(const char* text) {
+    fputs(text, stderr);
+}
+
+void Platform_RealtimeThread(int levelsBelow) {
+    sched_param param = {};
+    param.sched_priority = std::max(sched_get_priority_max(SCHED_FIFO) - levelsBelow, sched_get_priority_min(SCHED_FIFO));
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+}
+
+// std::atomic<uint32_t> is a plain 32 bit word, which is what a futex is
+void Platform_WaitOnAddress(const std::atomic<uint32_t>* address, uint32_t value) {
+    syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+}
+
+void Platform_WakeAddress(const std::atomic<uint32_t>* address) {
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+bool Platform_CanWaitOnAddress() {
+    return true;
+}
+
+void Platform_BeginTimerPeriod() {}
+void Platform_EndTimerPeriod() {}
+
+void Platform_PinLibrary(bool pinned) {}
+
+std::string Platform_ComputerName() {
+    char computer[256] = "";
+    if (gethostname(computer, sizeof(computer) - 1) != 0) return std::string();
+    return computer;
+}
+
+std::string Platform_DataPath(const char* name) {
+    const char* cache = ConfigGetString("XDG_CACHE_HOME");
+    if (cache) return std::string(cache) + "/" + name;
+    const char* home = ConfigGetString("HOME");
+    return home ? std::string(home) + "/.cache/" + name : std::string();
+}
+
+// A section is a memfd; the handle is the descriptor plus one, so that
+// descriptor 0 is not a null handle
+PlatformSection* Platform_NewSection(size_t size) {
+    int fd = memfd_create("opensegaapi", MFD_CLOEXEC);
+    if (fd < 0) return nullptr;
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    return reinterpret_cast<PlatformSection*>(static_cast<intptr_t>(fd) + 1);
+}
+
+static int platformSectionFd(PlatformSection* section) {
+    return static_cast<int>(reinterpret_cast<intptr_t>(section) - 1);
+}
+
+void Platform_CloseSection(PlatformSection* section) {
+    close(platformSectionFd(section));
+}
+
+// Maps at exactly the given address without replacing what is there. Kernels
+// before 4.17 ignore MAP_FIXED_NOREPLACE and may map elsewhere instead.
+static void* platformMap(void* at, size_t size, int protection, int flags, int fd) {
+    void* range = mmap(at, size, protection, flags | (at ? MAP_FIXED_NOREPLACE : 0), fd, 0);
+    if (range == MAP_FAILED) return nullptr;
+    if (at && range != at) {
+        munmap(range, size);
+        return nullptr;
+    }
+    return range;
+}
+
+void* Platform_MapView(PlatformSection* section, size_t size, PlatformViewAccess access, void* at) {
+    int protection = access == PLATFORM_VIEW_READ ? PROT_READ : PROT_READ | PROT_WRITE;
+    int flags = access == PLATFORM_VIEW_COPY ? MAP_PRIVATE : MAP_SHARED;
+    return platformMap(at, size, protection, flags, platformSectionFd(section));
+}
+
+void Platform_UnmapView(void* view, size_t size) {
+    munmap(view, size);
+}
+
+PlatformReplace Platform_ReplaceView(PlatformSection* section, size_t size, PlatformViewAccess access, void* at) {
+    int protection = access == PLATFORM_VIEW_READ ? PROT_READ : PROT_READ | PROT_WRITE;
+    int flags = (access == PLATFORM_VIEW_COPY ? MAP_PRIVATE : MAP_SHARED) | MAP_FIXED;
+    if (mmap(at, size, protection, flags, platformSectionFd(section), 0) != MAP_FAILED) return PLATFORM_REPLACED;
+    // MAP_FIXED can fail after taking the old mapping down; msync only succeeds on mapped pages
+    return msync(at, size, MS_ASYNC) == 0 ? PLATFORM_KEPT : PLATFORM_LOST;
+}
+
+void* Platform_Reserve(void* at, size_t size, bool commit) {
+    int protection = commit ? PROT_READ | PROT_WRITE : PROT_NONE;
+    return platformMap(at, size, protection, MAP_PRIVATE | MAP_ANONYMOUS | (commit ? 0 : MAP_NORESERVE), -1);
+}
+
+bool Platform_Discard(void* address, size_t size) {
+    return madvise(address, size, MADV_DONTNEED) == 0;
+}
+
+void Platform_Release(void* address, size_t size) {
+    munmap(address, size);
+}
+
+#endif
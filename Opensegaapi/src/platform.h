@@ -0,0 +1,101 @@
+#ifndef OPENSEGAAPI_PLATFORM_H
+#define OPENSEGAAPI_PLATFORM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+// ----------------------------------------------------------------------
+// The operating system services the library uses beyond the C++ standard
+// library, for Windows and for Linux. Everything else is portable code;
+// new OS calls belong here rather than behind #ifdefs elsewhere.
+// ----------------------------------------------------------------------
+
+// Debug output: the debugger on Windows, stderr elsewhere
+void Platform_DebugOutput(const char* text);
+
+// Raises the calling thread to the highest priority it may have, or to
+// the given number of levels below it (best effort: without the right to
+// real-time scheduling this does nothing)
+void Platform_RealtimeThread(int levelsBelow = 0);
+
+// Sleeps while *address holds value, until Platform_WakeAddress is called
+// for it (a futex on Linux, WaitOnAddress on Windows). May return early,
+// so callers check the value again. Neither call takes a lock.
+void Platform_WaitOnAddress(const std::atomic<uint32_t>* address, uint32_t value);
+// Wakes every thread waiting on the address
+void Platform_WakeAddress(const std::atomic<uint32_t>* address);
+// Whether the system has Platform_WaitOnAddress (not Windows before 8)
+bool Platform_CanWaitOnAddress();
+
+// Fine-grained timer wakeups while the mixer runs (1 ms on Windows; the
+// default on Linux already is)
+void Platform_BeginTimerPeriod();
+void Platform_EndTimerPeriod();
+
+// Holds a reference on this library, or drops it, so that it is not
+// unloaded under threads of its own. Only Windows needs it: dlclose runs
+// the shutdown registered by SEGAAPI_Init.
+void Platform_PinLibrary(bool pinned);
+
+// Name of this machine, "" if unknown
+std::string Platform_ComputerName();
+
+// Path of a file in the per-user local data directory, "" if there is none
+std::string Platform_DataPath(const char* name);
+
+// ----------------------------------------------------------------------
+// Virtual memory.
+// Sections are anonymous shared memory that can be mapped several times;
+// address ranges are reserved and released as on Windows.
+// Functions taking an address fail rather than map elsewhere when that
+// address is not free. Sizes are passed back to every call, since POSIX
+// needs them.
+// ----------------------------------------------------------------------
+struct PlatformSection;
+
+enum PlatformViewAccess {
+    PLATFORM_VIEW_READ,
+    PLATFORM_VIEW_WRITE,
+    PLATFORM_VIEW_COPY      // copy-on-write: writes go to private pages
+};
+
+PlatformSection* Platform_NewSection(size_t size);
+void Platform_CloseSection(PlatformSection* section);
+// Maps a view of a section at the given address, or anywhere for nullptr
+void* Platform_MapView(PlatformSection* section, size_t size, PlatformViewAccess access, void* at = nullptr);
+void Platform_UnmapView(void* view, size_t size);
+
+enum PlatformReplace {
+    PLATFORM_REPLACED,
+    PLATFORM_KEPT,          // failed; what was mapped there is still there
+    PLATFORM_COPIED,        // failed after what was there was let go of; it now holds private pages with a copy of the section
+    PLATFORM_LOST           // failed after the range was let go of; it must not be touched again
+};
+// Maps a view of a section over a range of views or reserved pages, in
+// place of them; the section must hold what the range holds. Linux swaps
+// them in one step. Windows keeps the range reserved as a placeholder
+// while it swaps them, so no other thread can take it, but for a moment
+// accesses to it fault. Without placeholders (before Windows 10 1803)
+// this always fails with PLATFORM_KEPT. Views over a range save memory,
+// not address space.
+PlatformReplace Platform_ReplaceView(PlatformSection* section, size_t size, PlatformViewAccess access, void* at);
+
+// Reserves a range at the given address, or anywhere for nullptr, with
+// readable and writable pages when committed
+void* Platform_Reserve(void* at, size_t size, bool commit);
+// Lets the OS drop the content of committed private pages, which stay
+// accessible: Linux gives them back at once and reads them as zeros,
+// Windows takes them when it needs memory and leaves their content
+// undefined (MEM_RESET; the commit charge stays). Writes keep working.
+bool Platform_Discard(void* address, size_t size);
+void Platform_Release(void* address, size_t size);
+
+#endif // OPENSEGAAPI_PLATFORM_H
@@ -0,0 +1,388 @@
+// samples.cpp - Sample memory allocation, content deduplication and ADPCM storage
+//
+// This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+
+#include "samples.h"
+#include "adpcm.h"
+#include "config.h"
+#include "hash.h"
+#include "log.h"
+#include "platform.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Content shared by several buffers; its section has no writable view left
+struct SampleBlock {
+    PlatformSection* section;
+    uint64_t hash;
+    unsigned int size;
+    unsigned int references;
+};
+
+// Where the samples of reserved memory are. Play, UpdateBuffer and the
+// other calls that need PCM move memory between states with
+// compare-and-swap, so that no lock is held while a buffer is encoded or
+// decoded.
+enum SampleState {
+    SAMPLES_PCM,            // the samples are in the pages
+    SAMPLES_ENCODING,       // being encoded; a reported change turns it back to PCM
+    SAMPLES_SWAPPING,       // pages being discarded; changes wait for COMPRESSED
+    SAMPLES_COMPRESSED,     // the pages are discarded; the samples only exist as ADPCM
+    SAMPLES_EXPANDING       // being decoded back in place; changes wait for PCM
+};
+
+struct SampleMemory {
+    uint8_t* data = nullptr;
+    unsigned int size = 0;
+    bool heap = false;
+    bool reserved = false;          // an address range of its own (Platform_Reserve)
+    bool lost = false;              // the range went away while being remapped; data no longer is ours
+    SampleBlock* block = nullptr;   // shared content this is a copy-on-write view of
+    std::atomic<bool> dirty{ true };        // changed since hashed (or expanded)
+    bool settled = false;           // played again since hashed, with no change in between
+    uint64_t hash = 0;
+    std::atomic<uint32_t> generation{ 0 };  // counts reported changes
+    std::atomic<int> state{ SAMPLES_PCM };  // SampleState
+    MixerAdpcmSource* adpcm = nullptr;      // ADPCM copy, kept for the voice until replaced or freed
+};
+
+static std::mutex g_samplesLock;
+static std::unordered_map<uint64_t, SampleBlock*> g_samplesBlocks;
+// Unshared memory by content hash, waiting for a second buffer with the same samples
+static std::unordered_map<uint64_t, SampleMemory*> g_samplesCandidates;
+
+// Totals of ADPCM storage
+static struct {
+    std::atomic<int64_t> buffers;
+    std::atomic<int64_t> pcmBytes;
+    std::atomic<int64_t> adpcmBytes;
+    std::atomic<uint64_t> encodeNs;
+    std::atomic<uint64_t> expansions;
+} g_samplesStats;
+
+static unsigned int samplesDedupBytes() {
+    static const int minBytes = ConfigGetInt("OPENSEGAAPI_DEDUP_MIN_BYTES", 0);
+    return minBytes > 0 ? static_cast<unsigned int>(minBytes) : 0;
+}
+
+static unsigned int samplesAdpcmBytes() {
+    static const int minBytes = ConfigGetInt("OPENSEGAAPI_ADPCM_MIN_BYTES", 0);
+    return minBytes > 0 ? static_cast<unsigned int>(minBytes) : 0;
+}
+
+// Drops memory from the candidates; g_samplesLock must be held
+static void samplesForget(SampleMemory* memory) {
+    auto candidate = g_samplesCandidates.find(memory->hash);
+    if (candidate != g_samplesCandidates.end() && candidate->second == memory) g_samplesCandidates.erase(candidate);
+}
+
+static void samplesRelease(SampleBlock* block) {
+    if (--block->references) return;
+    auto entry = g_samplesBlocks.find(block->hash);
+    if (entry != g_samplesBlocks.end() && entry->second == block) g_samplesBlocks.erase(entry);
+    Platform_CloseSection(block->section);
+    delete block;
+}
+
+// Whether a block holds exactly these samples
+static bool samplesSame(const SampleBlock* block, const uint8_t* data, unsigned int size) {
+    if (block->size != size) return false;
+    void* view = Platform_MapView(block->section, size, PLATFORM_VIEW_READ);
+    if (!view) return false;
+    bool same = memcmp(view, data, size) == 0;
+    Platform_UnmapView(view, size);
+    return same;
+}
+
+// Maps a copy-on-write view of the block over the memory, at the same
+// address, then lets go of what was there before. Returns false if the
+// memory stayed as it was, or was lost (see Platform_ReplaceView).
+static bool samplesRemap(SampleMemory* memory, SampleBlock* block) {
+    PlatformReplace result = Platform_ReplaceView(block->section, memory->size, PLATFORM_VIEW_COPY, memory->data);
+    if (result == PLATFORM_LOST) {
+        // The game's pointer may now lead anywhere: the buffer is dead (see Samples_Share)
+        info("Samples: lost the mapping of %p; the buffer will not play again", static_cast<void*>(memory->data));
+        memory->lost = true;
+    }
+    if (result == PLATFORM_COPIED) {
+        // Pages of its own again, with the same samples
+        if (memory->block) samplesRelease(memory->block);
+        memory->reserved = true;
+        memory->block = nullptr;
+    }
+    if (result != PLATFORM_REPLACED) return false;
+    if (memory->block) samplesRelease(memory->block);
+    memory->reserved = false;
+    memory->block = block;
+    block->references++;
+    return true;
+}
+
+// Copies the content of memory into a new block and makes memory a view of it
+static SampleBlock* samplesNewBlock(SampleMemory* memory) {
+    PlatformSection* section = Platform_NewSection(memory->size);
+    void* view = section ? Platform_MapView(section, memory->size, PLATFORM_VIEW_WRITE) : nullptr;
+    if (!view) {
+        if (section) Platform_CloseSection(section);
+        return nullptr;
+    }
+    memcpy(view, memory->data, memory->size);
+    Platform_UnmapView(view, memory->size);
+    SampleBlock* block = new SampleBlock{ section, memory->hash, memory->size, 0 };
+    if (!samplesRemap(memory, block)) {
+        Platform_CloseSection(section);
+        delete block;
+        return nullptr;
+    }
+    g_samplesBlocks[block->hash] = block;
+    return block;
+}
+
+// ======================================================================
+// ADPCM storage
+// ======================================================================
+static void samplesFreeAdpcm(MixerAdpcmSource* source) {
+    if (!source) return;
+    delete[] source->blocks;
+    delete[] source->cache[0];
+    delete[] source->cache[1];
+    delete source;
+}
+
+// Adds or removes compressed memory from the statistics
+static void samplesCount(const SampleMemory* memory, int sign) {
+    uint64_t adpcmBytes = static_cast<uint64_t>(Adpcm_BlockCount(memory->size / (2 * memory->adpcm->channels))) *
+        Adpcm_BlockBytes(memory->adpcm->channels);
+    g_samplesStats.buffers.fetch_add(sign, std::memory_order_relaxed);
+    g_samplesStats.pcmBytes.fetch_add(sign * static_cast<int64_t>(memory->size), std::memory_order_relaxed);
+    g_samplesStats.adpcmBytes.fetch_add(sign * static_cast<int64_t>(adpcmBytes), std::memory_order_relaxed);
+}
+
+// Decodes the samples back into place, except for the bytes from
+// keepBegin to keepEnd, which the game has just written; the caller moved
+// the memory to EXPANDING
+static void samplesExpand(SampleMemory* memory, size_t keepBegin, size_t keepEnd) {
+    MixerAdpcmSource* source = memory->adpcm;
+    size_t frameBytes = 2 * source->channels;
+    size_t pcmBytes = memory->size / frameBytes * frameBytes;
+    size_t blockPcmBytes = ADPCM_BLOCK_FRAMES * frameBytes;
+    unsigned int blockBytes = Adpcm_BlockBytes(source->channels);
+    int16_t pcm[ADPCM_BLOCK_FRAMES * MAX_VOICE_CHANNELS];
+    const uint8_t* decoded = reinterpret_cast<const uint8_t*>(pcm);
+    for (size_t at = 0, block = 0; at < pcmBytes; at += blockPcmBytes, block++) {
+        size_t end = std::min(at + blockPcmBytes, pcmBytes);
+        if (at >= keepBegin && end <= keepEnd) continue;
+        Adpcm_DecodeBlock(source->blocks + block * blockBytes, source->channels, pcm);
+        if (keepBegin > at) memcpy(memory->data + at, decoded, std::min(keepBegin, end) - at);
+        if (keepEnd < end) {
+            size_t from = std::max(keepEnd, at);
+            memcpy(memory->data + from, decoded + (from - at), end - from);
+        }
+    }
+    source->expanded.store(true, std::memory_order_release);
+    samplesCount(memory, -1);
+    g_samplesStats.expansions.fetch_add(1, std::memory_order_relaxed);
+    memory->dirty.store(true);
+    memory->state.store(SAMPLES_PCM, std::memory_order_release);
+}
+
+// Makes memory PCM again: stops an encoding in progress, or decodes
+// compressed samples back (see samplesExpand), or waits for another
+// thread doing so
+static void samplesTouch(SampleMemory* memory, size_t keepBegin, size_t keepEnd) {
+    for (;;) {
+        int state = memory->state.load(std::memory_order_acquire);
+        if (state == SAMPLES_PCM) return;
+        if (state == SAMPLES_ENCODING) {
+            // Samples_Compress sees the change and drops its encoding
+            if (memory->state.compare_exchange_weak(state, SAMPLES_PCM, std::memory_order_acq_rel)) return;
+        } else if (state == SAMPLES_COMPRESSED) {
+            if (memory->state.compare_exchange_weak(state, SAMPLES_EXPANDING, std::memory_order_acq_rel)) {
+                samplesExpand(memory, keepBegin, keepEnd);
+                return;
+            }
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// ======================================================================
+// Public interface
+// ======================================================================
+SampleMemory* Samples_Alloc(unsigned int size) {
+    SampleMemory* memory = new SampleMemory();
+    memory->size = size;
+    // Memory that may be shared or compressed gets pages of its own, which
+    // are later swapped for a view or given back
+    unsigned int dedupBytes = samplesDedupBytes(), adpcmBytes = samplesAdpcmBytes();
+    if ((dedupBytes && size >= dedupBytes) || (adpcmBytes && size >= adpcmBytes)) {
+        memory->data = static_cast<uint8_t*>(Platform_Reserve(nullptr, size, true));
+        if (memory->data) {
+            memory->reserved = true;
+            return memory;
+        }
+    }
+    memory->heap = true;
+    memory->data = static_cast<uint8_t*>(malloc(size));
+    if (!memory->data) {
+        delete memory;
+        return nullptr;
+    }
+    return memory;
+}
+
+void Samples_Free(SampleMemory* memory) {
+    if (!memory) return;
+    if (memory->heap) {
+        free(memory->data);
+    } else {
+        std::lock_guard<std::mutex> lock(g_samplesLock);
+        samplesForget(memory);
+        if (memory->state.load() == SAMPLES_COMPRESSED) samplesCount(memory, -1);
+        // A lost range is someone else's now, so it is left alone
+        if (!memory->lost && memory->reserved)
+            Platform_Release(memory->data, memory->size);
+        else if (!memory->lost)
+            Platform_UnmapView(memory->data, memory->size);
+        if (memory->block) samplesRelease(memory->block);
+        samplesFreeAdpcm(memory->adpcm);
+    }
+    delete memory;
+}
+
+uint8_t* Samples_Data(const SampleMemory* memory) {
+    return memory->data;
+}
+
+void Samples_Changed(SampleMemory* memory, unsigned int offset, unsigned int length) {
+    memory->dirty.store(true);
+    memory->generation.fetch_add(1, std::memory_order_release);
+    if (!memory->heap && !memory->lost) samplesTouch(memory, offset, static_cast<size_t>(offset) + length);
+}
+
+bool Samples_Share(SampleMemory* memory) {
+    if (memory->lost) return false;
+    if (memory->heap || memory->state.load() != SAMPLES_PCM) return true;
+    bool changed = memory->dirty.load();
+    uint64_t hash = changed ? Hash64(memory->data, memory->size) : memory->hash;
+    std::lock_guard<std::mutex> lock(g_samplesLock);
+    if (changed) {
+        samplesForget(memory);
+        memory->hash = hash;
+        memory->dirty.store(false);
+        memory->settled = false;
+    } else {
+        memory->settled = true;
+        if (memory->block && memory->block->hash == memory->hash) return true;
+    }
+    if (!samplesDedupBytes() || memory->size < samplesDedupBytes()) return true;
+
+    // Same samples as an existing block: become a view of it
+    auto block = g_samplesBlocks.find(memory->hash);
+    if (block != g_samplesBlocks.end()) {
+        if (block->second != memory->block && samplesSame(block->second, memory->data, memory->size)) {
+            if (samplesRemap(memory, block->second))
+                info("Samples: %u bytes shared by %u buffers", memory->size, block->second->references);
+        }
+        return !memory->lost;
+    }
+
+    // Same samples as another buffer: this one's content becomes the block,
+    // the other one joins it the next time it plays
+    auto candidate = g_samplesCandidates.find(memory->hash);
+    if (candidate != g_samplesCandidates.end() && candidate->second != memory) {
+        SampleMemory* other = candidate->second;
+        if (other->size == memory->size && memcmp(other->data, memory->data, memory->size) == 0) {
+            g_samplesCandidates.erase(candidate);
+            samplesNewBlock(memory);
+            return !memory->lost;
+        }
+    }
+    if (!memory->block) g_samplesCandidates[memory->hash] = memory;
+    return true;
+}
+
+MixerAdpcmSource* Samples_Compress(SampleMemory* memory, unsigned int channels) {
+    unsigned int minBytes = samplesAdpcmBytes();
+    if (!minBytes || memory->size < minBytes || !memory->reserved || memory->lost) return nullptr;
+    if (!channels || channels > MAX_VOICE_CHANNELS || memory->size % (2 * channels)) return nullptr;
+    if (memory->dirty.load() || !memory->settled || memory->state.load() != SAMPLES_PCM) return nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(g_samplesLock);
+        samplesForget(memory);
+    }
+
+    // Encode outside the lock; a change reported meanwhile moves the memory
+    // back to PCM (see samplesTouch)
+    uint32_t generation = memory->generation.load(std::memory_order_acquire);
+    memory->state.store(SAMPLES_ENCODING, std::memory_order_release);
+    auto start = std::chrono::steady_clock::now();
+    unsigned int frames = memory->size / (2 * channels);
+    uint8_t* blocks = new uint8_t[static_cast<size_t>(Adpcm_BlockCount(frames)) * Adpcm_BlockBytes(channels)];
+    Adpcm_Encode(reinterpret_cast<const int16_t*>(memory->data), frames, channels, blocks);
+    uint64_t encodeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    g_samplesStats.encodeNs.fetch_add(encodeNs, std::memory_order_relaxed);
+
+    // Keep the encoding only if nothing changed the samples meanwhile
+    std::lock_guard<std::mutex> lock(g_samplesLock);
+    int state = SAMPLES_ENCODING;
+    if (memory->generation.load(std::memory_order_acquire) != generation ||
+        !memory->state.compare_exchange_strong(state, SAMPLES_SWAPPING, std::memory_order_acq_rel)) {
+        samplesTouch(memory, 0, 0);
+        delete[] blocks;
+        return nullptr;
+    }
+    if (!Platform_Discard(memory->data, memory->size)) {
+        memory->state.store(SAMPLES_PCM, std::memory_order_release);
+        delete[] blocks;
+        return nullptr;
+    }
+
+    // The voice is idle, so the mixer holds no part of the previous copy
+    MixerAdpcmSource* source = memory->adpcm;
+    if (!source) {
+        source = new MixerAdpcmSource();
+        source->cache[0] = source->cache[1] = nullptr;
+    }
+    if (source->channels != channels || !source->cache[0]) {
+        delete[] source->cache[0];
+        delete[] source->cache[1];
+        source->cache[0] = new int16_t[ADPCM_BLOCK_FRAMES * channels];
+        source->cache[1] = new int16_t[ADPCM_BLOCK_FRAMES * channels];
+    }
+    delete[] source->blocks;
+    source->blocks = blocks;
+    source->channels = channels;
+    source->cachedBlock[0] = source->cachedBlock[1] = UINT32_MAX;
+    source->expanded.store(false, std::memory_order_release);
+    memory->adpcm = source;
+    samplesCount(memory, 1);
+    memory->state.store(SAMPLES_COMPRESSED, std::memory_order_release);
+    return source;
+}
+
+void Samples_Expand(SampleMemory* memory) {
+    if (!memory->heap && !memory->lost) samplesTouch(memory, 0, 0);
+}
+
+void Samples_ReadStats(OPEN_HAADPCMSTATS* stats) {
+    stats->dwBuffers = static_cast<unsigned int>(g_samplesStats.buffers.load());
+    stats->qwPcmBytes = static_cast<uint64_t>(g_samplesStats.pcmBytes.load());
+    stats->qwAdpcmBytes = static_cast<uint64_t>(g_samplesStats.adpcmBytes.load());
+    stats->qwEncodeNs = g_samplesStats.encodeNs.load();
+    stats->qwExpansions = g_samplesStats.expansions.load();
+    uint64_t blocks, nanoseconds;
+    Mixer_ReadDecodeStats(&blocks, &nanoseconds);
+    stats->qwBlocksDecoded = blocks;
+    stats->qwDecodeNs = nanoseconds;
+}
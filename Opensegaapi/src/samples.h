@@ -0,0 +1,68 @@
+#ifndef OPENSEGAAPI_SAMPLES_H
+#define OPENSEGAAPI_SAMPLES_H
+
+#include "mixer.h"
+
+#include <cstdint>
+
+// ----------------------------------------------------------------------
+// Sample memory of buffers allocated by the API.
+// With OPENSEGAAPI_DEDUP_MIN_BYTES set (off by default), blocks of that
+// size and up get pages of their own. When such a buffer is about to play
+// and its content changed since it was last seen, the content is hashed;
+// buffers holding the same samples are then remapped, at the same address,
+// as copy-on-write views of one shared section (a memfd on Linux) and
+// their own pages are released. This saves memory, not address space. A
+// game writing to a shared buffer gets private pages from the OS, so
+// sharing never shows. Linux swaps the pages in one step. Windows swaps
+// them inside a placeholder that keeps the range reserved, but a game
+// thread touching the buffer at that moment faults, which is why sharing
+// is opt-in; Windows before 10 1803 has no placeholders and never shares.
+// If the swap fails half way the buffer gets its own copy back, or in the
+// worst case is lost and never plays again. Smaller blocks (views are
+// placed at 64 KB granularity) use the heap.
+//
+// With OPENSEGAAPI_ADPCM_MIN_BYTES set, 16 bit buffers of that size and
+// up that played twice without a change are kept as IMA-ADPCM instead:
+// the mixer decodes them as it goes and the OS may drop their pages (see
+// Platform_Discard). The buffer keeps its address range, and on Windows
+// its commit charge, so only physical memory is saved. The pages stay
+// accessible, so nothing faults, but until the samples are decoded back
+// in place reading them gives zeros or stale data. They are decoded back
+// when the game reports a change (UpdateBuffer, which keeps the bytes it
+// names as the game wrote them), changes the format or creates an
+// instance. A write the game does not report is not heard while the
+// buffer is compressed, and a write made while another thread plays the
+// buffer may be dropped. ADPCM is lossy, so the game then reads back the
+// decoded samples rather than the ones it wrote.
+// ----------------------------------------------------------------------
+
+struct SampleMemory;
+
+// Allocates sample memory; returns nullptr when out of memory
+SampleMemory* Samples_Alloc(unsigned int size);
+void Samples_Free(SampleMemory* memory);
+
+// Address of the samples (fixed for the lifetime of the memory)
+uint8_t* Samples_Data(const SampleMemory* memory);
+
+// The game reported a change to length bytes at offset (UpdateBuffer)
+void Samples_Changed(SampleMemory* memory, unsigned int offset, unsigned int length);
+
+// Shares the content with other buffers holding the same samples. The
+// memory may be briefly unmapped, so nothing may read it meanwhile (the
+// voice must be idle, see Mixer_VoiceIdle). Returns false once the memory
+// was lost; its address is then no longer the buffer's to read.
+bool Samples_Share(SampleMemory* memory);
+
+// Moves the samples to ADPCM storage if they qualify and returns the copy
+// for the voice to play (see Mixer_SetAdpcm), otherwise nullptr. The voice
+// must be idle, as for Samples_Share.
+MixerAdpcmSource* Samples_Compress(SampleMemory* memory, unsigned int channels);
+// Decodes the samples back into place if they are compressed
+void Samples_Expand(SampleMemory* memory);
+
+// Totals of ADPCM storage
+void Samples_ReadStats(OPEN_HAADPCMSTATS* stats);
+
+#endif // OPENSEGAAPI_SAMPLES_H
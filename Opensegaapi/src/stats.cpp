@@ -0,0 +1,225 @@
+// stats.cpp - Per-export call counters and latency histograms
+//
+// This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+
+#include "stats.h"
+#include "config.h"
+#include "log.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+std::atomic<bool> g_statsEnabled(true);
+thread_local int StatsScope::s_depth = 0;
+
+// ======================================================================
+// Per-thread shards
+// ======================================================================
+struct StatsCounters {
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> ticks;
+    std::atomic<uint64_t> maxTicks;
+    std::atomic<uint64_t> buckets[STATS_NUM_BUCKETS];
+};
+
+// One per thread that ever called an export. Only the owning thread writes
+// it; readers sum all shards. Shards outlive their thread so no counts are
+// lost when a game tears down a worker.
+struct alignas(64) StatsShard {
+    StatsCounters counters[EXPORT_COUNT];
+};
+
+static std::mutex g_statsLock;
+static std::vector<StatsShard*> g_statsShards;
+
+static StatsShard* statsNewShard() {
+    StatsShard* shard = new StatsShard();
+    std::lock_guard<std::mutex> lock(g_statsLock);
+    g_statsShards.push_back(shard);
+    return shard;
+}
+
+// Single writer per shard: a relaxed load/store pair instead of a locked add
+static inline void statsBump(std::atomic<uint64_t>& counter, uint64_t amount) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+static inline unsigned int statsBucket(uint64_t ticks) {
+    unsigned int bucket = 0;
+    while (ticks > 1 && bucket < STATS_NUM_BUCKETS - 1) {
+        ticks >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void Stats_Record(OPEN_EXPORT op, uint64_t ticks) {
+    thread_local StatsShard* shard = statsNewShard();
+    StatsCounters& counters = shard->counters[op];
+    statsBump(counters.calls, 1);
+    statsBump(counters.ticks, ticks);
+    if (ticks > counters.maxTicks.load(std::memory_order_relaxed))
+        counters.maxTicks.store(ticks, std::memory_order_relaxed);
+    statsBump(counters.buckets[statsBucket(ticks)], 1);
+}
+
+// ======================================================================
+// TSC calibration
+// (Measured against steady_clock since the library was loaded; the TSC is
+// invariant on every CPU these cabinets run, so one ratio is enough. The
+// window grows with every read, and a read never waits for it: readers
+// are game threads.)
+// ======================================================================
+struct StatsClockPoint {
+    uint64_t tsc;
+    std::chrono::steady_clock::time_point time;
+};
+
+static StatsClockPoint statsClockNow() {
+    StatsClockPoint point;
+    point.time = std::chrono::steady_clock::now();
+    point.tsc = __rdtsc();
+    return point;
+}
+
+static const StatsClockPoint g_statsEpoch = statsClockNow();
+
+// Under a microsecond since load the clocks cannot be compared yet
+static const double STATS_MIN_WINDOW_NS = 1e3;
+
+static double statsTicksPerNs() {
+    StatsClockPoint now = statsClockNow();
+    double ns = std::chrono::duration<double, std::nano>(now.time - g_statsEpoch.time).count();
+    return ns >= STATS_MIN_WINDOW_NS ? static_cast<double>(now.tsc - g_statsEpoch.tsc) / ns : 1.0;
+}
+
+// ======================================================================
+// Reading
+// ======================================================================
+static void statsReadLocked(OPEN_EXPORT op, double ticksPerNs, StatsSnapshot* snapshot) {
+    uint64_t ticks = 0;
+    uint64_t maxTicks = 0;
+    *snapshot = StatsSnapshot();
+    for (StatsShard* shard : g_statsShards) {
+        const StatsCounters& counters = shard->counters[op];
+        snapshot->calls += counters.calls.load(std::memory_order_relaxed);
+        ticks += counters.ticks.load(std::memory_order_relaxed);
+        uint64_t shardMax = counters.maxTicks.load(std::memory_order_relaxed);
+        if (shardMax > maxTicks) maxTicks = shardMax;
+        for (unsigned int i = 0; i < STATS_NUM_BUCKETS; i++)
+            snapshot->buckets[i] += counters.buckets[i].load(std::memory_order_relaxed);
+    }
+    snapshot->totalNs = static_cast<uint64_t>(ticks / ticksPerNs);
+    snapshot->maxNs = static_cast<uint64_t>(maxTicks / ticksPerNs);
+    for (unsigned int i = 0; i < STATS_NUM_BUCKETS - 1; i++)
+        snapshot->bucketLimitNs[i] = static_cast<uint64_t>((2ull << i) / ticksPerNs);
+    snapshot->bucketLimitNs[STATS_NUM_BUCKETS - 1] = UINT64_MAX;
+}
+
+void Stats_Read(OPEN_EXPORT op, StatsSnapshot* snapshot) {
+    double ticksPerNs = statsTicksPerNs();
+    std::lock_guard<std::mutex> lock(g_statsLock);
+    statsReadLocked(op, ticksPerNs, snapshot);
+}
+
+// Calls still in flight on other threads may land just after the reset
+void Stats_Reset() {
+    std::lock_guard<std::mutex> lock(g_statsLock);
+    for (StatsShard* shard : g_statsShards) {
+        for (StatsCounters& counters : shard->counters) {
+            counters.calls.store(0, std::memory_order_relaxed);
+            counters.ticks.store(0, std::memory_order_relaxed);
+            counters.maxTicks.store(0, std::memory_order_relaxed);
+            for (std::atomic<uint64_t>& bucket : counters.buckets) bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+// ======================================================================
+// Periodic dump (OPENSEGAAPI_STATS_DUMP=<seconds>, OPENSEGAAPI_STATS_FILE=<path>)
+// ======================================================================
+static std::mutex g_statsDumpLock;
+static std::condition_variable g_statsDumpWake;
+static bool g_statsDumpStopping = false;
+static std::thread& g_statsDumpThread = *new std::thread();    // outlives static destruction, see SEGAAPI_Init
+
+// Upper bound of the bucket holding the given fraction of calls, capped at the maximum seen
+static uint64_t statsPercentileNs(const StatsSnapshot& snapshot, double fraction) {
+    uint64_t target = static_cast<uint64_t>(snapshot.calls * fraction);
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < STATS_NUM_BUCKETS; i++) {
+        seen += snapshot.buckets[i];
+        if (seen > target) return snapshot.bucketLimitNs[i] < snapshot.maxNs ? snapshot.bucketLimitNs[i] : snapshot.maxNs;
+    }
+    return snapshot.maxNs;
+}
+
+static void statsDump(const char* path) {
+    double ticksPerNs = statsTicksPerNs();
+    std::vector<std::string> lines;
+    char line[160];
+    snprintf(line, sizeof(line), "%-34s %10s %10s %10s %10s %10s", "export", "calls", "mean us", "p50 us", "p99 us", "max us");
+    lines.push_back(line);
+    {
+        std::lock_guard<std::mutex> lock(g_statsLock);
+        for (int op = 0; op < EXPORT_COUNT; op++) {
+            StatsSnapshot snapshot;
+            statsReadLocked(static_cast<OPEN_EXPORT>(op), ticksPerNs, &snapshot);
+            if (!snapshot.calls) continue;
+            snprintf(line, sizeof(line), "%-34s %10llu %10.2f %10.2f %10.2f %10.2f",
+                g_exportNames[op],
+                static_cast<unsigned long long>(snapshot.calls),
+                snapshot.totalNs / 1000.0 / snapshot.calls,
+                statsPercentileNs(snapshot, 0.50) / 1000.0,
+                statsPercentileNs(snapshot, 0.99) / 1000.0,
+                snapshot.maxNs / 1000.0);
+            lines.push_back(line);
+        }
+    }
+
+    FILE* file = path ? fopen(path, "a") : nullptr;
+    if (path && !file) return;
+    for (const std::string& text : lines) {
+        if (file) fprintf(file, "%s\n", text.c_str());
+        else info("%s", text.c_str());
+    }
+    if (file) {
+        fprintf(file, "\n");
+        fclose(file);
+    }
+}
+
+static void statsDumpMain(int seconds, const char* path) {
+    std::unique_lock<std::mutex> lock(g_statsDumpLock);
+    while (!g_statsDumpWake.wait_for(lock, std::chrono::seconds(seconds), [] { return g_statsDumpStopping; })) {
+        lock.unlock();
+        statsDump(path);
+        lock.lock();
+    }
+    lock.unlock();
+    statsDump(path);
+}
+
+void Stats_Start() {
+    g_statsEnabled.store(ConfigGetInt("OPENSEGAAPI_STATS", 1) != 0);
+    int seconds = ConfigGetInt("OPENSEGAAPI_STATS_DUMP", 0);
+    if (!g_statsEnabled.load() || seconds <= 0 || g_statsDumpThread.joinable()) return;
+
+    g_statsDumpStopping = false;
+    g_statsDumpThread = std::thread(statsDumpMain, seconds, ConfigGetString("OPENSEGAAPI_STATS_FILE"));
+}
+
+void Stats_Stop() {
+    if (!g_statsDumpThread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(g_statsDumpLock);
+        g_statsDumpStopping = true;
+    }
+    g_statsDumpWake.notify_one();
+    g_statsDumpThread.join();
+}
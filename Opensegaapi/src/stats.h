@@ -0,0 +1,59 @@
+#ifndef OPENSEGAAPI_STATS_H
+#define OPENSEGAAPI_STATS_H
+
+#include "exports.h"
+#include "platform.h"
+
+#include <atomic>
+#include <cstdint>
+
+// ----------------------------------------------------------------------
+// Per-export call counters and latency histograms.
+// Calls are timed with the TSC and counted into a shard owned by the
+// calling thread, so recording never takes a lock or shares a cache line
+// with another thread. Shards are summed and ticks converted to
+// nanoseconds only when somebody reads the stats (SEGAAPI_GetStats or
+// the periodic dump enabled with OPENSEGAAPI_STATS_DUMP=<seconds>).
+// On by default; OPENSEGAAPI_STATS=0 turns recording off.
+// ----------------------------------------------------------------------
+
+// Bucket i counts calls that took [2^i, 2^(i+1)) ticks; the last one is open ended
+#define STATS_NUM_BUCKETS 32
+
+struct StatsSnapshot {
+    uint64_t calls;
+    uint64_t totalNs;
+    uint64_t maxNs;
+    uint64_t buckets[STATS_NUM_BUCKETS];
+    uint64_t bucketLimitNs[STATS_NUM_BUCKETS];
+};
+
+extern std::atomic<bool> g_statsEnabled;
+
+void Stats_Start();
+void Stats_Stop();
+
+void Stats_Record(OPEN_EXPORT op, uint64_t ticks);
+void Stats_Read(OPEN_EXPORT op, StatsSnapshot* snapshot);
+void Stats_Reset();
+
+// Times the outermost export on this thread; nested exports are not counted
+class StatsScope {
+public:
+    explicit StatsScope(OPEN_EXPORT op) : m_op(op), m_start(0), m_active(g_statsEnabled.load(std::memory_order_relaxed)) {
+        if (m_active && s_depth++ == 0) m_start = __rdtsc();
+    }
+    ~StatsScope() {
+        if (m_active && --s_depth == 0) Stats_Record(m_op, __rdtsc() - m_start);
+    }
+
+private:
+    OPEN_EXPORT m_op;
+    uint64_t m_start;
+    bool m_active;
+    static thread_local int s_depth;
+};
+
+#define STATS_SCOPE(op) StatsScope statsScope_(EXPORT_##op)
+
+#endif // OPENSEGAAPI_STATS_H
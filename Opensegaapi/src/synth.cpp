@@ -0,0 +1,302 @@
+// synth.cpp - Synth buffers on the bundled TinySoundFont engine
+//
+// This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+
+#include "synth.h"
+#include "config.h"
+#include "mixer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#define TSF_IMPLEMENTATION
+#include "tsf.h"
+
+// ======================================================================
+// Parameters
+// (SoundFont generator each OPEN_HAVP_* parameter sets in the region;
+// attenuation and pitch go through the channel instead, see Synth_SetMix.)
+// ======================================================================
+static const unsigned int SYNTH_PARAMS = OPEN_HAVP_MOD_ENV_TO_FILTER_CUTOFF + 1;
+static const unsigned short SYNTH_NO_GENERATOR = 0xFFFF;
+static const int SYNTH_KEY = 60;    // every note plays at the region's root key
+static const int SYNTH_DEFAULT_VOICES = 256;
+static const int SYNTH_DEFAULT_CHANNELS = 256;
+
+static const unsigned short g_synthGenerators[SYNTH_PARAMS] = {
+    SYNTH_NO_GENERATOR,     // OPEN_HAVP_ATTENUATION
+    SYNTH_NO_GENERATOR,     // OPEN_HAVP_PITCH
+    8,                      // OPEN_HAVP_FILTER_CUTOFF: initialFilterFc
+    9,                      // OPEN_HAVP_FILTER_Q: initialFilterQ
+    33, 34, 35, 36, 37, 38, // OPEN_HAVP_*_VOL_ENV: delay, attack, hold, decay, sustain, release
+    25, 26, 27, 28, 29, 30, // OPEN_HAVP_*_MOD_ENV: delay, attack, hold, decay, sustain, release
+    21, 22,                 // OPEN_HAVP_DELAY_MOD_LFO, OPEN_HAVP_FREQ_MOD_LFO
+    23, 24,                 // OPEN_HAVP_DELAY_VIB_LFO, OPEN_HAVP_FREQ_VIB_LFO
+    5,                      // OPEN_HAVP_MOD_LFO_TO_PITCH
+    6,                      // OPEN_HAVP_VIB_LFO_TO_PITCH
+    10,                     // OPEN_HAVP_MOD_LFO_TO_FILTER_CUTOFF
+    13,                     // OPEN_HAVP_MOD_LFO_TO_ATTENUATION
+    7,                      // OPEN_HAVP_MOD_ENV_TO_PITCH
+    11                      // OPEN_HAVP_MOD_ENV_TO_FILTER_CUTOFF
+};
+
+// ======================================================================
+// State
+// ======================================================================
+struct SynthSamples {
+    std::vector<int16_t> samples;   // mono, followed by one silent sample
+    unsigned int frames;
+    SynthSamples* retireNext;
+};
+
+struct SynthChannel {
+    int index;                      // tsf channel, and preset of the same number
+    SynthSamples* samples;
+    int params[SYNTH_PARAMS];
+    uint32_t paramsSet;             // one bit per parameter set since the last reset
+    float rate;                     // from Synth_SetMix
+    unsigned int noteRate;          // sample rate the preset was last set up with
+    SynthChannel* retireNext;
+};
+
+// Created on a game thread by the first synth voice, with every voice,
+// channel and preset it can use, so the render thread never allocates
+static std::atomic<tsf*> g_synth(nullptr);
+
+// Game threads
+static std::mutex g_synthLock;
+static unsigned int g_synthRate = 48000;        // g_synthLock
+static std::vector<int> g_synthFreeChannels;    // g_synthLock
+
+// Copies and channels the render thread let go of, freed by game threads
+static std::atomic<SynthSamples*> g_synthRetired(nullptr);
+static std::atomic<SynthChannel*> g_synthRetiredChannels(nullptr);
+
+// The engine, for the render thread; it exists once a channel does
+static tsf* synthEngine() {
+    return g_synth.load(std::memory_order_acquire);
+}
+
+// g_synthLock must be held
+static tsf* synthCreate() {
+    tsf* f = tsf_create();
+    if (!f) return nullptr;
+    int channels = std::max(ConfigGetInt("OPENSEGAAPI_SYNTH_CHANNELS", SYNTH_DEFAULT_CHANNELS), 1);
+    if (!tsf_set_max_voices(f, ConfigGetInt("OPENSEGAAPI_SYNTH_VOICES", SYNTH_DEFAULT_VOICES)) ||
+        !tsf_reserve_sample_channels(f, channels)) {
+        tsf_close(f);
+        return nullptr;
+    }
+    tsf_set_output(f, TSF_STEREO_INTERLEAVED, static_cast<int>(g_synthRate), 0.0f);
+    // The fastest kernel the CPU has unless pinned, e.g. for A/B listening
+    const char* kernel = ConfigGetString("OPENSEGAAPI_SYNTH_KERNEL");
+    if (kernel) {
+        tsf_set_render_kernel(f, strcmp(kernel, "scalar") == 0 ? TSF_KERNEL_SCALAR :
+            strcmp(kernel, "sse2") == 0 ? TSF_KERNEL_SSE2 : TSF_KERNEL_AVX2);
+    }
+    // Handed out from the back, lowest first
+    g_synthFreeChannels.reserve(channels);
+    for (int index = channels - 1; index >= 0; index--) g_synthFreeChannels.push_back(index);
+    g_synth.store(f, std::memory_order_release);
+    return f;
+}
+
+// Takes back the channels the render thread let go of; g_synthLock must be held
+static void synthRecycleChannels() {
+    SynthChannel* channel = g_synthRetiredChannels.exchange(nullptr, std::memory_order_acquire);
+    while (channel) {
+        SynthChannel* next = channel->retireNext;
+        g_synthFreeChannels.push_back(channel->index);
+        delete channel;
+        channel = next;
+    }
+}
+
+static void synthRetire(SynthSamples* samples) {
+    if (!samples) return;
+    SynthSamples* top = g_synthRetired.load(std::memory_order_relaxed);
+    do {
+        samples->retireNext = top;
+    } while (!g_synthRetired.compare_exchange_weak(top, samples, std::memory_order_release, std::memory_order_relaxed));
+}
+
+// Channel tuning (semitones) that plays the preset at the channel's rate
+static float synthTuning(const SynthChannel* channel) {
+    if (!channel->noteRate || channel->rate <= 0.0f) return 0.0f;
+    return 12.0f * std::log2(channel->rate / channel->noteRate);
+}
+
+// ======================================================================
+// Sample copies
+// ======================================================================
+SynthSamples* Synth_NewSamples(const uint8_t* data, unsigned int size, unsigned int sampleFormat, unsigned int channels) {
+    Synth_FreeRetired();
+    unsigned int frameBytes = Mixer_FrameBytes(sampleFormat, channels);
+    unsigned int frames = frameBytes && data ? size / frameBytes : 0;
+    SynthSamples* copy = new (std::nothrow) SynthSamples();
+    if (!copy) return nullptr;
+    try {
+        copy->samples.assign(static_cast<size_t>(frames) + 1, 0);
+    } catch (const std::bad_alloc&) {
+        delete copy;
+        return nullptr;
+    }
+    copy->frames = frames;
+    copy->retireNext = nullptr;
+
+    // Channels are mixed down to mono, with the same scaling as the PCM mixer
+    for (unsigned int i = 0; i < frames; i++) {
+        int sum = 0;
+        if (sampleFormat == OPEN_HASF_UNSIGNED_8PCM) {
+            const uint8_t* frame = data + static_cast<size_t>(i) * frameBytes;
+            for (unsigned int c = 0; c < channels; c++) sum += (static_cast<int>(frame[c]) - 128) * 256;
+        } else {
+            const int16_t* frame = reinterpret_cast<const int16_t*>(data + static_cast<size_t>(i) * frameBytes);
+            for (unsigned int c = 0; c < channels; c++) sum += frame[c];
+        }
+        copy->samples[i] = static_cast<int16_t>(sum / static_cast<int>(channels));
+    }
+    return copy;
+}
+
+void Synth_FreeRetired() {
+    SynthSamples* samples = g_synthRetired.exchange(nullptr, std::memory_order_acquire);
+    while (samples) {
+        SynthSamples* next = samples->retireNext;
+        delete samples;
+        samples = next;
+    }
+    if (g_synthRetiredChannels.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(g_synthLock);
+        synthRecycleChannels();
+    }
+}
+
+// ======================================================================
+// Channels
+// ======================================================================
+void Synth_SetOutput(unsigned int sampleRate) {
+    std::lock_guard<std::mutex> lock(g_synthLock);
+    g_synthRate = sampleRate;
+    tsf* f = g_synth.load(std::memory_order_relaxed);
+    if (f) tsf_set_output(f, TSF_STEREO_INTERLEAVED, static_cast<int>(sampleRate), 0.0f);
+}
+
+SynthChannel* Synth_NewChannel() {
+    std::lock_guard<std::mutex> lock(g_synthLock);
+    synthRecycleChannels();
+    if (!g_synth.load(std::memory_order_relaxed) && !synthCreate()) return nullptr;
+    if (g_synthFreeChannels.empty()) return nullptr;
+    SynthChannel* channel = new (std::nothrow) SynthChannel();
+    if (!channel) return nullptr;
+    channel->index = g_synthFreeChannels.back();
+    g_synthFreeChannels.pop_back();
+    channel->samples = nullptr;
+    channel->paramsSet = 0;
+    channel->rate = 0.0f;
+    channel->noteRate = 0;
+    channel->retireNext = nullptr;
+    return channel;
+}
+
+void Synth_OpenChannel(SynthChannel* channel) {
+    tsf* f = synthEngine();
+    tsf_channel_set_presetindex(f, channel->index, channel->index);
+    tsf_channel_set_volume(f, channel->index, 1.0f);
+    tsf_channel_set_pan(f, channel->index, 0.5f);
+    tsf_channel_set_tuning(f, channel->index, 0.0f);
+}
+
+void Synth_FreeChannel(SynthChannel* channel) {
+    if (!channel) return;
+    tsf_channel_kill_all(synthEngine(), channel->index);
+    synthRetire(channel->samples);
+    channel->samples = nullptr;
+    SynthChannel* top = g_synthRetiredChannels.load(std::memory_order_relaxed);
+    do {
+        channel->retireNext = top;
+    } while (!g_synthRetiredChannels.compare_exchange_weak(top, channel, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void Synth_SetSamples(SynthChannel* channel, SynthSamples* samples) {
+    if (!channel) {
+        synthRetire(samples);
+        return;
+    }
+    tsf_channel_kill_all(synthEngine(), channel->index);
+    synthRetire(channel->samples);
+    channel->samples = samples;
+}
+
+void Synth_SetParam(SynthChannel* channel, unsigned int param, int value) {
+    if (param >= SYNTH_PARAMS || g_synthGenerators[param] == SYNTH_NO_GENERATOR) return;
+    channel->params[param] = std::clamp(value, -32768, 32767);
+    channel->paramsSet |= 1u << param;
+}
+
+void Synth_Reset(SynthChannel* channel) {
+    Synth_Cut(channel);
+    channel->paramsSet = 0;
+}
+
+// A mono note panned with tsf's sqrt pan law reaches exactly the given
+// gains with volume sqrt(l^2 + r^2) and pan r^2 / (l^2 + r^2)
+void Synth_SetMix(SynthChannel* channel, float left, float right, float rate) {
+    tsf* f = synthEngine();
+    float power = left * left + right * right;
+    tsf_channel_set_volume(f, channel->index, std::sqrt(power));
+    tsf_channel_set_pan(f, channel->index, power > 0.0f ? right * right / power : 0.5f);
+    channel->rate = rate;
+    tsf_channel_set_tuning(f, channel->index, synthTuning(channel));
+}
+
+// ======================================================================
+// Notes (render thread)
+// ======================================================================
+void Synth_NoteOn(SynthChannel* channel, unsigned int sampleRate, unsigned int endFrame, unsigned int loopStart, unsigned int loopEnd) {
+    tsf* f = synthEngine();
+    tsf_channel_sounds_off_all(f, channel->index);
+    SynthSamples* samples = channel->samples;
+    if (!samples || !sampleRate) return;
+    unsigned int frames = std::min(endFrame, samples->frames);
+    if (!frames) return;
+    loopEnd = std::min(loopEnd, frames);
+
+    unsigned short generators[SYNTH_PARAMS];
+    short amounts[SYNTH_PARAMS];
+    int count = 0;
+    for (unsigned int param = 0; param < SYNTH_PARAMS; param++) {
+        if (!(channel->paramsSet & (1u << param))) continue;
+        generators[count] = g_synthGenerators[param];
+        amounts[count] = static_cast<short>(channel->params[param]);
+        count++;
+    }
+    // The region's last loop sample is inclusive; the preset was reserved with the channel
+    if (!tsf_set_sample_preset(f, channel->index, samples->samples.data(), frames, sampleRate,
+        loopStart, loopEnd ? loopEnd - 1 : 0, generators, amounts, count)) return;
+    channel->noteRate = sampleRate;
+    tsf_channel_set_tuning(f, channel->index, synthTuning(channel));
+    tsf_channel_note_on(f, channel->index, SYNTH_KEY, 1.0f);
+}
+
+void Synth_NoteOff(SynthChannel* channel) {
+    tsf_channel_note_off_all(synthEngine(), channel->index);
+}
+
+void Synth_Cut(SynthChannel* channel) {
+    tsf_channel_sounds_off_all(synthEngine(), channel->index);
+}
+
+bool Synth_Sounding(SynthChannel* channel) {
+    return tsf_channel_get_voicecount(synthEngine(), channel->index) > 0;
+}
+
+void Synth_Render(float* bus, unsigned int frames) {
+    tsf* f = synthEngine();
+    if (f) tsf_render_float(f, bus, static_cast<int>(frames), 1);
+}
@@ -0,0 +1,76 @@
+#ifndef OPENSEGAAPI_SYNTH_H
+#define OPENSEGAAPI_SYNTH_H
+
+#include <cstdint>
+
+// ----------------------------------------------------------------------
+// Synth buffers (OPEN_HABUF_SYNTH_BUFFER).
+// Their voices are played by the bundled TinySoundFont engine (tsf.h)
+// rather than the PCM resampler. There is one tsf instance, in which each
+// synth voice has a channel and a preset of its own. The preset is one
+// region over a mono 16-bit copy of the buffer's samples, and the
+// OPEN_HAVP_* parameters other than attenuation and pitch are its
+// SoundFont generators, in the same units. Envelopes, the filter and the
+// LFOs then behave as in a SoundFont instrument.
+//
+// Attenuation, pitch, sample rate and routing set the channel volume,
+// pan and tuning, so they reach sounding notes at once. The other
+// parameters apply from the next note. Stop and Pause end the note with
+// a short fade, and SEGAAPI_SetReleaseState starts its release.
+//
+// The engine is created by the first synth voice, on a game thread, with
+// its voice pool and OPENSEGAAPI_SYNTH_CHANNELS channels and presets, so
+// the render thread never allocates for it. Channels and sample copies
+// are made and freed on game threads too; the mixer gets them by command.
+// Everything else runs on the render thread, or in an offline drain, like
+// the rest of the voice state. The engine renders each span of a period
+// straight into the mix bus.
+// ----------------------------------------------------------------------
+
+struct SynthSamples;
+struct SynthChannel;
+
+// Converts sample data for the engine (any thread); nullptr when out of memory
+SynthSamples* Synth_NewSamples(const uint8_t* data, unsigned int size, unsigned int sampleFormat, unsigned int channels);
+// Frees copies and channels the render thread no longer uses
+void Synth_FreeRetired();
+
+// Output rate of the engine (game thread, with the mixer stopped)
+void Synth_SetOutput(unsigned int sampleRate);
+
+// A channel for one voice (any thread), creating the engine first if
+// needed; nullptr when out of memory or channels (see Mixer_CreateVoice)
+SynthChannel* Synth_NewChannel();
+
+// Render thread from here on
+// Sets up the engine's channel for a voice that just got it
+void Synth_OpenChannel(SynthChannel* channel);
+// Ends the channel's notes at once and gives back the channel and its samples
+void Synth_FreeChannel(SynthChannel* channel);
+
+// Replaces the samples, ending notes that still read the old ones (a
+// voice without a channel, for want of memory, just gives them back)
+void Synth_SetSamples(SynthChannel* channel, SynthSamples* samples);
+// Stores an OPEN_HAVP_* parameter for the next note
+void Synth_SetParam(SynthChannel* channel, unsigned int param, int value);
+// Fades out the notes and forgets the parameters (SEGAAPI_Reset)
+void Synth_Reset(SynthChannel* channel);
+
+// Left/right gains of the voice, and the rate the samples should play at
+// (sample rate times pitch); applies to sounding notes too
+void Synth_SetMix(SynthChannel* channel, float left, float right, float rate);
+
+// Starts a note over the samples, fading out the ones still sounding.
+// Offsets are in frames; the loop is used when loopEnd > loopStart.
+void Synth_NoteOn(SynthChannel* channel, unsigned int sampleRate, unsigned int endFrame, unsigned int loopStart, unsigned int loopEnd);
+// Starts the release of the sounding notes
+void Synth_NoteOff(SynthChannel* channel);
+// Ends the sounding notes with a short fade
+void Synth_Cut(SynthChannel* channel);
+// Whether a note of the channel is still sounding, release included
+bool Synth_Sounding(SynthChannel* channel);
+
+// Mixes all sounding notes into a stereo bus
+void Synth_Render(float* bus, unsigned int frames);
+
+#endif // OPENSEGAAPI_SYNTH_H
@@ -0,0 +1,240 @@
+// trace.cpp - SEGAAPI call trace recorder
+//
+// This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+
+#include "trace.h"
+#include "tracefmt.h"
+#include "config.h"
+#include "hash.h"
+#include "log.h"
+
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+std::atomic<bool> g_traceEnabled(false);
+thread_local int TraceScope::s_depth = 0;
+
+// ======================================================================
+// Recorder state
+// ======================================================================
+// Raw record as appended by the calling thread; encoded later by the writer
+struct TracePendingHeader {
+    uint16_t op;
+    uint8_t argc;
+    uint8_t reserved;
+    uint32_t thread;
+    uint64_t timeNs;
+    uint32_t blobSize;
+};
+
+// Wake the writer early once this much is pending
+static const size_t TRACE_FLUSH_BYTES = 4 * 1024 * 1024;
+
+static std::mutex g_traceLock;
+static std::condition_variable g_traceWake;
+static std::vector<uint8_t> g_tracePending;
+static bool g_traceStopping = false;
+static std::thread& g_traceWriter = *new std::thread();     // not destroyed at exit (SEGAAPI_Init)
+static FILE* g_traceFile = nullptr;
+static std::chrono::steady_clock::time_point g_traceEpoch;
+static std::atomic<uint32_t> g_traceNextHandle(1);
+static std::atomic<uint32_t> g_traceNextThread(0);
+
+static uint32_t traceThreadIndex() {
+    thread_local uint32_t index = g_traceNextThread.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+// ======================================================================
+// Writer thread: encodes pending records, deduplicates blobs, writes file
+// ======================================================================
+// A blob already in the stream, and where its data is
+struct TraceBlob {
+    uint32_t id;
+    uint64_t offset;
+};
+
+struct TraceEncoder {
+    FILE* file = nullptr;
+    uint64_t flushed = 0;           // stream bytes written to the file before out
+    std::vector<uint8_t> out;
+    std::unordered_multimap<uint64_t, TraceBlob> blobs;     // by hash and size
+    std::vector<uint8_t> readBack;
+    uint32_t nextBlobId = 1;
+    uint64_t lastTimeNs = 0;
+    uint64_t records = 0;
+    uint64_t blobBytesIn = 0;
+    uint64_t blobBytesOut = 0;
+
+    void varint(uint64_t value) {
+        uint8_t tmp[10];
+        size_t n = TraceWriteVarint(tmp, value);
+        out.insert(out.end(), tmp, tmp + n);
+    }
+
+    void flush() {
+        fwrite(out.data(), 1, out.size(), file);
+        fflush(file);
+        flushed += out.size();
+        out.clear();
+    }
+
+    // Whether the data of a blob in the stream matches; the key only says it may
+    bool same(const TraceBlob& blob, const uint8_t* data, uint32_t size) {
+        if (blob.offset >= flushed) return memcmp(&out[blob.offset - flushed], data, size) == 0;
+        if (blob.offset > static_cast<uint64_t>(LONG_MAX)) return false;
+        readBack.resize(size);
+        bool read = fseek(file, static_cast<long>(blob.offset), SEEK_SET) == 0 && fread(readBack.data(), 1, size, file) == size;
+        fseek(file, 0, SEEK_END);
+        return read && memcmp(readBack.data(), data, size) == 0;
+    }
+
+    uint32_t blob(const uint8_t* data, uint32_t size) {
+        // Length is folded into the key so equal-hash blobs of different size never alias
+        uint64_t key = Hash64(data, size) ^ (static_cast<uint64_t>(size) * 0x9E3779B97F4A7C15ull);
+        blobBytesIn += size;
+        auto range = blobs.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it)
+            if (same(it->second, data, size)) return it->second.id;
+
+        uint32_t id = nextBlobId++;
+        out.push_back(TRACE_TAG_BLOB);
+        varint(id);
+        varint(size);
+        blobs.emplace(key, TraceBlob{ id, flushed + out.size() });
+        out.insert(out.end(), data, data + size);
+        blobBytesOut += size;
+        return id;
+    }
+
+    void encode(const std::vector<uint8_t>& pending) {
+        size_t at = 0;
+        while (at + sizeof(TracePendingHeader) <= pending.size()) {
+            TracePendingHeader header;
+            memcpy(&header, &pending[at], sizeof(header));
+            at += sizeof(header);
+            const uint8_t* args = &pending[at];
+            at += header.argc * sizeof(int64_t);
+            const uint8_t* blobData = &pending[at];
+            at += header.blobSize;
+
+            uint32_t blobRef = header.blobSize ? blob(blobData, header.blobSize) : 0;
+
+            out.push_back(static_cast<uint8_t>(header.op));
+            varint(header.timeNs >= lastTimeNs ? header.timeNs - lastTimeNs : 0);
+            lastTimeNs = header.timeNs > lastTimeNs ? header.timeNs : lastTimeNs;
+            varint(header.thread);
+            varint(header.argc);
+            for (unsigned int i = 0; i < header.argc; i++) {
+                int64_t arg;
+                memcpy(&arg, args + i * sizeof(int64_t), sizeof(arg));
+                varint(TraceZigzag(arg));
+            }
+            varint(blobRef);
+            records++;
+        }
+    }
+};
+
+static void traceWriterMain() {
+    TraceEncoder encoder;
+    encoder.file = g_traceFile;
+    encoder.flushed = static_cast<uint64_t>(ftell(g_traceFile));
+    std::vector<uint8_t> work;
+    std::unique_lock<std::mutex> lock(g_traceLock);
+    for (;;) {
+        g_traceWake.wait_for(lock, std::chrono::milliseconds(50), [] {
+            return g_traceStopping || g_tracePending.size() >= TRACE_FLUSH_BYTES;
+        });
+        work.swap(g_tracePending);
+        bool stopping = g_traceStopping;
+        lock.unlock();
+
+        if (!work.empty()) {
+            encoder.encode(work);
+            encoder.flush();
+            work.clear();
+        }
+
+        lock.lock();
+        if (stopping && g_tracePending.empty()) break;
+    }
+    info("Trace: %llu calls, %llu sample bytes seen, %llu written after dedup",
+        static_cast<unsigned long long>(encoder.records),
+        static_cast<unsigned long long>(encoder.blobBytesIn),
+        static_cast<unsigned long long>(encoder.blobBytesOut));
+}
+
+// ======================================================================
+// Public interface
+// ======================================================================
+void Trace_Start() {
+    if (g_traceEnabled.load()) return;
+    const char* path = ConfigGetString("OPENSEGAAPI_TRACE");
+    if (!path) return;
+
+    // Read too: blobs are compared with their first copy before reuse
+    g_traceFile = fopen(path, "w+b");
+    if (!g_traceFile) {
+        info("Trace: could not open %s", path);
+        return;
+    }
+    uint32_t header[2] = { TRACE_VERSION, 0 };
+    fwrite(TRACE_MAGIC, 1, 8, g_traceFile);
+    fwrite(header, sizeof(header), 1, g_traceFile);
+
+    g_traceEpoch = std::chrono::steady_clock::now();
+    g_traceStopping = false;
+    g_traceWriter = std::thread(traceWriterMain);
+    g_traceEnabled.store(true);
+    info("Trace: recording to %s", path);
+}
+
+void Trace_Stop() {
+    if (!g_traceEnabled.exchange(false)) return;
+    {
+        std::lock_guard<std::mutex> lock(g_traceLock);
+        g_traceStopping = true;
+    }
+    g_traceWake.notify_one();
+    g_traceWriter.join();
+    fclose(g_traceFile);
+    g_traceFile = nullptr;
+}
+
+uint32_t Trace_NewHandle() {
+    return g_traceNextHandle.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Trace_Call(OPEN_EXPORT op, const void* blob, size_t blobSize, std::initializer_list<int64_t> args) {
+    TracePendingHeader header;
+    header.op = static_cast<uint16_t>(op);
+    header.argc = static_cast<uint8_t>(args.size() < TRACE_MAX_ARGS ? args.size() : TRACE_MAX_ARGS);
+    header.reserved = 0;
+    header.thread = traceThreadIndex();
+    header.blobSize = blob ? static_cast<uint32_t>(blobSize) : 0;
+
+    std::unique_lock<std::mutex> lock(g_traceLock);
+    if (g_traceStopping) return;
+    // Stamped under the lock so records are in time order in the file
+    header.timeNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - g_traceEpoch).count());
+
+    const uint8_t* headerBytes = reinterpret_cast<const uint8_t*>(&header);
+    const uint8_t* argBytes = reinterpret_cast<const uint8_t*>(args.begin());
+    const uint8_t* blobBytes = static_cast<const uint8_t*>(blob);
+    g_tracePending.insert(g_tracePending.end(), headerBytes, headerBytes + sizeof(header));
+    g_tracePending.insert(g_tracePending.end(), argBytes, argBytes + header.argc * sizeof(int64_t));
+    if (header.blobSize) g_tracePending.insert(g_tracePending.end(), blobBytes, blobBytes + header.blobSize);
+    bool wake = g_tracePending.size() >= TRACE_FLUSH_BYTES;
+    lock.unlock();
+
+    if (wake) g_traceWake.notify_one();
+}
@@ -0,0 +1,56 @@
+#ifndef OPENSEGAAPI_TRACE_H
+#define OPENSEGAAPI_TRACE_H
+
+#include "exports.h"
+#include "stats.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+// ----------------------------------------------------------------------
+// Opt-in API call recorder.
+// Set OPENSEGAAPI_TRACE=<file> and every SEGAAPI_* call made after
+// SEGAAPI_Init is logged with its arguments, a timestamp and any sample
+// data it touches. Encoding, deduplication and file IO happen on a
+// background thread; the calling thread only appends to a memory buffer.
+// Play the file back with OpensegaapiReplay.
+// ----------------------------------------------------------------------
+
+extern std::atomic<bool> g_traceEnabled;
+
+void Trace_Start();
+void Trace_Stop();
+
+// Allocates the id a buffer handle is known by in the trace
+uint32_t Trace_NewHandle();
+
+void Trace_Call(OPEN_EXPORT op, const void* blob, size_t blobSize, std::initializer_list<int64_t> args);
+
+// Marks an export as in progress so that exports called internally
+// (PlayWithSetup -> SetSendRouting etc.) are not recorded twice.
+class TraceScope {
+public:
+    TraceScope() : m_active(g_traceEnabled.load(std::memory_order_relaxed)), m_outermost(false) {
+        if (m_active) m_outermost = (s_depth++ == 0);
+    }
+    ~TraceScope() {
+        if (m_active) s_depth--;
+    }
+    bool outermost() const { return m_outermost; }
+
+private:
+    bool m_active;
+    bool m_outermost;
+    static thread_local int s_depth;
+};
+
+// Every export opens exactly one scope, which also times it for the stats
+#define TRACE_SCOPE(op) STATS_SCOPE(op); TraceScope traceScope_
+#define TRACE_RECORD(op, blob, blobSize, ...) \
+    do { if (traceScope_.outermost()) Trace_Call(EXPORT_##op, blob, blobSize, { __VA_ARGS__ }); } while (0)
+#define TRACE_CALL(op, ...) TRACE_SCOPE(op); TRACE_RECORD(op, nullptr, 0, __VA_ARGS__)
+#define TRACE_CALL_BLOB(op, blob, blobSize, ...) TRACE_SCOPE(op); TRACE_RECORD(op, blob, blobSize, __VA_ARGS__)
+
+#endif // OPENSEGAAPI_TRACE_H
@@ -0,0 +1,55 @@
+#ifndef OPENSEGAAPI_TRACEFMT_H
+#define OPENSEGAAPI_TRACEFMT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ----------------------------------------------------------------------
+// On-disk format of SEGAAPI call traces (shared by the recorder and
+// OpensegaapiReplay).
+//
+//   header:  "OSAPITRC" | u32 version | u32 reserved
+//   call:    u8 opcode (OPEN_EXPORT) | v dtNs | v thread | v argc
+//            | argc x zigzag(v) | v blobRef (0 = none)
+//   blob:    u8 TRACE_TAG_BLOB | v id | v size | size bytes
+//
+// "v" is an unsigned LEB128 varint. Blobs hold sample data and parameter
+// arrays; each distinct blob is written once and referenced by id after.
+// ----------------------------------------------------------------------
+#define TRACE_MAGIC "OSAPITRC"
+#define TRACE_VERSION 1
+#define TRACE_TAG_BLOB 0xFE
+#define TRACE_MAX_ARGS 16
+
+static inline size_t TraceWriteVarint(uint8_t* out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = static_cast<uint8_t>(value);
+    return n;
+}
+
+// Returns the number of bytes consumed, or 0 if the input is truncated
+static inline size_t TraceReadVarint(const uint8_t* in, size_t avail, uint64_t* value) {
+    uint64_t result = 0;
+    for (size_t n = 0; n < avail && n < 10; n++) {
+        result |= static_cast<uint64_t>(in[n] & 0x7F) << (7 * n);
+        if (!(in[n] & 0x80)) {
+            *value = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+static inline uint64_t TraceZigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static inline int64_t TraceUnzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+#endif // OPENSEGAAPI_TRACEFMT_H
@@ -10,6 +10,8 @@ before you include this file in *one* C or C++ file to create the implementation
 #include "tsf.h"
 
 [OPTIONAL] #define TSF_NO_STDIO to remove stdio dependency
+[OPTIONAL] #define TSF_NO_MMAP to read SoundFont files instead of memory-mapping them
+[OPTIONAL] #define TSF_NO_SIMD to build only the scalar render kernel
 [OPTIONAL] #define TSF_MALLOC, TSF_REALLOC, and TSF_FREE to avoid stdlib.h
 [OPTIONAL] #define TSF_MEMCPY, TSF_MEMSET to avoid string.h
 [OPTIONAL] #define TSF_POW, TSF_POWF, TSF_EXPF, TSF_LOG, TSF_TAN, TSF_LOG10, TSF_SQRT to avoid math.h
@@ -67,6 +69,8 @@ typedef struct tsf tsf;
 
 #ifndef TSF_NO_STDIO
 // Directly load a SoundFont from a .sf2 file path
+// The file is memory-mapped where the OS allows, and the sample data is played from the
+// mapping, so it is only paged in when used and shared by processes using the same file.
 TSFDEF tsf* tsf_load_filename(const char* filename);
 #endif
 
@@ -89,6 +93,9 @@ struct tsf_stream
 // Generic SoundFont loading method using the stream structure above
 TSFDEF tsf* tsf_load(struct tsf_stream* stream);
 
+// Create an instance without a SoundFont, for presets set up with tsf_set_sample_preset
+TSFDEF tsf* tsf_create(void);
+
 // Free the memory related to this tsf instance
 TSFDEF void tsf_close(tsf* f);
 
@@ -101,6 +108,22 @@ TSFDEF int tsf_get_presetindex(const tsf* f, int bank, int preset_number);
 // Returns the number of presets in the loaded SoundFont
 TSFDEF int tsf_get_presetcount(const tsf* f);
 
+// Set up a preset as a single region playing mono samples owned by the caller,
+// creating it (and any missing preset before it) if needed. Voices still playing
+// the preset keep reading the region, so stop them first when the samples change.
+//   samples: sample_count signed 16-bit samples, followed by at least one more (read when interpolating the last)
+//   loop_start, loop_end: first and last sample of the loop (no loop unless loop_end > loop_start)
+//   generators, amounts: SoundFont generators applied like in an instrument zone (units as in the file)
+//   (returns 0 if out of memory, otherwise 1)
+TSFDEF int tsf_set_sample_preset(tsf* f, int preset_index, const short* samples, unsigned int sample_count, unsigned int sample_rate,
+	unsigned int loop_start, unsigned int loop_end, const unsigned short* generators, const short* amounts, int generator_count);
+
+// Allocate channels and sample presets 0 to count-1 up front, so that the
+// tsf_channel_* calls on them and tsf_set_sample_preset for them do not allocate
+// (or grow the preset lookup of a loaded SoundFont)
+//   (returns 0 if out of memory, otherwise 1)
+TSFDEF int tsf_reserve_sample_channels(tsf* f, int count);
+
 // Returns the name of a preset index >= 0 and < tsf_get_presetcount()
 TSFDEF const char* tsf_get_presetname(const tsf* f, int preset_index);
 
@@ -128,8 +151,31 @@ enum TSFOutputMode
 //   outputmode: if mono or stereo and how stereo channel data is ordered
 //   samplerate: the number of samples per second (output frequency)
 //   global_gain_db: volume gain in decibels (>0 means higher, <0 means lower)
+// The first call also allocates the voice pool (see tsf_set_max_voices).
 TSFDEF void tsf_set_output(tsf* f, enum TSFOutputMode outputmode, int samplerate, float global_gain_db CPP_DEFAULT0);
 
+// Set the polyphony: the voice pool is allocated once with this many voices
+// (default TSF_DEFAULT_MAX_VOICES), so playing notes never allocates. When all
+// voices play, a new one takes the place of the quietest, preferring voices
+// already in their release, then the oldest. Stops all playing voices.
+//   (returns 0 if out of memory, otherwise 1)
+TSFDEF int tsf_set_max_voices(tsf* f, int max_voices);
+
+// Voice render kernels
+enum TSFRenderKernel
+{
+	// One sample at a time
+	TSF_KERNEL_SCALAR,
+	// Four samples per step (x86 SSE2)
+	TSF_KERNEL_SSE2,
+	// Eight samples per step (x86 AVX2)
+	TSF_KERNEL_AVX2,
+};
+
+// Select the kernel used by the render methods (new instances use the fastest one the CPU supports)
+//   (returns the kernel now in use, the fastest supported one if the requested one is not)
+TSFDEF enum TSFRenderKernel tsf_set_render_kernel(tsf* f, enum TSFRenderKernel kernel);
+
 // Start playing a note
 //   preset_index: preset index >= 0 and < tsf_get_presetcount()
 //   key: note value between 0 and 127 (60 being middle C)
@@ -187,6 +233,7 @@ TSFDEF void tsf_channel_note_on(tsf* f, int channel, int key, float vel);
 TSFDEF void tsf_channel_note_off(tsf* f, int channel, int key);
 TSFDEF void tsf_channel_note_off_all(tsf* f, int channel); //end with sustain and release
 TSFDEF void tsf_channel_sounds_off_all(tsf* f, int channel); //end immediatly
+TSFDEF void tsf_channel_kill_all(tsf* f, int channel); //end without the fast release
 
 															 // Apply a MIDI control change to the channel (not all controllers are supported!)
 TSFDEF void tsf_channel_midi_control(tsf* f, int channel, int controller, int control_value);
@@ -199,6 +246,9 @@ TSFDEF int tsf_channel_get_pitchwheel(tsf* f, int channel);
 TSFDEF float tsf_channel_get_pan(tsf* f, int channel);
 TSFDEF float tsf_channel_get_volume(tsf* f, int channel);
 
+// Number of voices playing on a channel, including ones in their release
+TSFDEF int tsf_channel_get_voicecount(tsf* f, int channel);
+
 #ifdef __cplusplus
 #  undef CPP_DEFAULT0
 }
@@ -217,9 +267,22 @@ TSFDEF float tsf_channel_get_volume(tsf* f, int channel);
 #define TSF_RENDER_EFFECTSAMPLEBLOCK 64
 #endif
 
+// Voice pool size unless set with tsf_set_max_voices
+#ifndef TSF_DEFAULT_MAX_VOICES
+#define TSF_DEFAULT_MAX_VOICES 256
+#endif
+
 // Grace release time for quick voice off (avoid clicking noise)
 #define TSF_FASTRELEASETIME 0.01f
 
+// Playing voices are listed by key modulo this, per channel
+#define TSF_KEY_LISTS 128
+
+// Presets with at least this many regions get a key and velocity index of them
+#ifndef TSF_REGION_INDEX_MIN
+#define TSF_REGION_INDEX_MIN 8
+#endif
+
 #if !defined(TSF_MALLOC) || !defined(TSF_FREE) || !defined(TSF_REALLOC)
 #  include <stdlib.h>
 #  define TSF_MALLOC  malloc
@@ -253,6 +316,39 @@ TSFDEF float tsf_channel_get_volume(tsf* f, int channel);
 #  include <stdio.h>
 #endif
 
+// Vector kernels are built for x86 unless TSF_NO_SIMD is defined, and picked at run time
+#if !defined(TSF_NO_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#  define TSF_SIMD 1
+#  include <immintrin.h>
+#  if defined(_MSC_VER) && !defined(__clang__)
+#    include <intrin.h>
+#    define TSF_TARGET_SSE2
+#    define TSF_TARGET_AVX2
+#  else
+#    define TSF_TARGET_SSE2 __attribute__((target("sse2")))
+#    define TSF_TARGET_AVX2 __attribute__((target("avx2")))
+#  endif
+#else
+#  define TSF_SIMD 0
+#endif
+
+#if !defined(TSF_NO_STDIO) && !defined(TSF_NO_MMAP) && (defined(_WIN32) || defined(__unix__) || defined(__APPLE__))
+#  define TSF_MMAP 1
+#  ifdef _WIN32
+#    ifndef NOMINMAX
+#      define NOMINMAX
+#    endif
+#    include <windows.h>
+#  else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#  endif
+#else
+#  define TSF_MMAP 0
+#endif
+
 #define TSF_TRUE 1
 #define TSF_FALSE 0
 #define TSF_BOOL char
@@ -276,21 +372,95 @@ extern "C" {
 	struct tsf
 	{
 		struct tsf_preset* presets;
-		float* fontSamples;
+		short* fontSamples;
 		struct tsf_voice* voices;
 		struct tsf_channels* channels;
 		float* outputSamples;
-
+		void* fontMapping; // file view fontSamples points into, if mapped
+		size_t fontMappingSize;
+
+		// The voice pool: activeVoices holds every voice, the active ones first
+		// (activeVoiceNum of them) and the free ones after, and each voice knows
+		// its place in it, so starting and ending a voice is a swap
+		struct tsf_voice** activeVoices;
+		// Voices started without channels, listed by key like in tsf_channel
+		struct tsf_voice* keyVoices[TSF_KEY_LISTS];
+		// Open addressing hash of bank and preset number to the first preset
+		// index with them (-1 in free slots); NULL if it could not be allocated,
+		// tsf_get_presetindex then searches the presets
+		int* presetLookup;
+		int presetLookupSize;
 		int presetNum;
-		int voiceNum;
+		int voiceNum, activeVoiceNum;
 		int outputSampleSize;
 		unsigned int voicePlayIndex;
 
 		enum TSFOutputMode outputmode;
+		enum TSFRenderKernel renderKernel;
 		float outSampleRate;
 		float globalGainDB;
 	};
 
+	struct tsf_stream_memory { const char* buffer; unsigned int total, pos; };
+	static int tsf_stream_memory_read(struct tsf_stream_memory* m, void* ptr, unsigned int size) { if (size > m->total - m->pos) size = m->total - m->pos; TSF_MEMCPY(ptr, m->buffer + m->pos, size); m->pos += size; return size; }
+	static int tsf_stream_memory_skip(struct tsf_stream_memory* m, unsigned int count) { if (m->pos + count > m->total) return 0; m->pos += count; return 1; }
+	TSFDEF tsf* tsf_load_memory(const void* buffer, int size)
+	{
+		struct tsf_stream stream = { TSF_NULL, (int(*)(void*,void*,unsigned int))&tsf_stream_memory_read, (int(*)(void*,unsigned int))&tsf_stream_memory_skip };
+		struct tsf_stream_memory f = { 0, 0, 0 };
+		f.buffer = (const char*)buffer;
+		f.total = size;
+		stream.data = &f;
+		return tsf_load(&stream);
+	}
+
+	// Loads from a stream, or with the sample data left in place in the memory a memory stream reads
+	static tsf* tsf_load_internal(struct tsf_stream* stream, struct tsf_stream_memory* inPlace);
+
+#if TSF_MMAP
+	// Maps a whole file read-only, returns NULL if that is not possible
+	static const char* tsf_map_file(const char* filename, size_t* size)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, TSF_NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, TSF_NULL), mapping;
+		LARGE_INTEGER fileSize;
+		void* view = TSF_NULL;
+		if (file == INVALID_HANDLE_VALUE) return TSF_NULL;
+		if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0 && fileSize.QuadPart <= 0x7FFFFFFF)
+		{
+			mapping = CreateFileMappingA(file, TSF_NULL, PAGE_READONLY, 0, 0, TSF_NULL);
+			if (mapping) { view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0); CloseHandle(mapping); }
+			*size = (size_t)fileSize.QuadPart;
+		}
+		CloseHandle(file);
+		return (const char*)view;
+#else
+		int fd = open(filename, O_RDONLY);
+		struct stat st;
+		void* view = TSF_NULL;
+		if (fd < 0) return TSF_NULL;
+		if (!fstat(fd, &st) && st.st_size > 0 && st.st_size <= 0x7FFFFFFF)
+		{
+			view = mmap(TSF_NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			if (view == MAP_FAILED) view = TSF_NULL;
+			*size = (size_t)st.st_size;
+		}
+		close(fd);
+		return (const char*)view;
+#endif
+	}
+
+	static void tsf_unmap_file(void* view, size_t size)
+	{
+#ifdef _WIN32
+		(void)size;
+		UnmapViewOfFile(view);
+#else
+		munmap(view, size);
+#endif
+	}
+#endif
+
 #ifndef TSF_NO_STDIO
 	static int tsf_stream_stdio_read(FILE* f, void* ptr, unsigned int size) { return (int)fread(ptr, 1, size, f); }
 	static int tsf_stream_stdio_skip(FILE* f, unsigned int count) { return !fseek(f, count, SEEK_CUR); }
@@ -298,6 +468,22 @@ extern "C" {
 	{
 		tsf* res;
 		struct tsf_stream stream = { TSF_NULL, (int(*)(void*,void*,unsigned int))&tsf_stream_stdio_read, (int(*)(void*,unsigned int))&tsf_stream_stdio_skip };
+#if TSF_MMAP
+		size_t mappedSize = 0;
+		const char* mapped = tsf_map_file(filename, &mappedSize);
+		if (mapped)
+		{
+			struct tsf_stream mappedStream = { TSF_NULL, (int(*)(void*,void*,unsigned int))&tsf_stream_memory_read, (int(*)(void*,unsigned int))&tsf_stream_memory_skip };
+			struct tsf_stream_memory m = { 0, 0, 0 };
+			m.buffer = mapped;
+			m.total = (unsigned int)mappedSize;
+			mappedStream.data = &m;
+			res = tsf_load_internal(&mappedStream, &m);
+			if (res) { res->fontMapping = (void*)mapped; res->fontMappingSize = mappedSize; }
+			else tsf_unmap_file((void*)mapped, mappedSize);
+			return res;
+		}
+#endif
 #if __STDC_WANT_SECURE_LIB__
 		FILE* f = TSF_NULL; fopen_s(&f, filename, "rb");
 #else
@@ -315,19 +501,6 @@ extern "C" {
 	}
 #endif
 
-	struct tsf_stream_memory { const char* buffer; unsigned int total, pos; };
-	static int tsf_stream_memory_read(struct tsf_stream_memory* m, void* ptr, unsigned int size) { if (size > m->total - m->pos) size = m->total - m->pos; TSF_MEMCPY(ptr, m->buffer + m->pos, size); m->pos += size; return size; }
-	static int tsf_stream_memory_skip(struct tsf_stream_memory* m, unsigned int count) { if (m->pos + count > m->total) return 0; m->pos += count; return 1; }
-	TSFDEF tsf* tsf_load_memory(const void* buffer, int size)
-	{
-		struct tsf_stream stream = { TSF_NULL, (int(*)(void*,void*,unsigned int))&tsf_stream_memory_read, (int(*)(void*,unsigned int))&tsf_stream_memory_skip };
-		struct tsf_stream_memory f = { 0, 0, 0 };
-		f.buffer = (const char*)buffer;
-		f.total = size;
-		stream.data = &f;
-		return tsf_load(&stream);
-	}
-
 	enum { TSF_LOOPMODE_NONE, TSF_LOOPMODE_CONTINUOUS, TSF_LOOPMODE_SUSTAIN };
 
 	enum { TSF_SEGMENT_NONE, TSF_SEGMENT_DELAY, TSF_SEGMENT_ATTACK, TSF_SEGMENT_HOLD, TSF_SEGMENT_DECAY, TSF_SEGMENT_SUSTAIN, TSF_SEGMENT_RELEASE, TSF_SEGMENT_DONE };
@@ -371,6 +544,7 @@ extern "C" {
 
 	struct tsf_region
 	{
+		const short* samples;
 		int loop_mode;
 		unsigned int sample_rate;
 		unsigned char lokey, hikey, lovel, hivel;
@@ -392,6 +566,14 @@ extern "C" {
 		tsf_u16 preset, bank;
 		struct tsf_region* regions;
 		int regionNum;
+		// Regions by key and velocity layer (NULL for small presets): those of
+		// cell key * velLayerNum + velLayer[velocity] are regionIndex[regionCells[cell]]
+		// up to regionIndex[regionCells[cell + 1]], in preset order. All three
+		// arrays are in the block regionCells points to.
+		int* regionCells;
+		unsigned short* regionIndex;
+		unsigned char* velLayer;
+		int velLayerNum;
 	};
 
 	struct tsf_voice
@@ -400,8 +582,10 @@ extern "C" {
 		struct tsf_region* region;
 		double pitchInputTimecents, pitchOutputFactor;
 		double sourceSamplePosition;
-		float  noteGainDB, panFactorLeft, panFactorRight;
+		float  noteGainDB, noteGain, panFactorLeft, panFactorRight; // noteGain: noteGainDB as a factor
 		unsigned int playIndex, loopStart, loopEnd;
+		int activeIndex;
+		struct tsf_voice *channelPrev, *channelNext, *keyPrev, *keyNext; // in its channel's lists, see tsf_voice_link
 		struct tsf_voice_envelope ampenv, modenv;
 		struct tsf_voice_lowpass lowpass;
 		struct tsf_voice_lfo modlfo, viblfo;
@@ -411,6 +595,10 @@ extern "C" {
 	{
 		unsigned short presetIndex, bank, pitchWheel, midiPan, midiVolume, midiExpression, midiRPN, midiData;
 		float panOffset, gainDB, pitchRange, tuning;
+		// The channel's playing voices, all of them and by key, so channel
+		// updates and note-offs only visit the voices they affect
+		struct tsf_voice *voices, *keyVoices[TSF_KEY_LISTS];
+		int voiceNum;
 	};
 
 	struct tsf_channels
@@ -547,6 +735,96 @@ extern "C" {
 		else p->sustain = 1.0f - (p->sustain / 1000.0f);
 	}
 
+	static int tsf_preset_lookup_slot(const tsf* f, int bank, int preset_number)
+	{
+		unsigned int h = (((unsigned int)bank << 16) | (unsigned int)preset_number) * 2654435761u;
+		return (int)((h ^ (h >> 16)) & (unsigned int)(f->presetLookupSize - 1));
+	}
+
+	// Adds a preset to the lookup unless an earlier one has the same bank and number
+	static void tsf_preset_lookup_insert(tsf* f, int preset_index)
+	{
+		const struct tsf_preset* preset = &f->presets[preset_index];
+		int slot = tsf_preset_lookup_slot(f, preset->bank, preset->preset), other;
+		for (; (other = f->presetLookup[slot]) != -1; slot = (slot + 1) & (f->presetLookupSize - 1))
+			if (f->presets[other].bank == preset->bank && f->presets[other].preset == preset->preset) return;
+		f->presetLookup[slot] = preset_index;
+	}
+
+	// Sizes the lookup for the presets (at most half full) and fills it
+	static void tsf_preset_lookup_build(tsf* f)
+	{
+		int size = 16, i;
+		while (size < f->presetNum * 2) size <<= 1;
+		TSF_FREE(f->presetLookup);
+		f->presetLookup = (int*)TSF_MALLOC(size * sizeof(int));
+		f->presetLookupSize = (f->presetLookup ? size : 0);
+		if (!f->presetLookup) return;
+		for (i = 0; i < size; i++) f->presetLookup[i] = -1;
+		for (i = 0; i < f->presetNum; i++) tsf_preset_lookup_insert(f, i);
+	}
+
+	// The MIDI keys and velocities a region plays (returns 0 if none)
+	static TSF_BOOL tsf_region_midirange(const struct tsf_region* region, int* lokey, int* hikey, int* lovel, int* hivel)
+	{
+		*lokey = region->lokey; *hikey = (region->hikey > 127 ? 127 : region->hikey);
+		*lovel = region->lovel; *hivel = (region->hivel > 127 ? 127 : region->hivel);
+		return (*lokey <= *hikey && *lovel <= *hivel);
+	}
+
+	// Builds the key and velocity index of a preset's regions (none if out of memory)
+	static void tsf_preset_index_regions(struct tsf_preset* preset)
+	{
+		unsigned char layerStarts[128], velLayer[128];
+		int layerNum, cellNum, entryNum = 0, lokey, hikey, lovel, hivel, key, cell, i;
+		char* block;
+		preset->regionCells = TSF_NULL;
+		preset->regionIndex = TSF_NULL;
+		preset->velLayer = TSF_NULL;
+		preset->velLayerNum = 0;
+		if (preset->regionNum < TSF_REGION_INDEX_MIN || preset->regionNum > 0xFFFF) return;
+
+		// Velocity layers: the ranges between the bounds of all regions
+		TSF_MEMSET(layerStarts, 0, sizeof(layerStarts));
+		layerStarts[0] = 1;
+		for (i = 0; i < preset->regionNum; i++)
+		{
+			if (!tsf_region_midirange(&preset->regions[i], &lokey, &hikey, &lovel, &hivel)) continue;
+			layerStarts[lovel] = 1;
+			if (hivel < 127) layerStarts[hivel + 1] = 1;
+		}
+		for (i = 0, layerNum = 0; i < 128; i++) velLayer[i] = (unsigned char)((layerNum += layerStarts[i]) - 1);
+		cellNum = 128 * layerNum;
+		for (i = 0; i < preset->regionNum; i++)
+			if (tsf_region_midirange(&preset->regions[i], &lokey, &hikey, &lovel, &hivel))
+				entryNum += (hikey - lokey + 1) * (velLayer[hivel] - velLayer[lovel] + 1);
+
+		block = (char*)TSF_MALLOC((cellNum + 1) * sizeof(int) + entryNum * sizeof(unsigned short) + sizeof(velLayer));
+		if (!block) return;
+		preset->regionCells = (int*)block;
+		preset->regionIndex = (unsigned short*)(preset->regionCells + cellNum + 1);
+		preset->velLayer = (unsigned char*)(preset->regionIndex + entryNum);
+		preset->velLayerNum = layerNum;
+		TSF_MEMCPY(preset->velLayer, velLayer, sizeof(velLayer));
+
+		// Count the regions of each cell and turn the counts into starts. Filling
+		// in preset order then moves each start to where the next cell begins.
+		TSF_MEMSET(preset->regionCells, 0, (cellNum + 1) * sizeof(int));
+		for (i = 0; i < preset->regionNum; i++)
+			if (tsf_region_midirange(&preset->regions[i], &lokey, &hikey, &lovel, &hivel))
+				for (key = lokey; key <= hikey; key++)
+					for (cell = key * layerNum + velLayer[lovel]; cell <= key * layerNum + velLayer[hivel]; cell++)
+						preset->regionCells[cell + 1]++;
+		for (cell = 0; cell < cellNum; cell++) preset->regionCells[cell + 1] += preset->regionCells[cell];
+		for (i = 0; i < preset->regionNum; i++)
+			if (tsf_region_midirange(&preset->regions[i], &lokey, &hikey, &lovel, &hivel))
+				for (key = lokey; key <= hikey; key++)
+					for (cell = key * layerNum + velLayer[lovel]; cell <= key * layerNum + velLayer[hivel]; cell++)
+						preset->regionIndex[preset->regionCells[cell]++] = (unsigned short)i;
+		for (cell = cellNum; cell > 0; cell--) preset->regionCells[cell] = preset->regionCells[cell - 1];
+		preset->regionCells[0] = 0;
+	}
+
 	static void tsf_load_presets(tsf* res, struct tsf_hydra *hydra, unsigned int fontSampleCount)
 	{
 		enum { GenInstrument = 41, GenKeyRange = 43, GenVelRange = 44, GenSampleID = 53 };
@@ -698,6 +976,7 @@ extern "C" {
 									if (zoneRegion.pitch_keycenter == -1) zoneRegion.pitch_keycenter = pshdr->originalPitch;
 									zoneRegion.tune += pshdr->pitchCorrection;
 									zoneRegion.sample_rate = pshdr->sampleRate;
+									zoneRegion.samples = res->fontSamples;
 									if (zoneRegion.end && zoneRegion.end < fontSampleCount) zoneRegion.end++;
 									else zoneRegion.end = fontSampleCount;
 
@@ -730,23 +1009,14 @@ extern "C" {
 		}
 	}
 
-	static void tsf_load_samples(float** fontSamples, unsigned int* fontSampleCount, struct tsf_riffchunk *chunkSmpl, struct tsf_stream* stream)
+	static void tsf_load_samples(short** fontSamples, unsigned int* fontSampleCount, struct tsf_riffchunk *chunkSmpl, struct tsf_stream* stream)
 	{
-		// Read sample data into float format buffer.
-		float* out; unsigned int samplesLeft, samplesToRead, samplesToConvert;
-		samplesLeft = *fontSampleCount = chunkSmpl->size / sizeof(short);
-		out = *fontSamples = (float*)TSF_MALLOC(samplesLeft * sizeof(float));
-		for (; samplesLeft; samplesLeft -= samplesToRead)
-		{
-			short sampleBuffer[1024], *in = sampleBuffer;;
-			samplesToRead = (samplesLeft > 1024 ? 1024 : samplesLeft);
-			stream->read(stream->data, sampleBuffer, samplesToRead * sizeof(short));
-
-			// Convert from signed 16-bit to float.
-			for (samplesToConvert = samplesToRead; samplesToConvert > 0; --samplesToConvert)
-				// If we ever need to compile for big-endian platforms, we'll need to byte-swap here.
-				*out++ = (float)(*in++ / 32767.0);
-		}
+		// Keep the sample data as signed 16-bit, the voice render converts it to float.
+		// If we ever need to compile for big-endian platforms, we'll need to byte-swap here.
+		unsigned int sampleBytes = (*fontSampleCount = chunkSmpl->size / sizeof(short)) * sizeof(short);
+		*fontSamples = (short*)TSF_MALLOC(sampleBytes);
+		if (*fontSamples) stream->read(stream->data, *fontSamples, sampleBytes);
+		else stream->skip(stream->data, sampleBytes);
 	}
 
 	static void tsf_voice_envelope_nextsegment(struct tsf_voice_envelope* e, short active_segment, float outSampleRate)
@@ -910,8 +1180,53 @@ extern "C" {
 		else if (e->level < -1.0f) { e->delta = -e->delta; e->level = -2.0f - e->level; }
 	}
 
-	static void tsf_voice_kill(struct tsf_voice* v)
+	// Head of the key list of a playing voice
+	static struct tsf_voice** tsf_voice_keylist(tsf* f, struct tsf_voice* v)
+	{
+		if (v->playingChannel >= 0) return &f->channels->channels[v->playingChannel].keyVoices[v->playingKey & (TSF_KEY_LISTS - 1)];
+		return &f->keyVoices[v->playingKey & (TSF_KEY_LISTS - 1)];
+	}
+
+	// Adds a started voice to the lists of its channel and key (voices without a channel only have a key list)
+	static void tsf_voice_link(tsf* f, struct tsf_voice* v)
+	{
+		struct tsf_voice** keyList = tsf_voice_keylist(f, v);
+		v->keyPrev = TSF_NULL;
+		v->keyNext = *keyList;
+		if (*keyList) (*keyList)->keyPrev = v;
+		*keyList = v;
+		v->channelPrev = v->channelNext = TSF_NULL;
+		if (v->playingChannel >= 0)
+		{
+			struct tsf_channel* c = &f->channels->channels[v->playingChannel];
+			v->channelNext = c->voices;
+			if (c->voices) c->voices->channelPrev = v;
+			c->voices = v;
+			c->voiceNum++;
+		}
+	}
+
+	static void tsf_voice_unlink(tsf* f, struct tsf_voice* v)
 	{
+		if (v->keyPrev) v->keyPrev->keyNext = v->keyNext;
+		else *tsf_voice_keylist(f, v) = v->keyNext;
+		if (v->keyNext) v->keyNext->keyPrev = v->keyPrev;
+		if (v->playingChannel >= 0)
+		{
+			struct tsf_channel* c = &f->channels->channels[v->playingChannel];
+			if (v->channelPrev) v->channelPrev->channelNext = v->channelNext;
+			else c->voices = v->channelNext;
+			if (v->channelNext) v->channelNext->channelPrev = v->channelPrev;
+			c->voiceNum--;
+		}
+	}
+
+	static void tsf_voice_kill(tsf* f, struct tsf_voice* v)
+	{
+		struct tsf_voice* last = f->activeVoices[--f->activeVoiceNum];
+		f->activeVoices[v->activeIndex] = last; last->activeIndex = v->activeIndex;
+		f->activeVoices[f->activeVoiceNum] = v; v->activeIndex = f->activeVoiceNum;
+		tsf_voice_unlink(f, v);
 		v->region = TSF_NULL;
 		v->playingPreset = -1;
 	}
@@ -942,10 +1257,167 @@ extern "C" {
 		v->pitchOutputFactor = v->region->sample_rate / (tsf_timecents2Secsd(v->region->pitch_keycenter * 100.0) * outSampleRate);
 	}
 
+	static enum TSFRenderKernel tsf_kernel_supported(void)
+	{
+#if TSF_SIMD && defined(_MSC_VER) && !defined(__clang__)
+		int info[4], maxLeaf;
+		__cpuid(info, 0); maxLeaf = info[0];
+		__cpuid(info, 1);
+		if (!(info[3] & (1 << 26))) return TSF_KERNEL_SCALAR;
+		// AVX2 also needs the OS to save the YMM registers (OSXSAVE and AVX set, XCR0 bits 1 and 2)
+		if (maxLeaf >= 7 && (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6)
+		{
+			__cpuidex(info, 7, 0);
+			if (info[1] & (1 << 5)) return TSF_KERNEL_AVX2;
+		}
+		return TSF_KERNEL_SSE2;
+#elif TSF_SIMD
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) return TSF_KERNEL_AVX2;
+		if (__builtin_cpu_supports("sse2")) return TSF_KERNEL_SSE2;
+		return TSF_KERNEL_SCALAR;
+#else
+		return TSF_KERNEL_SCALAR;
+#endif
+	}
+
+#if TSF_SIMD
+	// The vector kernels interpolate one span of a block: count samples at positions
+	// frac + i * step (i = 0, 1, ...) past input[0], every one reading two consecutive
+	// samples with a single 32-bit load. Positions are clamped to maxPos, so the lanes
+	// past count read inside the span too. They store whole vectors, so out needs room
+	// for 7 more samples. Like the scalar path they leave samples in 16-bit units.
+	static TSF_TARGET_SSE2 void tsf_kernel_span_sse2(const short* input, float* out, int count, float frac, float step, float maxPos)
+	{
+		__m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), laneStep = _mm_set1_ps(4.0f);
+		__m128 vfrac = _mm_set1_ps(frac), vstep = _mm_set1_ps(step), vmax = _mm_set1_ps(maxPos), one = _mm_set1_ps(1.0f);
+		int idx[4], pairs[4];
+		for (; count > 0; count -= 4, out += 4, lane = _mm_add_ps(lane, laneStep))
+		{
+			__m128 pos = _mm_min_ps(_mm_add_ps(vfrac, _mm_mul_ps(lane, vstep)), vmax);
+			__m128i ipos = _mm_cvttps_epi32(pos), pair;
+			__m128 alpha = _mm_sub_ps(pos, _mm_cvtepi32_ps(ipos)), a, b;
+			_mm_storeu_si128((__m128i*)idx, ipos);
+			TSF_MEMCPY(&pairs[0], input + idx[0], 4); TSF_MEMCPY(&pairs[1], input + idx[1], 4);
+			TSF_MEMCPY(&pairs[2], input + idx[2], 4); TSF_MEMCPY(&pairs[3], input + idx[3], 4);
+			pair = _mm_loadu_si128((const __m128i*)pairs);
+			a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(pair, 16), 16));
+			b = _mm_cvtepi32_ps(_mm_srai_epi32(pair, 16));
+			_mm_storeu_ps(out, _mm_add_ps(_mm_mul_ps(a, _mm_sub_ps(one, alpha)), _mm_mul_ps(b, alpha)));
+		}
+	}
+
+	static TSF_TARGET_AVX2 void tsf_kernel_span_avx2(const short* input, float* out, int count, float frac, float step, float maxPos)
+	{
+		__m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f), laneStep = _mm256_set1_ps(8.0f);
+		__m256 vfrac = _mm256_set1_ps(frac), vstep = _mm256_set1_ps(step), vmax = _mm256_set1_ps(maxPos), one = _mm256_set1_ps(1.0f);
+		for (; count > 0; count -= 8, out += 8, lane = _mm256_add_ps(lane, laneStep))
+		{
+			__m256 pos = _mm256_min_ps(_mm256_add_ps(vfrac, _mm256_mul_ps(lane, vstep)), vmax);
+			__m256i ipos = _mm256_cvttps_epi32(pos);
+			__m256 alpha = _mm256_sub_ps(pos, _mm256_cvtepi32_ps(ipos));
+			__m256i pair = _mm256_i32gather_epi32((const int*)input, ipos, 2);
+			__m256 a = _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(pair, 16), 16));
+			__m256 b = _mm256_cvtepi32_ps(_mm256_srai_epi32(pair, 16));
+			_mm256_storeu_ps(out, _mm256_add_ps(_mm256_mul_ps(a, _mm256_sub_ps(one, alpha)), _mm256_mul_ps(b, alpha)));
+		}
+		_mm256_zeroupper();
+	}
+
+	// Adds count mono samples to the output at the given gains, in the instance's output mode
+	static TSF_TARGET_SSE2 void tsf_kernel_mix_sse2(enum TSFOutputMode outputmode, const float* in, int count, float* outL, float* outR, float gainLeft, float gainRight, float gainMono)
+	{
+		int i = 0;
+		switch (outputmode)
+		{
+		case TSF_STEREO_INTERLEAVED:
+			{
+				__m128 gains = _mm_setr_ps(gainLeft, gainRight, gainLeft, gainRight);
+				for (; i + 4 <= count; i += 4, outL += 8)
+				{
+					__m128 val = _mm_loadu_ps(in + i);
+					_mm_storeu_ps(outL, _mm_add_ps(_mm_loadu_ps(outL), _mm_mul_ps(_mm_unpacklo_ps(val, val), gains)));
+					_mm_storeu_ps(outL + 4, _mm_add_ps(_mm_loadu_ps(outL + 4), _mm_mul_ps(_mm_unpackhi_ps(val, val), gains)));
+				}
+				for (; i < count; i++) { *outL++ += in[i] * gainLeft; *outL++ += in[i] * gainRight; }
+			}
+			break;
+
+		case TSF_STEREO_UNWEAVED:
+			{
+				__m128 vleft = _mm_set1_ps(gainLeft), vright = _mm_set1_ps(gainRight);
+				for (; i + 4 <= count; i += 4)
+				{
+					__m128 val = _mm_loadu_ps(in + i);
+					_mm_storeu_ps(outL + i, _mm_add_ps(_mm_loadu_ps(outL + i), _mm_mul_ps(val, vleft)));
+					_mm_storeu_ps(outR + i, _mm_add_ps(_mm_loadu_ps(outR + i), _mm_mul_ps(val, vright)));
+				}
+				for (; i < count; i++) { outL[i] += in[i] * gainLeft; outR[i] += in[i] * gainRight; }
+			}
+			break;
+
+		case TSF_MONO:
+			{
+				__m128 vgain = _mm_set1_ps(gainMono);
+				for (; i + 4 <= count; i += 4)
+					_mm_storeu_ps(outL + i, _mm_add_ps(_mm_loadu_ps(outL + i), _mm_mul_ps(_mm_loadu_ps(in + i), vgain)));
+				for (; i < count; i++) outL[i] += in[i] * gainMono;
+			}
+			break;
+		}
+	}
+
+	// Interpolates up to count samples of a voice into out for the vector kernels.
+	// The samples are cut into spans within which no position reaches the loop end or the
+	// sample end, so the kernels need no per-sample tests. Only positions on the last
+	// sample of a loop, which interpolate towards its first, are done one at a time.
+	// Returns the number of samples interpolated, less than count if the sample ended.
+	static int tsf_voice_interpolate(enum TSFRenderKernel kernel, const short* input, float* out, int count, double* position, double pitchRatio,
+		TSF_BOOL isLooping, unsigned int loopStart, unsigned int loopEnd, double sampleEnd)
+	{
+		double pos = *position, loopEndDbl = loopEnd + 1.0, loopLength = loopEnd - loopStart + 1.0;
+		double limit = (isLooping && loopEnd < sampleEnd ? (double)loopEnd : sampleEnd);
+		int done = 0;
+		while (done < count && pos < sampleEnd)
+		{
+			unsigned int first = (unsigned int)pos;
+			if (pos >= limit)
+			{
+				float alpha = (float)(pos - first);
+				out[done++] = input[first] * (1.0f - alpha) + input[loopStart] * alpha;
+				pos += pitchRatio;
+				if (pos >= loopEndDbl) pos -= loopLength;
+			}
+			else
+			{
+				// Positions in the span stay below the limit, read input[limit] at most
+				double steps = (limit - pos) / pitchRatio;
+				float span = (float)(limit - first);
+				int spanSamples = count - done;
+				if (steps < spanSamples) { spanSamples = (int)steps; if (spanSamples < steps) spanSamples++; }
+				if (kernel == TSF_KERNEL_AVX2) tsf_kernel_span_avx2(input + first, out + done, spanSamples, (float)(pos - first), (float)pitchRatio, span - span * (1.0f / 8388608.0f));
+				else tsf_kernel_span_sse2(input + first, out + done, spanSamples, (float)(pos - first), (float)pitchRatio, span - span * (1.0f / 8388608.0f));
+				done += spanSamples;
+				pos += spanSamples * pitchRatio;
+				if (isLooping && pos >= loopEndDbl) pos -= loopLength;
+			}
+		}
+		*position = pos;
+		return done;
+	}
+#endif
+
+	// Sets the note gain, keeping the factor in step so rendering and stealing need no powf
+	static void tsf_voice_setgain(struct tsf_voice* v, float gain_db)
+	{
+		v->noteGainDB = gain_db;
+		v->noteGain = tsf_decibelsToGain(gain_db);
+	}
+
 	static void tsf_voice_render(tsf* f, struct tsf_voice* v, float* outputBuffer, int numSamples)
 	{
 		struct tsf_region* region = v->region;
-		float* input = f->fontSamples;
+		const short* input = region->samples;
 		float* outL = outputBuffer;
 		float* outR = (f->outputmode == TSF_STEREO_UNWEAVED ? outL + numSamples : TSF_NULL);
 
@@ -976,7 +1448,7 @@ extern "C" {
 		else pitchRatio = tsf_timecents2Secsd(v->pitchInputTimecents) * v->pitchOutputFactor, tmpModLfoToPitch = 0, tmpVibLfoToPitch = 0, tmpModEnvToPitch = 0;
 
 		if (dynamicGain) tmpModLfoToVolume = (float)region->modLfoToVolume * 0.1f;
-		else noteGain = tsf_decibelsToGain(v->noteGainDB), tmpModLfoToVolume = 0;
+		else noteGain = v->noteGain, tmpModLfoToVolume = 0;
 
 		while (numSamples)
 		{
@@ -987,7 +1459,7 @@ extern "C" {
 			if (dynamicLowpass)
 			{
 				float fres = tmpInitialFilterFc + v->modlfo.level * tmpModLfoToFilterFc + v->modenv.level * tmpModEnvToFilterFc;
-				tmpLowpass.active = (fres <= 13500.0f);
+				tmpLowpass.active = (fres < 13500.0f);
 				if (tmpLowpass.active) tsf_voice_lowpass_setup(&tmpLowpass, tsf_cents2Hertz(fres) / tmpSampleRate);
 			}
 
@@ -997,7 +1469,8 @@ extern "C" {
 			if (dynamicGain)
 				noteGain = tsf_decibelsToGain(v->noteGainDB + (v->modlfo.level * tmpModLfoToVolume));
 
-			gainMono = noteGain * v->ampenv.level;
+			// Samples are interpolated as 16-bit values, so the gain scales them to float as well
+			gainMono = noteGain * v->ampenv.level * (1.0f / 32767.0f);
 
 			// Update EG.
 			tsf_voice_envelope_process(&v->ampenv, blockSamples, f->outSampleRate);
@@ -1007,6 +1480,22 @@ extern "C" {
 			if (updateModLFO) tsf_voice_lfo_process(&v->modlfo, blockSamples);
 			if (updateVibLFO) tsf_voice_lfo_process(&v->viblfo, blockSamples);
 
+#if TSF_SIMD
+			if (f->renderKernel != TSF_KERNEL_SCALAR)
+			{
+				// Interpolate the block, filter it, then mix it in
+				float block[TSF_RENDER_EFFECTSAMPLEBLOCK + 8];
+				int i, rendered = tsf_voice_interpolate(f->renderKernel, input, block, blockSamples, &tmpSourceSamplePosition, pitchRatio,
+					isLooping, tmpLoopStart, tmpLoopEnd, tmpSampleEndDbl);
+				if (tmpLowpass.active)
+					for (i = 0; i < rendered; i++) block[i] = tsf_voice_lowpass_process(&tmpLowpass, block[i]);
+				tsf_kernel_mix_sse2(f->outputmode, block, rendered, outL, outR, gainMono * v->panFactorLeft, gainMono * v->panFactorRight, gainMono);
+				if (f->outputmode == TSF_STEREO_INTERLEAVED) outL += 2 * rendered;
+				else if (f->outputmode == TSF_STEREO_UNWEAVED) outL += rendered, outR += rendered;
+				else outL += rendered;
+			}
+			else
+#endif
 			switch (f->outputmode)
 			{
 			case TSF_STEREO_INTERLEAVED:
@@ -1073,7 +1562,7 @@ extern "C" {
 
 			if (tmpSourceSamplePosition >= tmpSampleEndDbl || v->ampenv.segment == TSF_SEGMENT_DONE)
 			{
-				tsf_voice_kill(v);
+				tsf_voice_kill(f, v);
 				return;
 			}
 		}
@@ -1083,13 +1572,19 @@ extern "C" {
 	}
 
 	TSFDEF tsf* tsf_load(struct tsf_stream* stream)
+	{
+		return tsf_load_internal(stream, TSF_NULL);
+	}
+
+	static tsf* tsf_load_internal(struct tsf_stream* stream, struct tsf_stream_memory* inPlace)
 	{
 		tsf* res = TSF_NULL;
 		struct tsf_riffchunk chunkHead;
 		struct tsf_riffchunk chunkList;
 		struct tsf_hydra hydra;
-		float* fontSamples = TSF_NULL;
-		unsigned int fontSampleCount;
+		short* fontSamples = TSF_NULL;
+		unsigned int fontSampleCount = 0;
+		int i;
 
 		if (!tsf_riffchunk_read(TSF_NULL, &chunkHead, stream) || !TSF_FourCCEquals(chunkHead.id, "sfbk"))
 		{
@@ -1130,7 +1625,13 @@ extern "C" {
 			{
 				while (tsf_riffchunk_read(&chunkList, &chunk, stream))
 				{
-					if (TSF_FourCCEquals(chunk.id, "smpl"))
+					if (TSF_FourCCEquals(chunk.id, "smpl") && inPlace)
+					{
+						short* inPlaceSamples = (short*)(inPlace->buffer + inPlace->pos);
+						unsigned int inPlaceCount = chunk.size / sizeof(short);
+						if (stream->skip(stream->data, inPlaceCount * sizeof(short))) fontSamples = inPlaceSamples, fontSampleCount = inPlaceCount;
+					}
+					else if (TSF_FourCCEquals(chunk.id, "smpl"))
 					{
 						tsf_load_samples(&fontSamples, &fontSampleCount, &chunk, stream);
 					}
@@ -1155,13 +1656,26 @@ extern "C" {
 			res->presets = (struct tsf_preset*)TSF_MALLOC(res->presetNum * sizeof(struct tsf_preset));
 			res->fontSamples = fontSamples;
 			res->outSampleRate = 44100.0f;
+			res->renderKernel = tsf_kernel_supported();
 			fontSamples = TSF_NULL; //don't free below
 			tsf_load_presets(res, &hydra, fontSampleCount);
+			for (i = 0; i < res->presetNum; i++) tsf_preset_index_regions(&res->presets[i]);
+			tsf_preset_lookup_build(res);
 		}
 		TSF_FREE(hydra.phdrs); TSF_FREE(hydra.pbags); TSF_FREE(hydra.pmods);
 		TSF_FREE(hydra.pgens); TSF_FREE(hydra.insts); TSF_FREE(hydra.ibags);
 		TSF_FREE(hydra.imods); TSF_FREE(hydra.igens); TSF_FREE(hydra.shdrs);
-		TSF_FREE(fontSamples);
+		if (!inPlace) TSF_FREE(fontSamples);
+		return res;
+	}
+
+	TSFDEF tsf* tsf_create(void)
+	{
+		tsf* res = (tsf*)TSF_MALLOC(sizeof(tsf));
+		if (!res) return TSF_NULL;
+		TSF_MEMSET(res, 0, sizeof(tsf));
+		res->outSampleRate = 44100.0f;
+		res->renderKernel = tsf_kernel_supported();
 		return res;
 	}
 
@@ -1170,10 +1684,19 @@ extern "C" {
 		struct tsf_preset *preset, *presetEnd;
 		if (!f) return;
 		for (preset = f->presets, presetEnd = preset + f->presetNum; preset != presetEnd; preset++)
+		{
 			TSF_FREE(preset->regions);
+			TSF_FREE(preset->regionCells);
+		}
 		TSF_FREE(f->presets);
+		TSF_FREE(f->presetLookup);
+#if TSF_MMAP
+		if (f->fontMapping) tsf_unmap_file(f->fontMapping, f->fontMappingSize);
+		else
+#endif
 		TSF_FREE(f->fontSamples);
 		TSF_FREE(f->voices);
+		TSF_FREE(f->activeVoices);
 		if (f->channels) { TSF_FREE(f->channels->channels); TSF_FREE(f->channels); }
 		TSF_FREE(f->outputSamples);
 		TSF_FREE(f);
@@ -1181,18 +1704,31 @@ extern "C" {
 
 	TSFDEF void tsf_reset(tsf* f)
 	{
-		struct tsf_voice *v = f->voices, *vEnd = v + f->voiceNum;
-		for (; v != vEnd; v++)
-			if (v->playingPreset != -1 && (v->ampenv.segment < TSF_SEGMENT_RELEASE || v->ampenv.parameters.release))
+		int i;
+		for (i = 0; i < f->activeVoiceNum; i++)
+		{
+			struct tsf_voice* v = f->activeVoices[i];
+			if (v->ampenv.segment < TSF_SEGMENT_RELEASE || v->ampenv.parameters.release)
 				tsf_voice_endquick(v, f->outSampleRate);
+			// The channels go away, so the fading voices continue without one
+			if (v->playingChannel >= 0) { tsf_voice_unlink(f, v); v->playingChannel = -1; tsf_voice_link(f, v); }
+		}
 		if (f->channels) { TSF_FREE(f->channels->channels); TSF_FREE(f->channels); f->channels = TSF_NULL; }
 	}
 
 	TSFDEF int tsf_get_presetindex(const tsf* f, int bank, int preset_number)
 	{
-		const struct tsf_preset *presets;
-		int i, iMax;
-		for (presets = f->presets, i = 0, iMax = f->presetNum; i < iMax; i++)
+		const struct tsf_preset *presets = f->presets;
+		int i, iMax, slot;
+		if (f->presetLookup)
+		{
+			if (bank < 0 || bank > 0xFFFF || preset_number < 0 || preset_number > 0xFFFF) return -1;
+			for (slot = tsf_preset_lookup_slot(f, bank, preset_number); (i = f->presetLookup[slot]) != -1; slot = (slot + 1) & (f->presetLookupSize - 1))
+				if (presets[i].preset == preset_number && presets[i].bank == bank)
+					return i;
+			return -1;
+		}
+		for (i = 0, iMax = f->presetNum; i < iMax; i++)
 			if (presets[i].preset == preset_number && presets[i].bank == bank)
 				return i;
 		return -1;
@@ -1203,6 +1739,81 @@ extern "C" {
 		return f->presetNum;
 	}
 
+	// Adds presets without regions up to preset_count, numbered after their index.
+	// An instance without a SoundFont has no lookup (sample presets are used by
+	// index); one with a SoundFont keeps its lookup, grown only when half full.
+	static int tsf_presets_grow(tsf* f, int preset_count)
+	{
+		struct tsf_preset* presets;
+		int i;
+		if (preset_count <= f->presetNum) return 1;
+		presets = (struct tsf_preset*)TSF_REALLOC(f->presets, preset_count * sizeof(struct tsf_preset));
+		if (!presets) return 0;
+		f->presets = presets;
+		TSF_MEMSET(presets + f->presetNum, 0, (preset_count - f->presetNum) * sizeof(struct tsf_preset));
+		for (i = f->presetNum; i < preset_count; i++) presets[i].preset = (tsf_u16)i;
+		if (f->presetLookup && preset_count * 2 <= f->presetLookupSize)
+			for (i = f->presetNum; i < preset_count; i++) tsf_preset_lookup_insert(f, i);
+		f->presetNum = preset_count;
+		if (f->presetLookup && f->presetNum * 2 > f->presetLookupSize) tsf_preset_lookup_build(f);
+		return 1;
+	}
+
+	// Gives a preset the one region sample presets have
+	static int tsf_preset_sample_region(struct tsf_preset* preset)
+	{
+		if (!preset->regions)
+		{
+			preset->regions = (struct tsf_region*)TSF_MALLOC(sizeof(struct tsf_region));
+			if (!preset->regions) return 0;
+		}
+		return 1;
+	}
+
+	TSFDEF int tsf_set_sample_preset(tsf* f, int preset_index, const short* samples, unsigned int sample_count, unsigned int sample_rate,
+		unsigned int loop_start, unsigned int loop_end, const unsigned short* generators, const short* amounts, int generator_count)
+	{
+		struct tsf_preset* preset;
+		struct tsf_region region;
+		int i;
+		if (preset_index < 0 || !tsf_presets_grow(f, preset_index + 1)) return 0;
+		preset = &f->presets[preset_index];
+		if (!tsf_preset_sample_region(preset)) return 0;
+		// The region replaced might have been indexed under other keys
+		TSF_FREE(preset->regionCells);
+		preset->regionCells = TSF_NULL;
+
+		tsf_region_clear(&region, TSF_FALSE);
+		for (i = 0; i < generator_count; i++)
+		{
+			union tsf_hydra_genamount amount;
+			amount.shortAmount = amounts[i];
+			tsf_region_operator(&region, generators[i], &amount);
+		}
+		tsf_region_envtosecs(&region.ampenv, TSF_TRUE);
+		tsf_region_envtosecs(&region.modenv, TSF_FALSE);
+		region.delayModLFO = (region.delayModLFO < -11950.0f ? 0.0f : tsf_timecents2Secsf(region.delayModLFO));
+		region.delayVibLFO = (region.delayVibLFO < -11950.0f ? 0.0f : tsf_timecents2Secsf(region.delayVibLFO));
+		if (region.pan < -0.5f) region.pan = -0.5f;
+		else if (region.pan > 0.5f) region.pan = 0.5f;
+		if (region.initialFilterQ < 1500 || region.initialFilterQ > 13500) region.initialFilterQ = 0;
+
+		region.samples = samples;
+		region.end = sample_count;
+		region.sample_rate = sample_rate;
+		if (region.pitch_keycenter == -1) region.pitch_keycenter = 60;
+		if (loop_start < loop_end && loop_end < sample_count)
+		{
+			region.loop_mode = TSF_LOOPMODE_CONTINUOUS;
+			region.loop_start = loop_start;
+			region.loop_end = loop_end;
+		}
+		else region.loop_mode = TSF_LOOPMODE_NONE;
+		*preset->regions = region;
+		preset->regionNum = 1;
+		return 1;
+	}
+
 	TSFDEF const char* tsf_get_presetname(const tsf* f, int preset)
 	{
 		return (preset < 0 || preset >= f->presetNum ? TSF_NULL : f->presets[preset].presetName);
@@ -1218,45 +1829,118 @@ extern "C" {
 		f->outputmode = outputmode;
 		f->outSampleRate = (float)(samplerate >= 1 ? samplerate : 44100.0f);
 		f->globalGainDB = global_gain_db;
+		if (!f->voices) tsf_set_max_voices(f, TSF_DEFAULT_MAX_VOICES);
+	}
+
+	TSFDEF int tsf_set_max_voices(tsf* f, int max_voices)
+	{
+		struct tsf_voice* voices;
+		struct tsf_voice** activeVoices;
+		int i;
+		if (max_voices < 1) max_voices = 1;
+		if (f->voices && f->voiceNum == max_voices)
+		{
+			while (f->activeVoiceNum) tsf_voice_kill(f, f->activeVoices[0]);
+			return 1;
+		}
+		voices = (struct tsf_voice*)TSF_MALLOC(max_voices * sizeof(struct tsf_voice));
+		activeVoices = (struct tsf_voice**)TSF_MALLOC(max_voices * sizeof(struct tsf_voice*));
+		if (!voices || !activeVoices) { TSF_FREE(voices); TSF_FREE(activeVoices); return 0; }
+		while (f->activeVoiceNum) tsf_voice_kill(f, f->activeVoices[0]);
+		TSF_FREE(f->voices); TSF_FREE(f->activeVoices);
+		for (i = 0; i < max_voices; i++)
+		{
+			voices[i].playingPreset = -1;
+			voices[i].region = TSF_NULL;
+			voices[i].activeIndex = i;
+			activeVoices[i] = &voices[i];
+		}
+		f->voices = voices;
+		f->activeVoices = activeVoices;
+		f->voiceNum = max_voices;
+		f->activeVoiceNum = 0;
+		return 1;
+	}
+
+	// Whether voice a should be stolen before voice b
+	static TSF_BOOL tsf_voice_steal_before(struct tsf_voice* a, struct tsf_voice* b)
+	{
+		TSF_BOOL aReleased = (a->ampenv.segment >= TSF_SEGMENT_RELEASE), bReleased = (b->ampenv.segment >= TSF_SEGMENT_RELEASE);
+		float aLevel, bLevel;
+		if (aReleased != bReleased) return aReleased;
+		aLevel = a->noteGain * a->ampenv.level;
+		bLevel = b->noteGain * b->ampenv.level;
+		if (aLevel != bLevel) return (aLevel < bLevel);
+		return (a->playIndex < b->playIndex);
+	}
+
+	// Takes a voice from the pool, stealing one if all are playing (NULL if there is no pool)
+	static struct tsf_voice* tsf_voice_start(tsf* f)
+	{
+		struct tsf_voice* v;
+		if (!f->voices && !tsf_set_max_voices(f, TSF_DEFAULT_MAX_VOICES)) return TSF_NULL;
+		if (f->activeVoiceNum == f->voiceNum)
+		{
+			struct tsf_voice *victim = f->activeVoices[0];
+			int i;
+			for (i = 1; i < f->activeVoiceNum; i++)
+				if (tsf_voice_steal_before(f->activeVoices[i], victim)) victim = f->activeVoices[i];
+			tsf_voice_kill(f, victim);
+		}
+		v = f->activeVoices[f->activeVoiceNum++];
+		return v;
+	}
+
+	TSFDEF enum TSFRenderKernel tsf_set_render_kernel(tsf* f, enum TSFRenderKernel kernel)
+	{
+		enum TSFRenderKernel supported = tsf_kernel_supported();
+		f->renderKernel = (kernel > supported ? supported : kernel);
+		return f->renderKernel;
 	}
 
 	TSFDEF void tsf_note_on(tsf* f, int preset_index, int key, float vel)
 	{
-		int midiVelocity = (int)(vel * 127), voicePlayIndex;
-		struct tsf_region *region, *regionEnd;
+		int midiVelocity = (int)(vel * 127), voicePlayIndex, regionIt, regionCount;
+		struct tsf_preset *preset;
+		struct tsf_region *region;
+		const unsigned short *cellRegions = TSF_NULL;
 
 		if (preset_index < 0 || preset_index >= f->presetNum) return;
 		if (vel <= 0.0f) { tsf_note_off(f, preset_index, key); return; }
 
+		// Only visit the regions indexed for the key and velocity, if the preset has an index
+		preset = &f->presets[preset_index];
+		regionCount = preset->regionNum;
+		if (preset->regionCells && key >= 0 && key < 128 && midiVelocity < 128)
+		{
+			int cell = key * preset->velLayerNum + preset->velLayer[midiVelocity];
+			cellRegions = preset->regionIndex + preset->regionCells[cell];
+			regionCount = preset->regionCells[cell + 1] - preset->regionCells[cell];
+		}
+
 		// Play all matching regions.
 		voicePlayIndex = f->voicePlayIndex++;
-		for (region = f->presets[preset_index].regions, regionEnd = region + f->presets[preset_index].regionNum; region != regionEnd; region++)
+		for (regionIt = 0; regionIt < regionCount; regionIt++)
 		{
-			struct tsf_voice *voice, *v, *vEnd; TSF_BOOL doLoop; float filterQDB;
+			struct tsf_voice *voice; TSF_BOOL doLoop; float filterQDB; int i;
+			region = &preset->regions[cellRegions ? cellRegions[regionIt] : regionIt];
 			if (key < region->lokey || key > region->hikey || midiVelocity < region->lovel || midiVelocity > region->hivel) continue;
 
-			voice = TSF_NULL, v = f->voices, vEnd = v + f->voiceNum;
 			if (region->group)
 			{
-				for (; v != vEnd; v++)
-					if (v->playingPreset == preset_index && v->region->group == region->group) tsf_voice_endquick(v, f->outSampleRate);
-					else if (v->playingPreset == -1 && !voice) voice = v;
+				for (i = 0; i < f->activeVoiceNum; i++)
+					if (f->activeVoices[i]->playingPreset == preset_index && f->activeVoices[i]->region->group == region->group)
+						tsf_voice_endquick(f->activeVoices[i], f->outSampleRate);
 			}
-			else for (; v != vEnd; v++) if (v->playingPreset == -1) { voice = v; break; }
 
-			if (!voice)
-			{
-				f->voiceNum += 4;
-				f->voices = (struct tsf_voice*)TSF_REALLOC(f->voices, f->voiceNum * sizeof(struct tsf_voice));
-				voice = &f->voices[f->voiceNum - 4];
-				voice[1].playingPreset = voice[2].playingPreset = voice[3].playingPreset = -1;
-			}
+			voice = tsf_voice_start(f);
+			if (!voice) return;
 
 			voice->region = region;
 			voice->playingPreset = preset_index;
 			voice->playingKey = key;
 			voice->playIndex = voicePlayIndex;
-			voice->noteGainDB = f->globalGainDB - region->volume - tsf_gainToDecibels(1.0f / vel);
+			tsf_voice_setgain(voice, f->globalGainDB - region->volume - tsf_gainToDecibels(1.0f / vel));
 
 			if (f->channels)
 			{
@@ -1264,11 +1948,13 @@ extern "C" {
 			}
 			else
 			{
+				voice->playingChannel = -1;
 				tsf_voice_calcpitchratio(voice, 0, f->outSampleRate);
 				// The SFZ spec is silent about the pan curve, but a 3dB pan law seems common. This sqrt() curve matches what Dimension LE does; Alchemy Free seems closer to sin(adjustedPan * pi/2).
 				voice->panFactorLeft = TSF_SQRTF(0.5f - region->pan);
 				voice->panFactorRight = TSF_SQRTF(0.5f + region->pan);
 			}
+			tsf_voice_link(f, voice);
 
 			// Offset/end.
 			voice->sourceSamplePosition = region->offset;
@@ -1286,7 +1972,7 @@ extern "C" {
 			filterQDB = region->initialFilterQ / 10.0f;
 			voice->lowpass.QInv = 1.0 / TSF_POW(10.0, (filterQDB / 20.0));
 			voice->lowpass.z1 = voice->lowpass.z2 = 0;
-			voice->lowpass.active = (region->initialFilterFc <= 13500);
+			voice->lowpass.active = (region->initialFilterFc < 13500); // 13500 cents (about 20 kHz) is the open default
 			if (voice->lowpass.active) tsf_voice_lowpass_setup(&voice->lowpass, tsf_cents2Hertz((float)region->initialFilterFc) / f->outSampleRate);
 
 			// Setup LFO filters.
@@ -1303,26 +1989,41 @@ extern "C" {
 		return 1;
 	}
 
-	TSFDEF void tsf_note_off(tsf* f, int preset_index, int key)
+	// Looks for the oldest voice of a key list that plays key (and preset_index unless -1) and is not released yet
+	static void tsf_keylist_find_oldest(struct tsf_voice* v, int preset_index, int key, struct tsf_voice** oldest)
 	{
-		struct tsf_voice *v = f->voices, *vEnd = v + f->voiceNum, *vMatchFirst = TSF_NULL, *vMatchLast;
-		for (; v != vEnd; v++)
+		for (; v; v = v->keyNext)
 		{
-			//Find the first and last entry in the voices list with matching preset, key and look up the smallest play index
-			if (v->playingPreset != preset_index || v->playingKey != key || v->ampenv.segment >= TSF_SEGMENT_RELEASE) continue;
-			else if (!vMatchFirst || v->playIndex < vMatchFirst->playIndex) vMatchFirst = vMatchLast = v;
-			else if (v->playIndex == vMatchFirst->playIndex) vMatchLast = v;
+			if (v->playingKey != key || (preset_index != -1 && v->playingPreset != preset_index) || v->ampenv.segment >= TSF_SEGMENT_RELEASE) continue;
+			if (!*oldest || v->playIndex < (*oldest)->playIndex) *oldest = v;
 		}
-		if (!vMatchFirst) return;
-		for (v = vMatchFirst; v <= vMatchLast; v++)
+	}
+
+	// Ends the voices of a key list that tsf_keylist_find_oldest matches and were started by the same note on
+	static void tsf_keylist_note_off(tsf* f, struct tsf_voice* v, int preset_index, int key, unsigned int playIndex)
+	{
+		for (; v; v = v->keyNext)
 		{
-			//Stop all voices with matching preset, key and the smallest play index which was enumerated above
-			if (v != vMatchFirst && v != vMatchLast &&
-				(v->playIndex != vMatchFirst->playIndex || v->playingPreset != preset_index || v->playingKey != key || v->ampenv.segment >= TSF_SEGMENT_RELEASE)) continue;
+			if (v->playIndex != playIndex || v->playingKey != key || (preset_index != -1 && v->playingPreset != preset_index) || v->ampenv.segment >= TSF_SEGMENT_RELEASE) continue;
 			tsf_voice_end(v, f->outSampleRate);
 		}
 	}
 
+	TSFDEF void tsf_note_off(tsf* f, int preset_index, int key)
+	{
+		struct tsf_voice* oldest = TSF_NULL;
+		int list = key & (TSF_KEY_LISTS - 1), i, channelNum = (f->channels ? f->channels->channelNum : 0);
+		unsigned int playIndex;
+		if (preset_index < 0) return;
+		// The preset can play on any channel, so the key's list of each is searched
+		tsf_keylist_find_oldest(f->keyVoices[list], preset_index, key, &oldest);
+		for (i = 0; i < channelNum; i++) tsf_keylist_find_oldest(f->channels->channels[i].keyVoices[list], preset_index, key, &oldest);
+		if (!oldest) return;
+		playIndex = oldest->playIndex;
+		tsf_keylist_note_off(f, f->keyVoices[list], preset_index, key, playIndex);
+		for (i = 0; i < channelNum; i++) tsf_keylist_note_off(f, f->channels->channels[i].keyVoices[list], preset_index, key, playIndex);
+	}
+
 	TSFDEF int tsf_bank_note_off(tsf* f, int bank, int preset_number, int key)
 	{
 		int preset_index = tsf_get_presetindex(f, bank, preset_number);
@@ -1333,9 +2034,9 @@ extern "C" {
 
 	TSFDEF void tsf_note_off_all(tsf* f)
 	{
-		struct tsf_voice *v = f->voices, *vEnd = v + f->voiceNum;
-		for (; v != vEnd; v++) if (v->playingPreset != -1 && v->ampenv.segment < TSF_SEGMENT_RELEASE)
-			tsf_voice_end(v, f->outSampleRate);
+		int i;
+		for (i = 0; i < f->activeVoiceNum; i++) if (f->activeVoices[i]->ampenv.segment < TSF_SEGMENT_RELEASE)
+			tsf_voice_end(f->activeVoices[i], f->outSampleRate);
 	}
 
 	TSFDEF void tsf_render_short(tsf* f, short* buffer, int samples, int flag_mixing)
@@ -1370,11 +2071,15 @@ extern "C" {
 
 	TSFDEF void tsf_render_float(tsf* f, float* buffer, int samples, int flag_mixing)
 	{
-		struct tsf_voice *v = f->voices, *vEnd = v + f->voiceNum;
+		int i = 0;
 		if (!flag_mixing) TSF_MEMSET(buffer, 0, (f->outputmode == TSF_MONO ? 1 : 2) * sizeof(float) * samples);
-		for (; v != vEnd; v++)
-			if (v->playingPreset != -1)
-				tsf_voice_render(f, v, buffer, samples);
+		while (i < f->activeVoiceNum)
+		{
+			// A voice that ends is swapped with the last active one, render that next
+			struct tsf_voice* v = f->activeVoices[i];
+			tsf_voice_render(f, v, buffer, samples);
+			if (v->playingPreset != -1) i++;
+		}
 	}
 
 	static void tsf_channel_setup_voice(tsf* f, struct tsf_voice* v)
@@ -1382,7 +2087,7 @@ extern "C" {
 		struct tsf_channel* c = &f->channels->channels[f->channels->activeChannel];
 		float newpan = v->region->pan + c->panOffset;
 		v->playingChannel = f->channels->activeChannel;
-		v->noteGainDB += c->gainDB;
+		tsf_voice_setgain(v, v->noteGainDB + c->gainDB);
 		tsf_voice_calcpitchratio(v, (c->pitchWheel == 8192 ? c->tuning : ((c->pitchWheel / 16383.0f * c->pitchRange * 2.0f) - c->pitchRange + c->tuning)), f->outSampleRate);
 		if (newpan <= -0.5f) { v->panFactorLeft = 1.0f; v->panFactorRight = 0.0f; }
 		else if (newpan >= 0.5f) { v->panFactorLeft = 0.0f; v->panFactorRight = 1.0f; }
@@ -1416,17 +2121,36 @@ extern "C" {
 			c->gainDB = 0.0f;
 			c->pitchRange = 2.0f;
 			c->tuning = 0.0f;
+			c->voices = TSF_NULL;
+			TSF_MEMSET(c->keyVoices, 0, sizeof(c->keyVoices));
+			c->voiceNum = 0;
 		}
 		return &f->channels->channels[channel];
 	}
 
-	static void tsf_channel_applypitch(tsf* f, int channel, struct tsf_channel* c)
+	// The channel if it has been set up, otherwise NULL (it then has no voices)
+	static struct tsf_channel* tsf_channel_find(tsf* f, int channel)
 	{
-		struct tsf_voice *v, *vEnd;
+		return (f->channels && channel >= 0 && channel < f->channels->channelNum ? &f->channels->channels[channel] : TSF_NULL);
+	}
+
+	static void tsf_channel_applypitch(tsf* f, struct tsf_channel* c)
+	{
+		struct tsf_voice *v;
 		float pitchShift = (c->pitchWheel == 8192 ? c->tuning : ((c->pitchWheel / 16383.0f * c->pitchRange * 2.0f) - c->pitchRange + c->tuning));
-		for (v = f->voices, vEnd = v + f->voiceNum; v != vEnd; v++)
-			if (v->playingChannel == channel && v->playingPreset != -1)
-				tsf_voice_calcpitchratio(v, pitchShift, f->outSampleRate);
+		for (v = c->voices; v; v = v->channelNext)
+			tsf_voice_calcpitchratio(v, pitchShift, f->outSampleRate);
+	}
+
+	TSFDEF int tsf_reserve_sample_channels(tsf* f, int count)
+	{
+		int i;
+		if (count < 1) return 1;
+		if (!tsf_presets_grow(f, count)) return 0;
+		for (i = 0; i < count; i++)
+			if (!tsf_preset_sample_region(&f->presets[i])) return 0;
+		tsf_channel_init(f, count - 1);
+		return (f->channels && f->channels->channels ? 1 : 0);
 	}
 
 	TSFDEF void tsf_channel_set_presetindex(tsf* f, int channel, int preset_index)
@@ -1470,7 +2194,7 @@ extern "C" {
 		struct tsf_channel *c = tsf_channel_init(f, channel);
 		if (c->pitchWheel == pitch_wheel) return;
 		c->pitchWheel = pitch_wheel;
-		tsf_channel_applypitch(f, channel, c);
+		tsf_channel_applypitch(f, c);
 	}
 
 	TSFDEF void tsf_channel_set_pitchrange(tsf* f, int channel, float pitch_range)
@@ -1478,7 +2202,7 @@ extern "C" {
 		struct tsf_channel *c = tsf_channel_init(f, channel);
 		if (c->pitchRange == pitch_range) return;
 		c->pitchRange = pitch_range;
-		if (c->pitchWheel != 8192) tsf_channel_applypitch(f, channel, c);
+		if (c->pitchWheel != 8192) tsf_channel_applypitch(f, c);
 	}
 
 	TSFDEF void tsf_channel_set_tuning(tsf* f, int channel, float tuning)
@@ -1486,32 +2210,31 @@ extern "C" {
 		struct tsf_channel *c = tsf_channel_init(f, channel);
 		if (c->tuning == tuning) return;
 		c->tuning = tuning;
-		tsf_channel_applypitch(f, channel, c);
+		tsf_channel_applypitch(f, c);
 	}
 
 	TSFDEF void tsf_channel_set_pan(tsf* f, int channel, float pan)
 	{
-		struct tsf_voice *v, *vEnd;
-		for (v = f->voices, vEnd = v + f->voiceNum; v != vEnd; v++)
-			if (v->playingChannel == channel && v->playingPreset != -1)
-			{
-				float newpan = v->region->pan + pan - 0.5f;
-				if (newpan <= -0.5f) { v->panFactorLeft = 1.0f; v->panFactorRight = 0.0f; }
-				else if (newpan >= 0.5f) { v->panFactorLeft = 0.0f; v->panFactorRight = 1.0f; }
-				else { v->panFactorLeft = TSF_SQRTF(0.5f - newpan); v->panFactorRight = TSF_SQRTF(0.5f + newpan); }
-			}
-		tsf_channel_init(f, channel)->panOffset = pan - 0.5f;
+		struct tsf_channel *c = tsf_channel_init(f, channel);
+		struct tsf_voice *v;
+		for (v = c->voices; v; v = v->channelNext)
+		{
+			float newpan = v->region->pan + pan - 0.5f;
+			if (newpan <= -0.5f) { v->panFactorLeft = 1.0f; v->panFactorRight = 0.0f; }
+			else if (newpan >= 0.5f) { v->panFactorLeft = 0.0f; v->panFactorRight = 1.0f; }
+			else { v->panFactorLeft = TSF_SQRTF(0.5f - newpan); v->panFactorRight = TSF_SQRTF(0.5f + newpan); }
+		}
+		c->panOffset = pan - 0.5f;
 	}
 
 	TSFDEF void tsf_channel_set_volume(tsf* f, int channel, float volume)
 	{
 		struct tsf_channel *c = tsf_channel_init(f, channel);
 		float gainDB = tsf_gainToDecibels(volume), gainDBChange = gainDB - c->gainDB;
-		struct tsf_voice *v, *vEnd;
+		struct tsf_voice *v;
 		if (gainDBChange == 0) return;
-		for (v = f->voices, vEnd = v + f->voiceNum; v != vEnd; v++)
-			if (v->playingChannel == channel && v->playingPreset != -1)
-				v->noteGainDB += gainDBChange;
+		for (v = c->voices; v; v = v->channelNext)
+			tsf_voice_setgain(v, v->noteGainDB + gainDBChange);
 		c->gainDB = gainDB;
 	}
 
@@ -1524,40 +2247,38 @@ extern "C" {
 
 	TSFDEF void tsf_channel_note_off(tsf* f, int channel, int key)
 	{
-		struct tsf_voice *v = f->voices, *vEnd = v + f->voiceNum, *vMatchFirst = TSF_NULL, *vMatchLast;
-		for (; v != vEnd; v++)
-		{
-			//Find the first and last entry in the voices list with matching channel, key and look up the smallest play index
-			if (v->playingPreset == -1 || v->playingChannel != channel || v->playingKey != key || v->ampenv.segment >= TSF_SEGMENT_RELEASE) continue;
-			else if (!vMatchFirst || v->playIndex < vMatchFirst->playIndex) vMatchFirst = vMatchLast = v;
-			else if (v->playIndex == vMatchFirst->playIndex) vMatchLast = v;
-		}
-		if (!vMatchFirst) return;
-		for (v = vMatchFirst; v <= vMatchLast; v++)
-		{
-			//Stop all voices with matching channel, key and the smallest play index which was enumerated above
-			if (v != vMatchFirst && v != vMatchLast &&
-				(v->playIndex != vMatchFirst->playIndex || v->playingPreset == -1 || v->playingChannel != channel || v->playingKey != key || v->ampenv.segment >= TSF_SEGMENT_RELEASE)) continue;
-			tsf_voice_end(v, f->outSampleRate);
-		}
+		struct tsf_channel *c = tsf_channel_find(f, channel);
+		struct tsf_voice *keyList, *oldest = TSF_NULL;
+		if (!c) return;
+		keyList = c->keyVoices[key & (TSF_KEY_LISTS - 1)];
+		tsf_keylist_find_oldest(keyList, -1, key, &oldest);
+		if (oldest) tsf_keylist_note_off(f, keyList, -1, key, oldest->playIndex);
 	}
 
 	TSFDEF void tsf_channel_note_off_all(tsf* f, int channel)
 	{
-		struct tsf_voice *v = f->voices, *vEnd = v + f->voiceNum;
-		for (; v != vEnd; v++)
-			if (v->playingPreset != -1 && v->playingChannel == channel && v->ampenv.segment < TSF_SEGMENT_RELEASE)
+		struct tsf_channel *c = tsf_channel_find(f, channel);
+		struct tsf_voice *v;
+		for (v = (c ? c->voices : TSF_NULL); v; v = v->channelNext)
+			if (v->ampenv.segment < TSF_SEGMENT_RELEASE)
 				tsf_voice_end(v, f->outSampleRate);
 	}
 
 	TSFDEF void tsf_channel_sounds_off_all(tsf* f, int channel)
 	{
-		struct tsf_voice *v = f->voices, *vEnd = v + f->voiceNum;
-		for (; v != vEnd; v++)
-			if (v->playingPreset != -1 && v->playingChannel == channel && (v->ampenv.segment < TSF_SEGMENT_RELEASE || v->ampenv.parameters.release))
+		struct tsf_channel *c = tsf_channel_find(f, channel);
+		struct tsf_voice *v;
+		for (v = (c ? c->voices : TSF_NULL); v; v = v->channelNext)
+			if (v->ampenv.segment < TSF_SEGMENT_RELEASE || v->ampenv.parameters.release)
 				tsf_voice_endquick(v, f->outSampleRate);
 	}
 
+	TSFDEF void tsf_channel_kill_all(tsf* f, int channel)
+	{
+		struct tsf_channel *c = tsf_channel_find(f, channel);
+		if (c) while (c->voices) tsf_voice_kill(f, c->voices);
+	}
+
 	TSFDEF void tsf_channel_midi_control(tsf* f, int channel, int controller, int control_value)
 	{
 		struct tsf_channel* c = tsf_channel_init(f, channel);
@@ -1633,6 +2354,12 @@ extern "C" {
 		return (f->channels && channel < f->channels->channelNum ? tsf_decibelsToGain(f->channels->channels[channel].gainDB) : 1.0f);
 	}
 
+	TSFDEF int tsf_channel_get_voicecount(tsf* f, int channel)
+	{
+		struct tsf_channel *c = tsf_channel_find(f, channel);
+		return (c ? c->voiceNum : 0);
+	}
+
 #ifdef __cplusplus
 }
 #endif
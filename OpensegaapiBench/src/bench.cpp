@@ -0,0 +1,569 @@
+// bench.cpp - Benchmark suite for the SEGAAPI export surface
+//
+// This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+//
+// Usage: OpensegaapiBench [--out results.json] [--filter name] [--label text] [--quick]
+// Results are written as JSON (stdout by default) so runs can be diffed across commits.
+
+extern "C" {
+#include "opensegaapi.h"
+}
+
+// The synth engine is header-only; a private copy lets the synth benchmark
+// drive its render kernels directly
+#define TSF_IMPLEMENTATION
+#include "tsf.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ======================================================================
+// Timing helpers
+// ======================================================================
+typedef std::chrono::steady_clock benchClock;
+
+static double elapsedNs(benchClock::time_point start, benchClock::time_point end) {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+// Total user + kernel time consumed by the whole process (all threads, including the mixer)
+static double processCpuNs() {
+#ifdef _WIN32
+    FILETIME creation, exitTime, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user)) return 0.0;
+    auto toNs = [](const FILETIME& ft) {
+        return (static_cast<double>(ft.dwHighDateTime) * 4294967296.0 + ft.dwLowDateTime) * 100.0;
+    };
+    return toNs(kernel) + toNs(user);
+#else
+    timespec cpu;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu) != 0) return 0.0;
+    return static_cast<double>(cpu.tv_sec) * 1e9 + cpu.tv_nsec;
+#endif
+}
+
+// ======================================================================
+// Results
+// ======================================================================
+struct BenchResult {
+    std::string name;
+    std::vector<std::pair<std::string, double>> params;
+    std::vector<std::pair<std::string, double>> metrics;
+};
+
+static std::vector<BenchResult> g_results;
+static bool g_quick = false;
+
+// Summarises per-sample costs (ns per operation) into the usual metrics
+static void addSampleMetrics(BenchResult& result, std::vector<double> samples, unsigned int opsPerSample) {
+    if (samples.empty()) return;
+    std::sort(samples.begin(), samples.end());
+    double total = 0.0;
+    for (double s : samples) total += s;
+    result.metrics.push_back({ "iterations", static_cast<double>(samples.size()) * opsPerSample });
+    result.metrics.push_back({ "mean_ns", total / samples.size() });
+    result.metrics.push_back({ "min_ns", samples.front() });
+    result.metrics.push_back({ "median_ns", samples[samples.size() / 2] });
+    result.metrics.push_back({ "p99_ns", samples[std::min(samples.size() - 1, samples.size() * 99 / 100)] });
+    result.metrics.push_back({ "max_ns", samples.back() });
+}
+
+static void writeJsonString(FILE* out, const std::string& s) {
+    fputc('"', out);
+    for (char c : s) {
+        if (c == '"' || c == '\\') fputc('\\', out);
+        fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void writeJson(FILE* out, const std::string& label) {
+    char stamp[32];
+    time_t now = time(nullptr);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(out, "{\n  \"schema\": 1,\n  \"timestamp\": \"%s\",\n  \"label\": ", stamp);
+    writeJsonString(out, label);
+    fprintf(out, ",\n  \"pointer_bits\": %d,\n  \"results\": [\n", static_cast<int>(sizeof(void*) * 8));
+    for (size_t i = 0; i < g_results.size(); i++) {
+        const BenchResult& r = g_results[i];
+        fprintf(out, "    { \"name\": ");
+        writeJsonString(out, r.name);
+        fprintf(out, ", \"params\": {");
+        for (size_t j = 0; j < r.params.size(); j++) {
+            fprintf(out, "%s ", j ? "," : "");
+            writeJsonString(out, r.params[j].first);
+            fprintf(out, ": %.0f", r.params[j].second);
+        }
+        fprintf(out, " }, \"metrics\": {");
+        for (size_t j = 0; j < r.metrics.size(); j++) {
+            fprintf(out, "%s ", j ? "," : "");
+            writeJsonString(out, r.metrics[j].first);
+            fprintf(out, ": %.3f", r.metrics[j].second);
+        }
+        fprintf(out, " } }%s\n", i + 1 < g_results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+// ======================================================================
+// Buffer helpers
+// ======================================================================
+static const unsigned int BENCH_SAMPLE_RATE = 48000;
+
+static OPEN_HAWOSEBUFFERCONFIG makeConfig(unsigned int size, unsigned int channels, void* userMem) {
+    OPEN_HAWOSEBUFFERCONFIG config = {};
+    config.dwPriority = 0;
+    config.dwSampleRate = BENCH_SAMPLE_RATE;
+    config.dwSampleFormat = OPEN_HASF_SIGNED_16PCM;
+    config.byNumChans = channels;
+    config.mapData.dwSize = size;
+    config.mapData.hBufferHdr = userMem;
+    return config;
+}
+
+// Deterministic noise so runs are comparable
+static void fillNoise(void* data, unsigned int size, uint32_t seed) {
+    auto* samples = static_cast<int16_t*>(data);
+    for (unsigned int i = 0; i < size / 2; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        samples[i] = static_cast<int16_t>(seed >> 16) / 4;
+    }
+}
+
+static void* createFilledBuffer(unsigned int size, unsigned int channels, uint32_t seed) {
+    OPEN_HAWOSEBUFFERCONFIG config = makeConfig(size, channels, nullptr);
+    void* handle = nullptr;
+    if (SEGAAPI_CreateBuffer(&config, nullptr, 0, &handle) != OPEN_SEGA_SUCCESS) return nullptr;
+    fillNoise(config.mapData.hBufferHdr, size, seed);
+    SEGAAPI_UpdateBuffer(handle, 0, size);
+    return handle;
+}
+
+// ======================================================================
+// Benchmarks
+// ======================================================================
+static void benchCreateDestroy(bool userMem, unsigned int size) {
+    const unsigned int samples = g_quick ? 20 : 100;
+    const unsigned int opsPerSample = 16;
+    std::vector<uint8_t> memory(userMem ? size : 0);
+    std::vector<double> costs;
+    void* handles[opsPerSample];
+
+    for (unsigned int s = 0; s < samples; s++) {
+        auto start = benchClock::now();
+        for (unsigned int i = 0; i < opsPerSample; i++) {
+            OPEN_HAWOSEBUFFERCONFIG config = makeConfig(size, 2, userMem ? memory.data() : nullptr);
+            SEGAAPI_CreateBuffer(&config, nullptr, userMem ? OPEN_HABUF_ALLOC_USER_MEM : 0, &handles[i]);
+        }
+        for (unsigned int i = 0; i < opsPerSample; i++) {
+            SEGAAPI_DestroyBuffer(handles[i]);
+        }
+        costs.push_back(elapsedNs(start, benchClock::now()) / opsPerSample);
+    }
+
+    BenchResult result;
+    result.name = userMem ? "create_destroy_user_mem" : "create_destroy";
+    result.params.push_back({ "size_bytes", static_cast<double>(size) });
+    addSampleMetrics(result, costs, opsPerSample);
+    g_results.push_back(result);
+}
+
+static void benchUpdateBuffer(unsigned int rangeSize) {
+    const unsigned int bufferSize = 1024 * 1024;
+    const unsigned int samples = g_quick ? 20 : 100;
+    const unsigned int opsPerSample = std::max(1u, (256u * 1024u) / rangeSize);
+    void* handle = createFilledBuffer(bufferSize, 2, 1);
+    if (!handle) return;
+
+    std::vector<double> costs;
+    unsigned int offset = 0;
+    for (unsigned int s = 0; s < samples; s++) {
+        auto start = benchClock::now();
+        for (unsigned int i = 0; i < opsPerSample; i++) {
+            SEGAAPI_UpdateBuffer(handle, offset, rangeSize);
+            offset = (offset + rangeSize) % bufferSize;
+        }
+        costs.push_back(elapsedNs(start, benchClock::now()) / opsPerSample);
+    }
+    SEGAAPI_DestroyBuffer(handle);
+
+    BenchResult result;
+    result.name = "update_buffer";
+    result.params.push_back({ "buffer_bytes", static_cast<double>(bufferSize) });
+    result.params.push_back({ "range_bytes", static_cast<double>(rangeSize) });
+    addSampleMetrics(result, costs, opsPerSample);
+    std::sort(costs.begin(), costs.end());
+    double medianNs = costs[costs.size() / 2];
+    result.metrics.push_back({ "median_mb_per_s", medianNs > 0.0 ? rangeSize / medianNs * 1000.0 : 0.0 });
+    g_results.push_back(result);
+}
+
+static void benchPlayWithSetup() {
+    const unsigned int samples = g_quick ? 200 : 2000;
+    void* handle = createFilledBuffer(BENCH_SAMPLE_RATE * 4, 2, 2);
+    if (!handle) return;
+
+    // A typical one-shot setup: stereo routing, levels, loop points and attenuation/pitch
+    OPEN_SendRouteParamSet routes[2] = { { 0, 0, OPEN_HA_FRONT_LEFT_PORT }, { 1, 1, OPEN_HA_FRONT_RIGHT_PORT } };
+    OPEN_SendLevelParamSet levels[2] = { { 0, 0, 0xFFFFFFFF }, { 1, 1, 0xFFFFFFFF } };
+    OPEN_VoiceParamSet voice[3] = {
+        { OPEN_VOICEIOCTL_SET_START_LOOP_OFFSET, 0, 0 },
+        { OPEN_VOICEIOCTL_SET_END_LOOP_OFFSET, BENCH_SAMPLE_RATE * 4, 0 },
+        { OPEN_VOICEIOCTL_SET_LOOP_STATE, 0, 0 }
+    };
+    OPEN_SynthParamSet synth[2] = { { OPEN_HAVP_ATTENUATION, 0 }, { OPEN_HAVP_PITCH, 0 } };
+
+    std::vector<double> costs;
+    for (unsigned int s = 0; s < samples; s++) {
+        auto start = benchClock::now();
+        SEGAAPI_PlayWithSetup(handle, 2, routes, 2, levels, 3, voice, 2, synth);
+        costs.push_back(elapsedNs(start, benchClock::now()));
+        SEGAAPI_SetReleaseState(handle, 1);
+    }
+    SEGAAPI_DestroyBuffer(handle);
+
+    BenchResult result;
+    result.name = "play_with_setup";
+    addSampleMetrics(result, costs, 1);
+    g_results.push_back(result);
+}
+
+enum BenchSetter {
+    SETTER_ATTENUATION,
+    SETTER_PITCH,
+    SETTER_SEND_LEVEL,
+    SETTER_CHANNEL_VOLUME,
+    SETTER_SAMPLE_RATE,
+    GETTER_PLAYBACK_POSITION,
+    SETTER_COUNT
+};
+
+static const char* const g_setterNames[SETTER_COUNT] = {
+    "set_synth_param_attenuation",
+    "set_synth_param_pitch",
+    "set_send_level",
+    "set_channel_volume",
+    "set_sample_rate",
+    "get_playback_position"
+};
+
+static void benchSetter(BenchSetter setter) {
+    const unsigned int samples = g_quick ? 20 : 100;
+    const unsigned int opsPerSample = 256;
+    void* handle = createFilledBuffer(BENCH_SAMPLE_RATE * 4, 2, 3);
+    if (!handle) return;
+    SEGAAPI_SetLoopState(handle, 1);
+    SEGAAPI_Play(handle);
+
+    std::vector<double> costs;
+    volatile unsigned int sink = 0;
+    for (unsigned int s = 0; s < samples; s++) {
+        auto start = benchClock::now();
+        for (unsigned int i = 0; i < opsPerSample; i++) {
+            switch (setter) {
+                case SETTER_ATTENUATION:
+                    SEGAAPI_SetSynthParam(handle, OPEN_HAVP_ATTENUATION, i & 0xFF);
+                    break;
+                case SETTER_PITCH:
+                    SEGAAPI_SetSynthParam(handle, OPEN_HAVP_PITCH, static_cast<int>(i & 0xFF) - 128);
+                    break;
+                case SETTER_SEND_LEVEL:
+                    SEGAAPI_SetSendLevel(handle, 0, 0, 0xFFFFFFFF - i);
+                    break;
+                case SETTER_CHANNEL_VOLUME:
+                    SEGAAPI_SetChannelVolume(handle, 0, 0xFFFFFFFF - i);
+                    break;
+                case SETTER_SAMPLE_RATE:
+                    SEGAAPI_SetSampleRate(handle, 44100 + (i & 0xFF) * 16);
+                    break;
+                case GETTER_PLAYBACK_POSITION:
+                    sink = sink + SEGAAPI_GetPlaybackPosition(handle);
+                    break;
+                default:
+                    break;
+            }
+        }
+        costs.push_back(elapsedNs(start, benchClock::now()) / opsPerSample);
+    }
+    SEGAAPI_DestroyBuffer(handle);
+
+    BenchResult result;
+    result.name = g_setterNames[setter];
+    addSampleMetrics(result, costs, opsPerSample);
+    g_results.push_back(result);
+}
+
+// ======================================================================
+// Device bring-up
+// (SEGAAPI_Init returns before the device is open; wait for it so the
+// other benchmarks run against a started mixer, and report its phases.)
+// ======================================================================
+static bool waitForDevice(OPEN_HASTARTUPTIMINGS* timings) {
+    while (SEGAAPI_GetStartupTimings(timings) == OPEN_SEGA_SUCCESS && timings->dwState == OPEN_HASTARTUP_OPENING)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return timings->dwState == OPEN_HASTARTUP_READY;
+}
+
+static void benchStartup(const OPEN_HASTARTUPTIMINGS& timings) {
+    BenchResult result;
+    result.name = "startup";
+    result.metrics.push_back({ "init_us", static_cast<double>(timings.dwInitUs) });
+    result.metrics.push_back({ "open_device_us", static_cast<double>(timings.dwOpenDeviceUs) });
+    result.metrics.push_back({ "create_context_us", static_cast<double>(timings.dwCreateContextUs) });
+    result.metrics.push_back({ "start_mixer_us", static_cast<double>(timings.dwStartMixerUs) });
+    result.metrics.push_back({ "ready_us", static_cast<double>(timings.dwReadyUs) });
+    g_results.push_back(result);
+}
+
+// Position polling for many streaming buffers: one call per buffer vs one bulk call
+static void benchPositions(unsigned int bufferCount) {
+    const unsigned int samples = g_quick ? 20 : 200;
+    std::vector<void*> handles;
+    for (unsigned int i = 0; i < bufferCount; i++) {
+        void* handle = createFilledBuffer(BENCH_SAMPLE_RATE, 1, 10 + i);
+        if (!handle) break;
+        SEGAAPI_SetLoopState(handle, 1);
+        SEGAAPI_Play(handle);
+        handles.push_back(handle);
+    }
+    std::vector<unsigned int> positions(handles.size());
+
+    std::vector<double> single, bulk;
+    volatile unsigned int sink = 0;
+    for (unsigned int s = 0; s < samples; s++) {
+        auto start = benchClock::now();
+        for (void* handle : handles) sink = sink + SEGAAPI_GetPlaybackPosition(handle);
+        auto middle = benchClock::now();
+        SEGAAPI_GetPlaybackPositions(static_cast<unsigned int>(handles.size()), handles.data(), positions.data());
+        auto end = benchClock::now();
+        single.push_back(elapsedNs(start, middle));
+        bulk.push_back(elapsedNs(middle, end));
+    }
+    for (void* handle : handles) SEGAAPI_DestroyBuffer(handle);
+
+    BenchResult result;
+    result.name = "get_playback_positions";
+    result.params.push_back({ "buffers", static_cast<double>(handles.size()) });
+    addSampleMetrics(result, bulk, 1);
+    std::sort(single.begin(), single.end());
+    result.metrics.push_back({ "single_calls_median_ns", single[single.size() / 2] });
+    g_results.push_back(result);
+}
+
+// Measures how much CPU the whole process burns while N looping voices play.
+// The caller thread sleeps, so the cost is the mixer thread.
+static double measureCpuPercent(double windowMs) {
+    double cpuStart = processCpuNs();
+    auto start = benchClock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(windowMs));
+    double wallNs = elapsedNs(start, benchClock::now());
+    double cpuNs = processCpuNs() - cpuStart;
+    return wallNs > 0.0 ? cpuNs / wallNs * 100.0 : 0.0;
+}
+
+static void benchMixer(unsigned int voiceCount, double idlePercent) {
+    const double windowMs = g_quick ? 250.0 : 1000.0;
+    const unsigned int size = BENCH_SAMPLE_RATE * 2 * 2; // 2 seconds of 48 kHz mono 16-bit
+    std::vector<void*> handles;
+
+    for (unsigned int i = 0; i < voiceCount; i++) {
+        void* handle = createFilledBuffer(size, 1, 100 + i);
+        if (!handle) break;
+        SEGAAPI_SetLoopState(handle, 1);
+        SEGAAPI_SetSynthParam(handle, OPEN_HAVP_ATTENUATION, 400);
+        // Spread pitches so voices do not share the resampler fast path
+        SEGAAPI_SetSynthParam(handle, OPEN_HAVP_PITCH, static_cast<int>(i % 25) * 8 - 100);
+        SEGAAPI_Play(handle);
+        handles.push_back(handle);
+    }
+
+    // Per-frame game-side work at 60 Hz: poll position and nudge pitch on every voice
+    std::vector<double> frameCosts;
+    for (unsigned int frame = 0; frame < (g_quick ? 15u : 60u); frame++) {
+        auto start = benchClock::now();
+        for (size_t i = 0; i < handles.size(); i++) {
+            SEGAAPI_GetPlaybackPosition(handles[i]);
+            SEGAAPI_SetSynthParam(handles[i], OPEN_HAVP_PITCH, static_cast<int>((i + frame) % 25) * 8 - 100);
+        }
+        frameCosts.push_back(elapsedNs(start, benchClock::now()));
+    }
+
+    SEGAAPI_ResetMixerTelemetry();
+    double cpuPercent = measureCpuPercent(windowMs);
+    OPEN_HAMIXERTELEMETRY telemetry = {};
+    SEGAAPI_GetMixerTelemetry(&telemetry);
+
+    for (void* handle : handles) {
+        SEGAAPI_DestroyBuffer(handle);
+    }
+
+    BenchResult result;
+    result.name = "mixer_voices";
+    result.params.push_back({ "voices", static_cast<double>(handles.size()) });
+    addSampleMetrics(result, frameCosts, 1);
+    result.metrics.push_back({ "process_cpu_percent", cpuPercent });
+    result.metrics.push_back({ "mixer_cpu_percent", std::max(0.0, cpuPercent - idlePercent) });
+    result.metrics.push_back({ "cpu_ns_per_voice_second", handles.empty() ? 0.0 :
+        std::max(0.0, cpuPercent - idlePercent) / 100.0 * 1e9 / handles.size() });
+    result.metrics.push_back({ "render_ns_avg", static_cast<double>(telemetry.dwRenderNsAvg) });
+    result.metrics.push_back({ "render_ns_max", static_cast<double>(telemetry.dwRenderNsMax) });
+    result.metrics.push_back({ "headroom_percent", telemetry.fHeadroomPercent });
+    result.metrics.push_back({ "underruns", static_cast<double>(telemetry.qwUnderruns) });
+    g_results.push_back(result);
+}
+
+// ======================================================================
+// Synth render kernels
+// (Renders the TinySoundFont engine directly, without the mixer, so the cost
+// per voice sample of each vector kernel can be compared with the scalar one.)
+// ======================================================================
+static void benchSynthRender(unsigned int voiceCount, bool lowpass) {
+    const unsigned int periodFrames = 256;
+    const unsigned int periods = g_quick ? 40 : 200;
+    std::vector<short> samples(BENCH_SAMPLE_RATE + 1, 0);
+    fillNoise(samples.data(), BENCH_SAMPLE_RATE * 2, 7);
+    const unsigned short generators[] = { 8 };  // initialFilterFc
+    const short amounts[] = { 9000 };
+
+    std::vector<float> reference;
+    double scalarMeanNs = 0.0;
+    for (int kernel = TSF_KERNEL_SCALAR; kernel <= TSF_KERNEL_AVX2; kernel++) {
+        tsf* synth = tsf_create();
+        if (!synth) return;
+        if (tsf_set_render_kernel(synth, static_cast<TSFRenderKernel>(kernel)) != kernel) {
+            tsf_close(synth);
+            continue;
+        }
+        tsf_set_output(synth, TSF_STEREO_INTERLEAVED, BENCH_SAMPLE_RATE, 0.0f);
+        tsf_set_sample_preset(synth, 0, samples.data(), BENCH_SAMPLE_RATE, BENCH_SAMPLE_RATE, 0, BENCH_SAMPLE_RATE - 1,
+            generators, amounts, lowpass ? 1 : 0);
+        // Keys two octaves apart around the root, so voices resample at different ratios
+        for (unsigned int i = 0; i < voiceCount; i++) tsf_note_on(synth, 0, 48 + static_cast<int>(i % 25), 1.0f);
+
+        std::vector<float> output(static_cast<size_t>(periods) * periodFrames * 2);
+        std::vector<double> sampleCosts;
+        for (unsigned int period = 0; period < periods; period++) {
+            auto start = benchClock::now();
+            tsf_render_float(synth, &output[static_cast<size_t>(period) * periodFrames * 2], periodFrames, 0);
+            sampleCosts.push_back(elapsedNs(start, benchClock::now()) / (periodFrames * voiceCount));
+        }
+        tsf_close(synth);
+
+        double meanNs = 0.0, maxDiff = 0.0;
+        for (double cost : sampleCosts) meanNs += cost;
+        meanNs /= sampleCosts.size();
+        if (kernel == TSF_KERNEL_SCALAR) {
+            reference = output;
+            scalarMeanNs = meanNs;
+        } else if (!reference.empty()) {
+            for (size_t i = 0; i < output.size(); i++) maxDiff = std::max(maxDiff, static_cast<double>(std::fabs(output[i] - reference[i])));
+        }
+
+        BenchResult result;
+        result.name = "synth_render";
+        result.params.push_back({ "voices", static_cast<double>(voiceCount) });
+        result.params.push_back({ "lowpass", lowpass ? 1.0 : 0.0 });
+        result.params.push_back({ "kernel", static_cast<double>(kernel) });  // 0 scalar, 1 SSE2, 2 AVX2
+        addSampleMetrics(result, sampleCosts, periodFrames * voiceCount);
+        result.metrics.push_back({ "speedup_vs_scalar", meanNs > 0.0 ? scalarMeanNs / meanNs : 0.0 });
+        // Largest output difference in 16 bit steps (the vector kernels step positions in float)
+        result.metrics.push_back({ "max_diff_vs_scalar_lsb", maxDiff * 32768.0 });
+        g_results.push_back(result);
+    }
+}
+
+// ======================================================================
+// Entry point
+// ======================================================================
+static bool matchesFilter(const char* filter, const char* name) {
+    return !filter || strstr(name, filter) != nullptr;
+}
+
+int main(int argc, char** argv) {
+    const char* outPath = nullptr;
+    const char* filter = nullptr;
+    std::string label;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--out") && i + 1 < argc) outPath = argv[++i];
+        else if (!strcmp(argv[i], "--filter") && i + 1 < argc) filter = argv[++i];
+        else if (!strcmp(argv[i], "--label") && i + 1 < argc) label = argv[++i];
+        else if (!strcmp(argv[i], "--quick")) g_quick = true;
+        else {
+            fprintf(stderr, "Usage: %s [--out results.json] [--filter name] [--label text] [--quick]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (SEGAAPI_Init() != OPEN_SEGA_SUCCESS) {
+        fprintf(stderr, "SEGAAPI_Init failed (0x%08X)\n", static_cast<unsigned int>(SEGAAPI_GetLastStatus()));
+        return 1;
+    }
+    OPEN_HASTARTUPTIMINGS timings = {};
+    if (!waitForDevice(&timings)) {
+        fprintf(stderr, "Could not open the audio device\n");
+        return 1;
+    }
+    if (matchesFilter(filter, "startup")) {
+        benchStartup(timings);
+    }
+
+    if (matchesFilter(filter, "create_destroy")) {
+        benchCreateDestroy(false, 64 * 1024);
+        benchCreateDestroy(false, 1024 * 1024);
+        benchCreateDestroy(true, 64 * 1024);
+    }
+    if (matchesFilter(filter, "update_buffer")) {
+        const unsigned int ranges[] = { 256, 4 * 1024, 64 * 1024, 1024 * 1024 };
+        for (unsigned int range : ranges) benchUpdateBuffer(range);
+    }
+    if (matchesFilter(filter, "play_with_setup")) {
+        benchPlayWithSetup();
+    }
+    for (int setter = 0; setter < SETTER_COUNT; setter++) {
+        if (matchesFilter(filter, g_setterNames[setter])) benchSetter(static_cast<BenchSetter>(setter));
+    }
+    if (matchesFilter(filter, "get_playback_positions")) {
+        benchPositions(16);
+        benchPositions(128);
+    }
+    if (matchesFilter(filter, "mixer_voices")) {
+        double idlePercent = measureCpuPercent(g_quick ? 250.0 : 1000.0);
+        const unsigned int voiceCounts[] = { 16, 32, 64, 128, 256, 512 };
+        for (unsigned int voices : voiceCounts) benchMixer(voices, idlePercent);
+    }
+    if (matchesFilter(filter, "synth_render")) {
+        const unsigned int voiceCounts[] = { 16, 128 };
+        for (unsigned int voices : voiceCounts) {
+            benchSynthRender(voices, false);
+            benchSynthRender(voices, true);
+        }
+    }
+
+    SEGAAPI_Exit();
+
+    FILE* out = outPath ? fopen(outPath, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Could not open %s\n", outPath);
+        return 1;
+    }
+    writeJson(out, label);
+    if (out != stdout) fclose(out);
+    return 0;
+}
@@ -0,0 +1,16 @@
+project "OpensegaapiExitTest"
+	targetname "OpensegaapiExitTest"
+	language "C++"
+	kind "ConsoleApp"
+	if os.istarget("windows") then
+		removeplatforms { "x64" }
+	end
+
+	files
+	{
+		"src/**.cpp", "src/**.h"
+	}
+
+	includedirs { "src", "../Opensegaapi/src" }
+
+	links { "Opensegaapi" }
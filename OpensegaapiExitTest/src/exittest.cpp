@@ -0,0 +1,75 @@
+// exittest.cpp - Quitting without SEGAAPI_Exit
+//
+// This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+//
+// Usage: OpensegaapiExitTest
+// Starts every thread the library can run (device bring-up, mixer and its
+// helpers, trace writer, statistics dump), plays a buffer and returns from
+// main without calling SEGAAPI_Exit, as many games do. Passes when the
+// process exits with 0; a thread left running into static destruction
+// aborts it instead.
+
+extern "C" {
+#include "opensegaapi.h"
+}
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+// Static, since the mixer keeps reading it after main returns
+static short g_samples[48000];
+
+static void setOption(const char* name, const char* value) {
+#ifdef _WIN32
+    _putenv_s(name, value);
+#else
+    setenv(name, value, 1);
+#endif
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 1;
+    }
+    std::string trace = std::string(argv[0]) + ".trc";
+    setOption("OPENSEGAAPI_TRACE", trace.c_str());
+    setOption("OPENSEGAAPI_STATS_DUMP", "1");
+    setOption("OPENSEGAAPI_MIXER_THREADS", "2");
+
+    if (SEGAAPI_Init() != OPEN_SEGA_SUCCESS) {
+        fprintf(stderr, "SEGAAPI_Init failed (0x%08X)\n", static_cast<unsigned int>(SEGAAPI_GetLastStatus()));
+        return 1;
+    }
+    OPEN_HASTARTUPTIMINGS timings = {};
+    while (SEGAAPI_GetStartupTimings(&timings) == OPEN_SEGA_SUCCESS && timings.dwState == OPEN_HASTARTUP_OPENING)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (timings.dwState != OPEN_HASTARTUP_READY) {
+        fprintf(stderr, "Could not open the audio device\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < sizeof(g_samples) / sizeof(g_samples[0]); i++) g_samples[i] = static_cast<short>((i % 100) * 300 - 15000);
+    OPEN_HAWOSEBUFFERCONFIG config = {};
+    config.dwSampleRate = 48000;
+    config.dwSampleFormat = OPEN_HASF_SIGNED_16PCM;
+    config.byNumChans = 1;
+    config.mapData.dwSize = sizeof(g_samples);
+    config.mapData.hBufferHdr = g_samples;
+    void* handle = nullptr;
+    if (SEGAAPI_CreateBuffer(&config, nullptr, OPEN_HABUF_ALLOC_USER_MEM, &handle) != OPEN_SEGA_SUCCESS ||
+        SEGAAPI_SetLoopState(handle, 1) != OPEN_SEGA_SUCCESS ||
+        SEGAAPI_Play(handle) != OPEN_SEGA_SUCCESS) {
+        fprintf(stderr, "Could not play a buffer (0x%08X)\n", static_cast<unsigned int>(SEGAAPI_GetLastStatus()));
+        return 1;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // The buffer is still playing and SEGAAPI_Exit is never called
+    printf("OpensegaapiExitTest: returning from main\n");
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,408 @@
+// replay.cpp - Deterministic replayer for SEGAAPI call traces
+//
+// This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+//
+// Usage: OpensegaapiReplay <trace file> [--fast] [--loops N]
+// Feeds a trace recorded with OPENSEGAAPI_TRACE back into the library, in
+// recorded order on a single thread. By default calls are issued at their
+// recorded times so the mixer sees the same load as the real session;
+// --fast issues them back to back.
+
+extern "C" {
+#include "opensegaapi.h"
+}
+
+#include "exports.h"
+#include "tracefmt.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+typedef std::chrono::steady_clock replayClock;
+
+// ======================================================================
+// Replay state
+// ======================================================================
+struct ReplayBlob {
+    const uint8_t* data;
+    size_t size;
+};
+
+struct ReplayHandle {
+    void* handle;
+    uint8_t* data;
+    unsigned int size;
+    std::vector<uint8_t> userMem;
+};
+
+struct ReplayOpStats {
+    uint64_t calls;
+    double totalNs;
+    double maxNs;
+};
+
+static std::vector<ReplayBlob> g_blobs;
+static std::unordered_map<int64_t, ReplayHandle> g_handles;
+static ReplayOpStats g_opStats[EXPORT_COUNT];
+
+static ReplayHandle* findHandle(int64_t id) {
+    auto it = g_handles.find(id);
+    return it != g_handles.end() ? &it->second : nullptr;
+}
+
+static void* handleOf(int64_t id) {
+    ReplayHandle* entry = findHandle(id);
+    return entry ? entry->handle : nullptr;
+}
+
+// Sample time the given number of frames ahead of the audio clock
+static unsigned long long replayClockPlus(int64_t lead) {
+    unsigned long long now = 0;
+    SEGAAPI_GetAudioClock(&now);
+    return now + static_cast<unsigned long long>(lead);
+}
+
+// Waits until the background device open finished
+static void replayWaitForDevice() {
+    OPEN_HASTARTUPTIMINGS timings = {};
+    while (SEGAAPI_GetStartupTimings(&timings) == OPEN_SEGA_SUCCESS && timings.dwState == OPEN_HASTARTUP_OPENING)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+// ======================================================================
+// Dispatch of a single recorded call
+// ======================================================================
+static void replayCall(OPEN_EXPORT op, const int64_t* a, unsigned int argc, const ReplayBlob* blob) {
+    // Missing trailing arguments read as zero rather than out of bounds
+    int64_t args[TRACE_MAX_ARGS] = {};
+    memcpy(args, a, std::min(argc, static_cast<unsigned int>(TRACE_MAX_ARGS)) * sizeof(int64_t));
+    unsigned int u1 = static_cast<unsigned int>(args[1]);
+    unsigned int u2 = static_cast<unsigned int>(args[2]);
+    unsigned int u3 = static_cast<unsigned int>(args[3]);
+    void* h = handleOf(args[0]);
+
+    switch (op) {
+        case EXPORT_Init:
+            // Wait for the device, so timed calls that follow see a running clock
+            if (SEGAAPI_Init() == OPEN_SEGA_SUCCESS) replayWaitForDevice();
+            break;
+        case EXPORT_Exit: SEGAAPI_Exit(); break;
+        case EXPORT_CreateBuffer: {
+            ReplayHandle entry = {};
+            OPEN_HAWOSEBUFFERCONFIG config = {};
+            unsigned int flags = static_cast<unsigned int>(args[6]);
+            config.dwPriority = u1;
+            config.dwSampleRate = u2;
+            config.dwSampleFormat = u3;
+            config.byNumChans = static_cast<unsigned int>(args[4]);
+            config.mapData.dwSize = static_cast<unsigned int>(args[5]);
+            if (flags & (OPEN_HABUF_ALLOC_USER_MEM | OPEN_HABUF_USE_MAPPED_MEM)) {
+                entry.userMem.resize(config.mapData.dwSize);
+                if (blob) memcpy(entry.userMem.data(), blob->data, std::min<size_t>(blob->size, entry.userMem.size()));
+                config.mapData.hBufferHdr = entry.userMem.data();
+            }
+            if (SEGAAPI_CreateBuffer(&config, nullptr, flags, &entry.handle) == OPEN_SEGA_SUCCESS) {
+                entry.data = static_cast<uint8_t*>(config.mapData.hBufferHdr);
+                entry.size = config.mapData.dwSize;
+                g_handles[args[0]] = std::move(entry);
+            }
+            break;
+        }
+        case EXPORT_CreateInstance: {
+            // Writes through either handle land in the same samples
+            ReplayHandle* source = findHandle(args[1]);
+            ReplayHandle entry = {};
+            if (source && SEGAAPI_CreateInstance(source->handle, &entry.handle) == OPEN_SEGA_SUCCESS) {
+                entry.data = source->data;
+                entry.size = source->size;
+                g_handles[args[0]] = std::move(entry);
+            }
+            break;
+        }
+        case EXPORT_DestroyBuffer:
+            SEGAAPI_DestroyBuffer(h);
+            g_handles.erase(args[0]);
+            break;
+        case EXPORT_SetUserData: SEGAAPI_SetUserData(h, nullptr); break;
+        case EXPORT_GetUserData: SEGAAPI_GetUserData(h); break;
+        case EXPORT_SetFormat: {
+            OPEN_HAWOSEFORMAT format = { u1, u2, u3 };
+            SEGAAPI_SetFormat(h, &format);
+            break;
+        }
+        case EXPORT_GetFormat: {
+            OPEN_HAWOSEFORMAT format;
+            SEGAAPI_GetFormat(h, &format);
+            break;
+        }
+        case EXPORT_SetSampleRate: SEGAAPI_SetSampleRate(h, u1); break;
+        case EXPORT_GetSampleRate: SEGAAPI_GetSampleRate(h); break;
+        case EXPORT_SetPriority: SEGAAPI_SetPriority(h, u1); break;
+        case EXPORT_GetPriority: SEGAAPI_GetPriority(h); break;
+        case EXPORT_SetSendRouting: SEGAAPI_SetSendRouting(h, u1, u2, static_cast<OPEN_HAROUTING>(args[3])); break;
+        case EXPORT_GetSendRouting: SEGAAPI_GetSendRouting(h, u1, u2); break;
+        case EXPORT_SetSendLevel: SEGAAPI_SetSendLevel(h, u1, u2, u3); break;
+        case EXPORT_GetSendLevel: SEGAAPI_GetSendLevel(h, u1, u2); break;
+        case EXPORT_SetChannelVolume: SEGAAPI_SetChannelVolume(h, u1, u2); break;
+        case EXPORT_GetChannelVolume: SEGAAPI_GetChannelVolume(h, u1); break;
+        case EXPORT_SetPlaybackPosition: SEGAAPI_SetPlaybackPosition(h, u1); break;
+        case EXPORT_GetPlaybackPosition: SEGAAPI_GetPlaybackPosition(h); break;
+        case EXPORT_SetNotificationFrequency: SEGAAPI_SetNotificationFrequency(h, u1); break;
+        case EXPORT_SetNotificationPoint: SEGAAPI_SetNotificationPoint(h, u1); break;
+        case EXPORT_ClearNotificationPoint: SEGAAPI_ClearNotificationPoint(h, u1); break;
+        case EXPORT_SetStartLoopOffset: SEGAAPI_SetStartLoopOffset(h, u1); break;
+        case EXPORT_GetStartLoopOffset: SEGAAPI_GetStartLoopOffset(h); break;
+        case EXPORT_SetEndLoopOffset: SEGAAPI_SetEndLoopOffset(h, u1); break;
+        case EXPORT_GetEndLoopOffset: SEGAAPI_GetEndLoopOffset(h); break;
+        case EXPORT_SetEndOffset: SEGAAPI_SetEndOffset(h, u1); break;
+        case EXPORT_GetEndOffset: SEGAAPI_GetEndOffset(h); break;
+        case EXPORT_SetLoopState: SEGAAPI_SetLoopState(h, static_cast<int>(args[1])); break;
+        case EXPORT_GetLoopState: SEGAAPI_GetLoopState(h); break;
+        case EXPORT_UpdateBuffer: {
+            // Restore what the game had written into the range, then tell the library
+            ReplayHandle* entry = findHandle(args[0]);
+            if (entry && blob && static_cast<uint64_t>(u1) + blob->size <= entry->size) {
+                memcpy(entry->data + u1, blob->data, blob->size);
+            }
+            SEGAAPI_UpdateBuffer(h, u1, u2);
+            break;
+        }
+        case EXPORT_SetSynthParam: SEGAAPI_SetSynthParam(h, static_cast<OPEN_HASYNTHPARAMSEXT>(args[1]), static_cast<int>(args[2])); break;
+        case EXPORT_GetSynthParam: SEGAAPI_GetSynthParam(h, static_cast<OPEN_HASYNTHPARAMSEXT>(args[1])); break;
+        case EXPORT_SetSynthParamMultiple:
+        case EXPORT_GetSynthParamMultiple: {
+            std::vector<OPEN_SynthParamSet> params(u1);
+            if (blob) memcpy(params.data(), blob->data, std::min(blob->size, params.size() * sizeof(OPEN_SynthParamSet)));
+            OPEN_SynthParamSet* p = params.empty() ? nullptr : params.data();
+            if (op == EXPORT_SetSynthParamMultiple) SEGAAPI_SetSynthParamMultiple(h, u1, p);
+            else SEGAAPI_GetSynthParamMultiple(h, u1, p);
+            break;
+        }
+        case EXPORT_SetReleaseState: SEGAAPI_SetReleaseState(h, static_cast<int>(args[1])); break;
+        case EXPORT_Play: SEGAAPI_Play(h); break;
+        case EXPORT_Pause: SEGAAPI_Pause(h); break;
+        case EXPORT_Stop: SEGAAPI_Stop(h); break;
+        case EXPORT_GetPlaybackStatus: SEGAAPI_GetPlaybackStatus(h); break;
+        case EXPORT_GetStartupTimings: {
+            OPEN_HASTARTUPTIMINGS timings;
+            SEGAAPI_GetStartupTimings(&timings);
+            break;
+        }
+        case EXPORT_GetAdpcmStats: {
+            OPEN_HAADPCMSTATS stats;
+            SEGAAPI_GetAdpcmStats(&stats);
+            break;
+        }
+        case EXPORT_PlayWithSetup: {
+            unsigned int counts[4] = { u1, u2, u3, static_cast<unsigned int>(args[4]) };
+            const size_t sizes[4] = { sizeof(OPEN_SendRouteParamSet), sizeof(OPEN_SendLevelParamSet),
+                sizeof(OPEN_VoiceParamSet), sizeof(OPEN_SynthParamSet) };
+            std::vector<uint8_t> setup(blob ? blob->data : nullptr, blob ? blob->data + blob->size : nullptr);
+            size_t needed = 0;
+            for (int i = 0; i < 4; i++) needed += counts[i] * sizes[i];
+            setup.resize(std::max(needed, static_cast<size_t>(1)));
+            uint8_t* arrays[4];
+            size_t at = 0;
+            for (int i = 0; i < 4; i++) {
+                arrays[i] = counts[i] ? setup.data() + at : nullptr;
+                at += counts[i] * sizes[i];
+            }
+            SEGAAPI_PlayWithSetup(h,
+                counts[0], reinterpret_cast<OPEN_SendRouteParamSet*>(arrays[0]),
+                counts[1], reinterpret_cast<OPEN_SendLevelParamSet*>(arrays[1]),
+                counts[2], reinterpret_cast<OPEN_VoiceParamSet*>(arrays[2]),
+                counts[3], reinterpret_cast<OPEN_SynthParamSet*>(arrays[3]));
+            break;
+        }
+        case EXPORT_SetGlobalEAXProperty:
+        case EXPORT_GetGlobalEAXProperty: {
+            GUID guid = {};
+            std::vector<uint8_t> data(static_cast<size_t>(args[1]) + 1);
+            if (blob && blob->size >= sizeof(GUID)) {
+                memcpy(&guid, blob->data, sizeof(GUID));
+                memcpy(data.data(), blob->data + sizeof(GUID), std::min(blob->size - sizeof(GUID), data.size()));
+            }
+            if (op == EXPORT_SetGlobalEAXProperty) SEGAAPI_SetGlobalEAXProperty(&guid, static_cast<unsigned long>(args[0]), data.data(), static_cast<unsigned long>(args[1]));
+            else SEGAAPI_GetGlobalEAXProperty(&guid, static_cast<unsigned long>(args[0]), data.data(), static_cast<unsigned long>(args[1]));
+            break;
+        }
+        case EXPORT_SetSPDIFOutChannelStatus: SEGAAPI_SetSPDIFOutChannelStatus(static_cast<unsigned int>(args[0]), u1); break;
+        case EXPORT_GetSPDIFOutChannelStatus: {
+            unsigned int status, extStatus;
+            SEGAAPI_GetSPDIFOutChannelStatus(&status, &extStatus);
+            break;
+        }
+        case EXPORT_SetSPDIFOutSampleRate: SEGAAPI_SetSPDIFOutSampleRate(static_cast<OPEN_HASPDIFOUTRATE>(args[0])); break;
+        case EXPORT_GetSPDIFOutSampleRate: SEGAAPI_GetSPDIFOutSampleRate(); break;
+        case EXPORT_SetSPDIFOutChannelRouting: SEGAAPI_SetSPDIFOutChannelRouting(static_cast<unsigned int>(args[0]), static_cast<OPEN_HAROUTING>(args[1])); break;
+        case EXPORT_GetSPDIFOutChannelRouting: SEGAAPI_GetSPDIFOutChannelRouting(static_cast<unsigned int>(args[0])); break;
+        case EXPORT_SetIOVolume: SEGAAPI_SetIOVolume(static_cast<OPEN_HAPHYSICALIO>(args[0]), u1); break;
+        case EXPORT_GetIOVolume: SEGAAPI_GetIOVolume(static_cast<OPEN_HAPHYSICALIO>(args[0])); break;
+        case EXPORT_SetLastStatus: SEGAAPI_SetLastStatus(static_cast<OPEN_SEGASTATUS>(args[0])); break;
+        case EXPORT_GetLastStatus: SEGAAPI_GetLastStatus(); break;
+        case EXPORT_Reset: SEGAAPI_Reset(); break;
+        case EXPORT_GetStatsCount: SEGAAPI_GetStatsCount(); break;
+        case EXPORT_GetStats: {
+            OPEN_HAEXPORTSTATS stats;
+            SEGAAPI_GetStats(static_cast<unsigned int>(args[0]), &stats);
+            break;
+        }
+        case EXPORT_ResetStats: SEGAAPI_ResetStats(); break;
+        case EXPORT_GetMixerTelemetry: {
+            OPEN_HAMIXERTELEMETRY telemetry;
+            SEGAAPI_GetMixerTelemetry(&telemetry);
+            break;
+        }
+        case EXPORT_ResetMixerTelemetry: SEGAAPI_ResetMixerTelemetry(); break;
+        case EXPORT_GetAudioClock: {
+            unsigned long long sampleTime;
+            SEGAAPI_GetAudioClock(&sampleTime);
+            break;
+        }
+        case EXPORT_GetPlaybackPositions: {
+            std::vector<void*> handles(static_cast<unsigned int>(args[0]));
+            std::vector<unsigned int> positions(handles.size());
+            for (size_t i = 0; i < handles.size(); i++) {
+                uint32_t id = 0;
+                if (blob && (i + 1) * sizeof(id) <= blob->size) memcpy(&id, blob->data + i * sizeof(id), sizeof(id));
+                handles[i] = handleOf(id);
+            }
+            SEGAAPI_GetPlaybackPositions(static_cast<unsigned int>(handles.size()), handles.data(), positions.data());
+            break;
+        }
+        // Scheduled events keep the lead they had over the audio clock when recorded
+        case EXPORT_PlayAtTime: SEGAAPI_PlayAtTime(h, replayClockPlus(args[1])); break;
+        case EXPORT_StopAtTime: SEGAAPI_StopAtTime(h, replayClockPlus(args[1])); break;
+        case EXPORT_SetSynthParamAtTime:
+            SEGAAPI_SetSynthParamAtTime(h, static_cast<OPEN_HASYNTHPARAMSEXT>(args[1]), static_cast<int>(args[2]), replayClockPlus(args[3]));
+            break;
+        default: break;
+    }
+}
+
+// ======================================================================
+// Trace parsing
+// ======================================================================
+static bool replayTrace(const std::vector<uint8_t>& file, bool fast, uint64_t* callCount) {
+    const uint8_t* p = file.data() + 16;
+    const uint8_t* end = file.data() + file.size();
+    uint64_t timeNs = 0;
+    auto start = replayClock::now();
+
+    g_blobs.assign(1, ReplayBlob{ nullptr, 0 });
+    while (p < end) {
+        uint8_t tag = *p++;
+        uint64_t values[3];
+        size_t n;
+        if (tag == TRACE_TAG_BLOB) {
+            if (!(n = TraceReadVarint(p, end - p, &values[0]))) return false;
+            p += n;
+            if (!(n = TraceReadVarint(p, end - p, &values[1]))) return false;
+            p += n;
+            if (values[1] > static_cast<uint64_t>(end - p)) return false;
+            if (g_blobs.size() <= values[0]) g_blobs.resize(static_cast<size_t>(values[0]) + 1);
+            g_blobs[static_cast<size_t>(values[0])] = ReplayBlob{ p, static_cast<size_t>(values[1]) };
+            p += values[1];
+            continue;
+        }
+        if (tag >= EXPORT_COUNT) return false;
+
+        // dt, thread, argc
+        for (int i = 0; i < 3; i++) {
+            if (!(n = TraceReadVarint(p, end - p, &values[i]))) return false;
+            p += n;
+        }
+        if (values[2] > TRACE_MAX_ARGS) return false;
+        int64_t args[TRACE_MAX_ARGS];
+        for (uint64_t i = 0; i < values[2]; i++) {
+            uint64_t raw;
+            if (!(n = TraceReadVarint(p, end - p, &raw))) return false;
+            p += n;
+            args[i] = TraceUnzigzag(raw);
+        }
+        uint64_t blobRef;
+        if (!(n = TraceReadVarint(p, end - p, &blobRef))) return false;
+        p += n;
+        const ReplayBlob* blob = (blobRef && blobRef < g_blobs.size()) ? &g_blobs[static_cast<size_t>(blobRef)] : nullptr;
+
+        timeNs += values[0];
+        if (!fast) std::this_thread::sleep_until(start + std::chrono::nanoseconds(timeNs));
+
+        OPEN_EXPORT op = static_cast<OPEN_EXPORT>(tag);
+        auto callStart = replayClock::now();
+        replayCall(op, args, static_cast<unsigned int>(values[2]), blob);
+        double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(replayClock::now() - callStart).count());
+        g_opStats[op].calls++;
+        g_opStats[op].totalNs += ns;
+        g_opStats[op].maxNs = std::max(g_opStats[op].maxNs, ns);
+        (*callCount)++;
+    }
+    return true;
+}
+
+static bool loadFile(const char* path, std::vector<uint8_t>& file) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) file.insert(file.end(), chunk, chunk + n);
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    bool fast = false;
+    int loops = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--fast")) fast = true;
+        else if (!strcmp(argv[i], "--loops") && i + 1 < argc) loops = std::max(1, atoi(argv[++i]));
+        else if (!path && argv[i][0] != '-') path = argv[i];
+        else path = nullptr, i = argc;
+    }
+    if (!path) {
+        fprintf(stderr, "Usage: %s <trace file> [--fast] [--loops N]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<uint8_t> file;
+    if (!loadFile(path, file) || file.size() < 16 || memcmp(file.data(), TRACE_MAGIC, 8) != 0) {
+        fprintf(stderr, "%s is not a SEGAAPI trace\n", path);
+        return 1;
+    }
+    uint32_t version;
+    memcpy(&version, file.data() + 8, sizeof(version));
+    if (version != TRACE_VERSION) {
+        fprintf(stderr, "Unsupported trace version %u\n", version);
+        return 1;
+    }
+
+    uint64_t calls = 0;
+    auto start = replayClock::now();
+    for (int loop = 0; loop < loops; loop++) {
+        if (!replayTrace(file, fast, &calls)) {
+            fprintf(stderr, "Trace is truncated or corrupt after %llu calls\n", static_cast<unsigned long long>(calls));
+        }
+        // Sessions often end without SEGAAPI_Exit; release what the game left behind
+        for (auto& entry : g_handles) SEGAAPI_DestroyBuffer(entry.second.handle);
+        g_handles.clear();
+    }
+    double wallMs = std::chrono::duration_cast<std::chrono::microseconds>(replayClock::now() - start).count() / 1000.0;
+
+    printf("Replayed %llu calls in %.1f ms\n\n", static_cast<unsigned long long>(calls), wallMs);
+    printf("%-36s %10s %12s %12s\n", "export", "calls", "mean ns", "max ns");
+    for (int op = 0; op < EXPORT_COUNT; op++) {
+        const ReplayOpStats& s = g_opStats[op];
+        if (!s.calls) continue;
+        printf("%-36s %10llu %12.0f %12.0f\n", g_exportNames[op], static_cast<unsigned long long>(s.calls), s.totalNs / s.calls, s.maxNs);
+    }
+    return 0;
+}
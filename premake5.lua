@@ -1,19 +1,18 @@
 workspace "Opensegaapi"
 	configurations { "Debug", "Release"}
-	platforms { "x86" }
 
-	flags { "StaticRuntime", "No64BitChecks" }
-
-	systemversion "10.0.16299.0"
+	-- Windows builds the 32 bit DLL games load; Linux (premake5 gmake2)
+	-- builds libOpensegaapi.so and the tools natively for profiling
+	if os.istarget("windows") then
+		platforms { "x86" }
+	else
+		platforms { "x64" }
+	end
 
 	symbols "On"
 
 	characterset "Unicode"
 
-	flags { "NoIncrementalLink", "NoEditAndContinue", "NoMinimalRebuild" }
-
-	buildoptions { "/MP", "/std:c++17" }
-
 	configuration "Debug*"
 		targetdir "build/bin/debug"
 		defines "NDEBUG"
@@ -25,7 +24,24 @@ workspace "Opensegaapi"
 		optimize "speed"
 		objdir "build/obj/release"
 
+	filter "system:windows"
+		flags { "StaticRuntime", "No64BitChecks" }
+		systemversion "10.0.16299.0"
+		flags { "NoIncrementalLink", "NoEditAndContinue", "NoMinimalRebuild" }
+		buildoptions { "/MP", "/std:c++17" }
+
+	filter "system:linux"
+		buildoptions { "-std=c++17", "-fvisibility=hidden" }
+		pic "On"
+		links { "pthread" }
+
 	filter "platforms:x86"
 		architecture "x32"
 
-include "Opensegaapi"
\ No newline at end of file
+	filter "platforms:x64"
+		architecture "x86_64"
+
+include "Opensegaapi"
+include "OpensegaapiBench"
+include "OpensegaapiReplay"
+include "OpensegaapiExitTest"
\ No newline at end of file